@@ -0,0 +1,402 @@
+#include "connection_pool.h"
+#include <poll.h>
+#include <algorithm>
+#include "absl/strings/str_cat.h"
+#include "spdlog/spdlog.h"
+#include "src/common/metrics/metrics.h"
+
+namespace beast = boost::beast;    // from <boost/beast.hpp>
+namespace net = boost::asio;       // from <boost/asio.hpp>
+namespace ssl = boost::asio::ssl;  // from <boost/asio/ssl.hpp>
+using tcp = boost::asio::ip::tcp;  // from <boost/asio/ip/tcp.hpp>
+
+namespace authservice {
+namespace common {
+namespace http {
+namespace {
+const char *hits_metric_ = "http_pool_hits_total";
+const char *misses_metric_ = "http_pool_misses_total";
+const char *evictions_metric_ = "http_pool_evictions_total";
+const char *connects_metric_ = "http_pool_connects_total";
+const char *connect_failures_metric_ = "http_pool_connect_failures_total";
+const char *connect_duration_metric_ =
+    "http_pool_connect_duration_microseconds_total";
+
+std::string KeyOf(const authservice::config::common::Endpoint &endpoint) {
+  return absl::StrCat(endpoint.hostname(), ":", endpoint.port());
+}
+}  // namespace
+
+void StreamDeleter::operator()(stream_t *stream) const {
+  SSL_set_shutdown(stream->native_handle(),
+                   SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+  delete stream;
+}
+
+ConnectionPool::Lease::Lease(ConnectionPool *pool, std::string key,
+                             stream_ptr_t stream, bool reused)
+    : pool_(pool),
+      key_(std::move(key)),
+      stream_(std::move(stream)),
+      reused_(reused) {}
+
+ConnectionPool::Lease::Lease(Lease &&other) noexcept
+    : pool_(other.pool_),
+      key_(std::move(other.key_)),
+      stream_(std::move(other.stream_)),
+      reused_(other.reused_) {
+  other.pool_ = nullptr;
+}
+
+ConnectionPool::Lease::~Lease() {
+  if (pool_ != nullptr) {
+    // Not released: the connection is in an unknown state so close it.
+    pool_->Return(key_, nullptr);
+  }
+}
+
+stream_t &ConnectionPool::Lease::Stream() { return *stream_; }
+
+bool ConnectionPool::Lease::Reused() const { return reused_; }
+
+void ConnectionPool::Lease::Release() {
+  if (pool_ != nullptr) {
+    pool_->Return(key_, std::move(stream_));
+    pool_ = nullptr;
+  }
+}
+
+/**
+ * Connector asynchronously resolves, connects and performs the TLS handshake
+ * for a new pooled connection.
+ */
+class ConnectionPool::Connector
+    : public std::enable_shared_from_this<ConnectionPool::Connector> {
+ private:
+  ConnectionPoolPtr pool_;
+  std::string key_;
+  authservice::config::common::Endpoint endpoint_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point deadline_;
+  acquire_handler_t handler_;
+  tcp::resolver resolver_;
+  net::steady_timer resolve_timer_;
+  stream_ptr_t stream_;
+
+  void Fail(const boost::system::error_code &ec) {
+    auto &metrics = metrics::Registry::Instance();
+    metrics.GetCounter(connect_failures_metric_).Increment();
+    pool_->Return(key_, nullptr);
+    handler_(ec, nullptr);
+  }
+
+  void OnResolve(const boost::system::error_code &ec,
+                 tcp::resolver::results_type results) {
+    resolve_timer_.cancel();
+    if (ec) {
+      return Fail(ec);
+    }
+    pool_->sessions_.Resume(stream_->native_handle(), key_);
+    beast::get_lowest_layer(*stream_).expires_at(deadline_);
+    beast::get_lowest_layer(*stream_).async_connect(
+        results, std::bind(&Connector::OnConnect, shared_from_this(),
+                           std::placeholders::_1));
+  }
+
+  void OnConnect(const boost::system::error_code &ec) {
+    if (ec) {
+      return Fail(ec);
+    }
+    beast::get_lowest_layer(*stream_).expires_at(deadline_);
+    stream_->async_handshake(
+        ssl::stream_base::client,
+        std::bind(&Connector::OnHandshake, shared_from_this(),
+                  std::placeholders::_1));
+  }
+
+  void OnHandshake(const boost::system::error_code &ec) {
+    if (ec) {
+      return Fail(ec);
+    }
+    beast::get_lowest_layer(*stream_).expires_never();
+    pool_->sessions_.Record(stream_->native_handle());
+    pool_->RecordConnect(start_);
+    handler_(ec, lease_ptr_t(new Lease(pool_.get(), key_, std::move(stream_), false)));
+  }
+
+ public:
+  Connector(ConnectionPoolPtr pool, std::string key,
+            const authservice::config::common::Endpoint &endpoint,
+            std::chrono::steady_clock::time_point deadline,
+            acquire_handler_t handler)
+      : pool_(pool),
+        key_(std::move(key)),
+        endpoint_(endpoint),
+        start_(std::chrono::steady_clock::now()),
+        deadline_(deadline),
+        handler_(std::move(handler)),
+        resolver_(*pool->io_context_),
+        resolve_timer_(*pool->io_context_),
+        stream_(new stream_t(*pool->io_context_, pool->ssl_context_)) {}
+
+  void Start() {
+    if (!SSL_set_tlsext_host_name(stream_->native_handle(),
+                                  endpoint_.hostname().c_str())) {
+      return Fail(boost::system::error_code{
+          static_cast<int>(::ERR_get_error()),
+          boost::asio::error::get_ssl_category()});
+    }
+    // Resolution is not covered by the stream's timeout so bound it
+    // separately.
+    auto self = shared_from_this();
+    resolve_timer_.expires_at(deadline_);
+    resolve_timer_.async_wait([self](const boost::system::error_code &ec) {
+      if (!ec) {
+        self->resolver_.cancel();
+      }
+    });
+    resolver_.async_resolve(
+        endpoint_.hostname(), std::to_string(endpoint_.port()),
+        std::bind(&Connector::OnResolve, self, std::placeholders::_1,
+                  std::placeholders::_2));
+  }
+};
+
+ConnectionPool::ConnectionPool(Options options)
+    : options_(options),
+      io_context_(std::make_shared<net::io_context>()),
+      ssl_context_(ssl::context::tlsv12_client),
+      sessions_(ssl_context_.native_handle()),
+      work_(net::make_work_guard(*io_context_)) {
+  // TODO: verify_peer should be used but is not currently working.
+  ssl_context_.set_verify_mode(ssl::verify_none);
+  ssl_context_.set_default_verify_paths();
+  for (size_t i = 0; i < options_.io_threads; ++i) {
+    // Each thread shares ownership of the io_context so that it remains valid
+    // should the pool be destroyed from one of these threads.
+    auto io_context = io_context_;
+    threads_.emplace_back([io_context]() { io_context->run(); });
+  }
+}
+
+ConnectionPool::ConnectionPool() : ConnectionPool(Options()) {}
+
+ConnectionPool::~ConnectionPool() {
+  // Asynchronous operations keep the pool alive, so none are outstanding and
+  // the threads exit once idle.
+  work_.reset();
+  for (auto &thread : threads_) {
+    if (thread.get_id() == std::this_thread::get_id()) {
+      // The last reference was dropped by a completion handler.
+      thread.detach();
+    } else {
+      thread.join();
+    }
+  }
+}
+
+net::io_context &ConnectionPool::IoContext() { return *io_context_; }
+
+ConnectionPoolPtr ConnectionPool::Default() {
+  static auto pool = std::make_shared<ConnectionPool>();
+  return pool;
+}
+
+bool ConnectionPool::TryAcquire(Slot &slot, stream_ptr_t &stream) {
+  auto &metrics = metrics::Registry::Instance();
+  EvictExpired(slot, std::chrono::steady_clock::now());
+  // Prefer the most recently used connection as it is the least likely to
+  // have been closed by the server.
+  while (!slot.idle.empty()) {
+    auto candidate = std::move(slot.idle.back().stream);
+    slot.idle.pop_back();
+    if (IsHealthy(*candidate)) {
+      slot.active++;
+      metrics.GetCounter(hits_metric_).Increment();
+      stream = std::move(candidate);
+      return true;
+    }
+    metrics.GetCounter(evictions_metric_).Increment();
+  }
+  if (slot.active < options_.max_connections_per_endpoint) {
+    // Reserve room for a new connection.
+    slot.active++;
+    metrics.GetCounter(misses_metric_).Increment();
+    return true;
+  }
+  return false;
+}
+
+ConnectionPool::Lease ConnectionPool::Acquire(
+    const authservice::config::common::Endpoint &endpoint) {
+  auto key = KeyOf(endpoint);
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto &slot = slots_[key];
+    stream_ptr_t stream;
+    available_.wait(lock, [&]() { return TryAcquire(slot, stream); });
+    if (stream) {
+      return Lease(this, key, std::move(stream), true);
+    }
+  }
+
+  // Connect without holding the lock. The slot has already been reserved.
+  try {
+    return Lease(this, key, Connect(endpoint), false);
+  } catch (...) {
+    metrics::Registry::Instance()
+        .GetCounter(connect_failures_metric_)
+        .Increment();
+    Return(key, nullptr);
+    throw;
+  }
+}
+
+void ConnectionPool::AcquireAsync(
+    const authservice::config::common::Endpoint &endpoint,
+    std::chrono::steady_clock::time_point deadline, acquire_handler_t handler) {
+  auto key = KeyOf(endpoint);
+  stream_ptr_t stream;
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto &slot = slots_[key];
+    if (!TryAcquire(slot, stream)) {
+      // Try again once a connection is returned, or give up at the deadline.
+      auto self = shared_from_this();
+      auto waiter = std::make_shared<Waiter>(*io_context_);
+      waiter->retry = [self, endpoint, deadline, handler]() {
+        self->AcquireAsync(endpoint, deadline, handler);
+      };
+      std::weak_ptr<Waiter> weak = waiter;
+      waiter->timer.expires_at(deadline);
+      waiter->timer.async_wait([self, key, weak, handler](
+                                   const boost::system::error_code &ec) {
+        if (ec == net::error::operation_aborted) {
+          return;
+        }
+        {
+          std::unique_lock<std::mutex> lock(self->mtx_);
+          auto &waiters = self->slots_[key].waiters;
+          auto found = std::find(waiters.begin(), waiters.end(), weak.lock());
+          if (found == waiters.end()) {
+            // A connection was returned just as the deadline passed.
+            return;
+          }
+          waiters.erase(found);
+        }
+        handler(net::error::timed_out, nullptr);
+      });
+      slot.waiters.push_back(std::move(waiter));
+      return;
+    }
+  }
+  if (stream) {
+    auto lease = std::make_shared<lease_ptr_t>(
+        new Lease(this, key, std::move(stream), true));
+    // Always complete asynchronously so callers see consistent behaviour.
+    net::post(*io_context_, [handler, lease]() {
+      handler(boost::system::error_code(), std::move(*lease));
+    });
+    return;
+  }
+  std::make_shared<Connector>(shared_from_this(), key, endpoint, deadline,
+                              handler)
+      ->Start();
+}
+
+size_t ConnectionPool::IdleCount(
+    const authservice::config::common::Endpoint &endpoint) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  auto slot = slots_.find(KeyOf(endpoint));
+  if (slot == slots_.end()) {
+    return 0;
+  }
+  EvictExpired(slot->second, std::chrono::steady_clock::now());
+  return slot->second.idle.size();
+}
+
+stream_ptr_t ConnectionPool::Connect(
+    const authservice::config::common::Endpoint &endpoint) {
+  auto start = std::chrono::steady_clock::now();
+  tcp::resolver resolver(*io_context_);
+  stream_ptr_t stream(new stream_t(*io_context_, ssl_context_));
+  if (!SSL_set_tlsext_host_name(stream->native_handle(),
+                                endpoint.hostname().c_str())) {
+    boost::system::error_code ec{static_cast<int>(::ERR_get_error()),
+                                 boost::asio::error::get_ssl_category()};
+    throw boost::system::system_error{ec};
+  }
+  const auto results =
+      resolver.resolve(endpoint.hostname(), std::to_string(endpoint.port()));
+  sessions_.Resume(stream->native_handle(), KeyOf(endpoint));
+  beast::get_lowest_layer(*stream).connect(results);
+  stream->handshake(ssl::stream_base::client);
+  sessions_.Record(stream->native_handle());
+  RecordConnect(start);
+  return stream;
+}
+
+void ConnectionPool::RecordConnect(std::chrono::steady_clock::time_point start) {
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  auto &metrics = metrics::Registry::Instance();
+  metrics.GetCounter(connects_metric_).Increment();
+  metrics.GetCounter(connect_duration_metric_).Increment(elapsed.count());
+}
+
+void ConnectionPool::Return(const std::string &key, stream_ptr_t stream) {
+  stream_ptr_t discarded;
+  std::function<void()> waiter;
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto &slot = slots_[key];
+    slot.active--;
+    if (!slot.waiters.empty()) {
+      slot.waiters.front()->timer.cancel();
+      waiter = std::move(slot.waiters.front()->retry);
+      slot.waiters.pop_front();
+    }
+    auto now = std::chrono::steady_clock::now();
+    EvictExpired(slot, now);
+    if (stream) {
+      if (slot.idle.size() < options_.max_idle_per_endpoint) {
+        slot.idle.push_back(Idle{std::move(stream), now});
+      } else {
+        discarded = std::move(stream);
+      }
+    }
+  }
+  available_.notify_one();
+  if (waiter) {
+    net::post(*io_context_, std::move(waiter));
+  }
+  // discarded is closed here, outside of the lock.
+}
+
+void ConnectionPool::EvictExpired(Slot &slot,
+                                  std::chrono::steady_clock::time_point now) {
+  // Idle connections are ordered from least to most recently used.
+  while (!slot.idle.empty() &&
+         now - slot.idle.front().since > options_.idle_timeout) {
+    slot.idle.pop_front();
+    metrics::Registry::Instance().GetCounter(evictions_metric_).Increment();
+  }
+}
+
+bool ConnectionPool::IsHealthy(stream_t &stream) {
+  auto &socket = beast::get_lowest_layer(stream).socket();
+  if (!socket.is_open()) {
+    return false;
+  }
+  // An idle connection should have nothing to read. If it is readable the
+  // server has either closed it or sent something we did not ask for, and
+  // either way it cannot be reused.
+  pollfd descriptor = {};
+  descriptor.fd = socket.native_handle();
+  descriptor.events = POLLIN;
+  return ::poll(&descriptor, 1, 0) == 0;
+}
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
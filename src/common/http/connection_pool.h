@@ -0,0 +1,199 @@
+#ifndef AUTHSERVICE_SRC_COMMON_HTTP_CONNECTION_POOL_H_
+#define AUTHSERVICE_SRC_COMMON_HTTP_CONNECTION_POOL_H_
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "config/common/config.pb.h"
+#include "src/common/http/tls_session_cache.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+
+typedef boost::beast::ssl_stream<boost::beast::tcp_stream> stream_t;
+
+/** @brief Close a stream without invalidating its TLS session.
+ *
+ * Freeing a connection that has not completed a TLS shutdown marks its
+ * session as not resumable. Pooled connections are routinely dropped without
+ * one, so mark the shutdown as complete before freeing the stream.
+ */
+struct StreamDeleter {
+  void operator()(stream_t *stream) const;
+};
+typedef std::unique_ptr<stream_t, StreamDeleter> stream_ptr_t;
+
+class ConnectionPool;
+typedef std::shared_ptr<ConnectionPool> ConnectionPoolPtr;
+
+/** @brief A pool of persistent TLS connections, keyed by endpoint.
+ *
+ * Connections are opened on demand and returned to the pool after use if the
+ * server agreed to keep them alive. Idle connections are health checked before
+ * being handed out again and are evicted once they have been idle for longer
+ * than the configured timeout.
+ *
+ * The pool also owns a long-lived io_context, run by a small number of
+ * threads, that drives asynchronous operations on its connections. Pools used
+ * asynchronously must be owned by a ConnectionPoolPtr.
+ */
+class ConnectionPool : public std::enable_shared_from_this<ConnectionPool> {
+ public:
+  struct Options {
+    // The maximum number of connections, idle or in use, per endpoint.
+    size_t max_connections_per_endpoint = 16;
+    // The maximum number of idle connections kept per endpoint.
+    size_t max_idle_per_endpoint = 4;
+    // How long a connection may be idle before it is evicted.
+    std::chrono::steady_clock::duration idle_timeout = std::chrono::seconds(60);
+    // The number of threads running asynchronous I/O.
+    size_t io_threads = 2;
+  };
+
+  /** @brief A connection leased from the pool.
+   *
+   * A lease that is destroyed without being released back to the pool closes
+   * its connection.
+   */
+  class Lease {
+   private:
+    ConnectionPool *pool_;
+    std::string key_;
+    stream_ptr_t stream_;
+    bool reused_;
+
+   public:
+    Lease(ConnectionPool *pool, std::string key, stream_ptr_t stream,
+          bool reused);
+    Lease(Lease &&other) noexcept;
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+    ~Lease();
+
+    /** @brief The leased stream. */
+    stream_t &Stream();
+
+    /** @brief Whether the connection was reused from the idle pool. */
+    bool Reused() const;
+
+    /** @brief Return the connection to the pool for reuse. */
+    void Release();
+  };
+
+  typedef std::unique_ptr<Lease> lease_ptr_t;
+  typedef std::function<void(const boost::system::error_code &, lease_ptr_t)>
+      acquire_handler_t;
+
+  explicit ConnectionPool(Options options);
+  ConnectionPool();
+  ~ConnectionPool();
+
+  /** @brief Lease a connection to the given endpoint.
+   *
+   * Returns a healthy idle connection if one is available, otherwise opens a
+   * new one. Blocks whilst the endpoint is at its connection limit.
+   *
+   * @param endpoint the endpoint to connect to.
+   * @return a lease on the connection.
+   * @throws boost::system::system_error on connection failure.
+   */
+  Lease Acquire(const authservice::config::common::Endpoint &endpoint);
+
+  /** @brief Asynchronously lease a connection to the given endpoint.
+   *
+   * As Acquire, but never blocks. Whilst the endpoint is at its connection
+   * limit the request is queued until a connection is returned, or fails
+   * with boost::asio::error::timed_out at the deadline. The handler is
+   * invoked exactly once, on one of the pool's I/O threads.
+   *
+   * @param endpoint the endpoint to connect to.
+   * @param deadline the time by which the connection must be leased.
+   * @param handler invoked with the lease, or with an error.
+   */
+  void AcquireAsync(const authservice::config::common::Endpoint &endpoint,
+                    std::chrono::steady_clock::time_point deadline,
+                    acquire_handler_t handler);
+
+  /** @brief The io_context driving asynchronous operations. */
+  boost::asio::io_context &IoContext();
+
+  /** @brief The number of idle connections held for the given endpoint. */
+  size_t IdleCount(const authservice::config::common::Endpoint &endpoint);
+
+  /** @brief The process-wide default pool. */
+  static ConnectionPoolPtr Default();
+
+ private:
+  struct Idle {
+    stream_ptr_t stream;
+    std::chrono::steady_clock::time_point since;
+  };
+  // An asynchronous acquisition waiting for a connection to be returned.
+  struct Waiter {
+    explicit Waiter(boost::asio::io_context &io_context) : timer(io_context) {}
+    // Fails the acquisition at its deadline. Only used whilst holding mtx_.
+    boost::asio::steady_timer timer;
+    std::function<void()> retry;
+  };
+  struct Slot {
+    std::deque<Idle> idle;
+    size_t active = 0;
+    std::deque<std::shared_ptr<Waiter>> waiters;
+  };
+  class Connector;
+
+  const Options options_;
+  // io_context_ and ssl_context_ must outlive all streams.
+  std::shared_ptr<boost::asio::io_context> io_context_;
+  boost::asio::ssl::context ssl_context_;
+  // Sessions are keyed by host and port so that reconnects after idle
+  // eviction or a server-side close can resume rather than perform a full
+  // handshake.
+  TlsSessionCache sessions_;
+  std::mutex mtx_;
+  std::condition_variable available_;
+  std::map<std::string, Slot> slots_;
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type>
+      work_;
+  std::vector<std::thread> threads_;
+
+  /** @brief Take a healthy idle connection or reserve room for a new one.
+   *
+   * Requires mtx_.
+   * @param slot the endpoint's slot.
+   * @param stream set to an idle connection, if one was taken.
+   * @return false if the endpoint is at its connection limit.
+   */
+  bool TryAcquire(Slot &slot, stream_ptr_t &stream);
+
+  /** @brief Open a new TLS connection to the given endpoint. */
+  stream_ptr_t Connect(const authservice::config::common::Endpoint &endpoint);
+
+  /** @brief Record the metrics for a newly established connection. */
+  void RecordConnect(std::chrono::steady_clock::time_point start);
+
+  /** @brief Return a connection to the pool, or discard it if null. */
+  void Return(const std::string &key, stream_ptr_t stream);
+
+  /** @brief Drop idle connections that have expired. Requires mtx_. */
+  void EvictExpired(Slot &slot, std::chrono::steady_clock::time_point now);
+
+  /** @brief Check an idle connection has not been closed by the peer. */
+  static bool IsHealthy(stream_t &stream);
+};
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_COMMON_HTTP_CONNECTION_POOL_H_
@@ -1,17 +1,29 @@
 #include "http.h"
-#include <boost/algorithm/string.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/dispatch.hpp>
 #include <boost/asio/ssl/error.hpp>
 #include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/beast.hpp>
 #include <boost/beast/ssl.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <iomanip>
 #include <ios>
 #include <iostream>
 #include <sstream>
+#include "absl/strings/ascii.h"
 #include "absl/strings/escaping.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
 #include "spdlog/spdlog.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace beast = boost::beast;    // from <boost/beast.hpp>
 namespace net = boost::asio;       // from <boost/asio.hpp>
@@ -38,170 +50,361 @@ const uint8_t reverse_alphabet[] = {
     255, 255, 255, 255, 255, 255, 255, 255,
 };
 
-typedef bool (*SafeCharacterFunc)(const char);
-bool IsUrlSafeCharacter(const char character) {
-  return ((character >= 'A' && character <= 'Z') ||
+// Character classes used by the percent encoding kernels.
+enum CharacterClass : uint8_t {
+  // unreserved characters: see https://www.ietf.org/rfc/rfc3986.txt
+  Unreserved = 1u << 0u,
+  // '+' is passed through unencoded in form data.
+  FormSafe = 1u << 1u,
+};
+
+struct CharacterTable {
+  uint8_t classes[256];
+
+  CharacterTable() : classes() {
+    for (int character = 0; character < 256; ++character) {
+      if ((character >= 'A' && character <= 'Z') ||
           (character >= 'a' && character <= 'z') ||
           (character >= '0' && character <= '9') || (character == '-') ||
-          (character == '_') || (character == '.') || (character == '~'));
+          (character == '_') || (character == '.') || (character == '~')) {
+        classes[character] = Unreserved | FormSafe;
+      }
+    }
+    classes[uint8_t('+')] = FormSafe;
+  }
+};
+const CharacterTable character_table_;
+
+inline bool IsSafe(char character, uint8_t safe) {
+  return character_table_.classes[uint8_t(character)] & safe;
 }
 
-bool IsFormDataSafeCharacter(const char character) {
-  return IsUrlSafeCharacter(character) || (character == '+');
+#ifdef __SSE2__
+inline __m128i InRange(__m128i block, char low, char high) {
+  return _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8(low - 1)),
+                       _mm_cmplt_epi8(block, _mm_set1_epi8(high + 1)));
 }
 
-std::string SafeEncode(absl::string_view in, SafeCharacterFunc IsSafe) {
-  std::stringstream builder;
-  for (auto character : in) {
-    // unreserved characters: see https://www.ietf.org/rfc/rfc3986.txt
-    if (IsSafe(character)) {
-      builder << character;
-    } else {
-      // percent encode
-      builder << '%' << forward_alphabet[(character & 0xf0u) >> 4u]
-              << forward_alphabet[character & 0x0fu];
+/** @brief A mask with a bit set for each safe byte of a 16 byte block. */
+inline int SafeMask(__m128i block, uint8_t safe) {
+  // Bytes with the top bit set compare as negative, so are never in range.
+  auto result = _mm_or_si128(
+      _mm_or_si128(InRange(block, 'A', 'Z'), InRange(block, 'a', 'z')),
+      InRange(block, '0', '9'));
+  result = _mm_or_si128(
+      result, _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('-')),
+                           _mm_cmpeq_epi8(block, _mm_set1_epi8('_'))));
+  result = _mm_or_si128(
+      result, _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('.')),
+                           _mm_cmpeq_epi8(block, _mm_set1_epi8('~'))));
+  if (safe & FormSafe) {
+    result = _mm_or_si128(result, _mm_cmpeq_epi8(block, _mm_set1_epi8('+')));
+  }
+  return _mm_movemask_epi8(result);
+}
+#endif
+
+/** @brief The number of safe characters at the start of the given data. */
+size_t SafeRunLength(const char *data, size_t size, uint8_t safe) {
+  size_t length = 0;
+#ifdef __SSE2__
+  for (; length + 16 <= size; length += 16) {
+    auto block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + length));
+    auto mask = SafeMask(block, safe);
+    if (mask != 0xffff) {
+      return length + __builtin_ctz(~mask);
     }
   }
-  return builder.str();
+#endif
+  while (length < size && IsSafe(data[length], safe)) {
+    ++length;
+  }
+  return length;
 }
 
-absl::optional<std::string> SafeDecode(absl::string_view in,
-                                       SafeCharacterFunc IsSafe) {
-  std::stringstream builder;
-  auto iter = in.cbegin();
-  while (iter != in.cend()) {
-    // unreserved characters: see https://www.ietf.org/rfc/rfc3986.txt
-    char character = *iter;
-    if (IsSafe(character)) {
-      builder << character;
+/** @brief Percent encode the given data, appending it to out.
+ *
+ * When encoding form data, spaces are encoded as '+'.
+ *
+ * @param in the data to encode.
+ * @param safe the class of characters that are not encoded.
+ * @param out the string to append to.
+ */
+void SafeEncode(absl::string_view in, uint8_t safe, std::string *out) {
+  // Size the output exactly before writing to it.
+  size_t encoded_size = 0;
+  for (size_t position = 0; position < in.size();) {
+    auto run = SafeRunLength(in.data() + position, in.size() - position, safe);
+    encoded_size += run;
+    position += run;
+    if (position < in.size()) {
+      encoded_size += (safe & FormSafe) && in[position] == ' ' ? 1 : 3;
+      ++position;
+    }
+  }
+
+  auto offset = out->size();
+  out->resize(offset + encoded_size);
+  auto output = &(*out)[offset];
+  for (size_t position = 0; position < in.size();) {
+    auto run = SafeRunLength(in.data() + position, in.size() - position, safe);
+    memcpy(output, in.data() + position, run);
+    output += run;
+    position += run;
+    if (position == in.size()) {
+      break;
+    }
+    auto character = uint8_t(in[position++]);
+    if ((safe & FormSafe) && character == ' ') {
+      *output++ = '+';
     } else {
-      // Must be percent encoding.
-      if (character != '%') {
-        return absl::optional<std::string>();
-      }
-      auto first = ++iter;
-      // Fail if either there's no more data or the value is out of range
-      // (non-ascii).
-      if (first == in.cend() || (*first & 0x80)) {
-        return absl::nullopt;
-      }
-      auto second = ++iter;
-      // Fail if either there's no more data or the value is out of range
-      // (non-ascii).
-      if (second == in.cend() || (*second & 0x80)) {
-        return absl::optional<std::string>();
-      }
-      auto top_nibble = reverse_alphabet[uint8_t(*first) & 0x7fu];
-      auto bottom_nibble = reverse_alphabet[uint8_t(*second) & 0x7fu];
-      // The character is invalid if it is set to the value 255 in the reverse
-      // alphabet.
-      if ((top_nibble == 255) || (bottom_nibble == 255)) {
-        return absl::nullopt;
-      }
       // percent encode
-      builder << char(((top_nibble << 4u) | bottom_nibble));
+      output[0] = '%';
+      output[1] = forward_alphabet[character >> 4u];
+      output[2] = forward_alphabet[character & 0x0fu];
+      output += 3;
     }
-    iter++;
   }
-  return builder.str();
 }
 
-}  // namespace
+std::string SafeEncode(absl::string_view in, uint8_t safe) {
+  std::string result;
+  SafeEncode(in, safe, &result);
+  return result;
+}
 
-std::string http::UrlSafeEncode(absl::string_view url) {
-  return SafeEncode(url, IsUrlSafeCharacter);
+/** @brief Percent decode the given data, appending it to out.
+ *
+ * When decoding form data, '+' is decoded as a space. This includes an
+ * encoded '+'.
+ *
+ * @param in the data to decode.
+ * @param safe the class of characters that may appear unencoded.
+ * @param out the string to append to. Nothing is appended on failure.
+ * @return whether the data is validly encoded.
+ */
+bool SafeDecode(absl::string_view in, uint8_t safe, std::string *out) {
+  // Decoding never grows the data.
+  auto offset = out->size();
+  out->resize(offset + in.size());
+  auto begin = &(*out)[offset];
+  auto output = begin;
+  for (size_t position = 0; position < in.size();) {
+    auto run = SafeRunLength(in.data() + position, in.size() - position, safe);
+    memcpy(output, in.data() + position, run);
+    output += run;
+    position += run;
+    if (position == in.size()) {
+      break;
+    }
+    // Must be percent encoding.
+    if (in[position] != '%' || in.size() - position < 3) {
+      out->resize(offset);
+      return false;
+    }
+    // Fail if the value is out of range (non-ascii).
+    auto first = uint8_t(in[position + 1]);
+    auto second = uint8_t(in[position + 2]);
+    if ((first & 0x80u) || (second & 0x80u)) {
+      out->resize(offset);
+      return false;
+    }
+    auto top_nibble = reverse_alphabet[first];
+    auto bottom_nibble = reverse_alphabet[second];
+    // The character is invalid if it is set to the value 255 in the reverse
+    // alphabet.
+    if ((top_nibble == 255) || (bottom_nibble == 255)) {
+      out->resize(offset);
+      return false;
+    }
+    *output++ = char((top_nibble << 4u) | bottom_nibble);
+    position += 3;
+  }
+  if (safe & FormSafe) {
+    std::replace(begin, output, '+', ' ');
+  }
+  out->resize(offset + (output - begin));
+  return true;
 }
 
-absl::optional<std::string> http::UrlSafeDecode(absl::string_view url) {
-  return SafeDecode(url, IsUrlSafeCharacter);
+absl::optional<std::string> SafeDecode(absl::string_view in, uint8_t safe) {
+  std::string result;
+  if (!SafeDecode(in, safe, &result)) {
+    return absl::nullopt;
+  }
+  return result;
 }
 
-std::string http::EncodeQueryData(
-    const std::multimap<absl::string_view, absl::string_view> &data) {
-  std::stringstream builder;
-  auto pair = data.cbegin();
-  while (pair != data.cend()) {
-    std::string key(pair->first.data());
-    std::replace(key.begin(), key.end(), ' ', '+');
-    std::string value(pair->second.data());
-    std::replace(value.begin(), value.end(), ' ', '+');
-    builder << SafeEncode(pair->first.data(), IsUrlSafeCharacter) << '='
-            << SafeEncode(pair->second.data(), IsUrlSafeCharacter);
-    if (++pair != data.cend()) {
-      builder << "&";
-    }
+/** @brief Decode a query or form parameter.
+ *
+ * @param in the encoded parameter.
+ * @param safe the class of characters that may appear unencoded.
+ * @param scratch the arena to decode into, if decoding changes the data. Its
+ * capacity must be sufficient that appending never reallocates.
+ * @return a view of the decoded parameter, or absl::nullopt if it is not
+ * validly encoded.
+ */
+absl::optional<absl::string_view> DecodeParameter(absl::string_view in,
+                                                  uint8_t safe,
+                                                  std::string *scratch) {
+  if (SafeRunLength(in.data(), in.size(), safe) == in.size() &&
+      (!(safe & FormSafe) || in.find('+') == absl::string_view::npos)) {
+    return in;
   }
-  return builder.str();
+  auto offset = scratch->size();
+  if (!SafeDecode(in, safe, scratch)) {
+    return absl::nullopt;
+  }
+  return absl::string_view(scratch->data() + offset, scratch->size() - offset);
 }
 
-absl::optional<std::multimap<std::string, std::string>> http::DecodeQueryData(
-    absl::string_view query) {
-  std::multimap<std::string, std::string> result;
-  std::vector<std::string> parts;
-  boost::split(parts, query, boost::is_any_of("&"));
-  for (auto part : parts) {
-    std::vector<std::string> pair;
-    boost::split(pair, part, boost::is_any_of("="));
-    if (pair.size() != 2) {
+absl::optional<Parameters> ParseParameters(absl::string_view data,
+                                                 uint8_t safe,
+                                                 std::string *scratch) {
+  // Reserve enough space up front that views into the arena stay valid.
+  scratch->clear();
+  scratch->reserve(data.size());
+  Parameters result;
+  size_t position = 0;
+  while (true) {
+    auto end = data.find('&', position);
+    auto part = data.substr(position, end == absl::string_view::npos
+                                          ? absl::string_view::npos
+                                          : end - position);
+    auto equals = part.find('=');
+    if (equals == absl::string_view::npos ||
+        part.find('=', equals + 1) != absl::string_view::npos) {
       return absl::nullopt;
     }
-    auto escaped_key = SafeDecode(pair[0], IsUrlSafeCharacter);
-    if (!escaped_key.has_value()) {
+    auto key = DecodeParameter(part.substr(0, equals), safe, scratch);
+    if (!key.has_value()) {
       return absl::nullopt;
     }
-    auto escaped_value = SafeDecode(pair[1], IsUrlSafeCharacter);
-    if (!escaped_value.has_value()) {
+    auto value = DecodeParameter(part.substr(equals + 1), safe, scratch);
+    if (!value.has_value()) {
       return absl::nullopt;
     }
-    result.insert(std::make_pair(*escaped_key, *escaped_value));
+    result.emplace_back(*key, *value);
+    if (end == absl::string_view::npos) {
+      return result;
+    }
+    position = end + 1;
   }
-  return result;
 }
 
-std::string http::EncodeFormData(
-    const std::multimap<absl::string_view, absl::string_view> &data) {
-  std::stringstream builder;
-  auto pair = data.cbegin();
-  while (pair != data.cend()) {
-    std::string key(pair->first.data());
-    std::replace(key.begin(), key.end(), ' ', '+');
-    std::string value(pair->second.data());
-    std::replace(value.begin(), value.end(), ' ', '+');
-    builder << SafeEncode(key, IsFormDataSafeCharacter) << '='
-            << SafeEncode(value, IsFormDataSafeCharacter);
-    if (++pair != data.end()) {
-      builder << "&";
+/** @brief Call f with the name and value of each cookie in a Cookie header,
+ * until f returns false.
+ */
+template <typename F>
+void ForEachCookie(absl::string_view cookies, F f) {
+  // https://tools.ietf.org/html/rfc6265#section-5.4
+  auto remaining = cookies;
+  while (!remaining.empty()) {
+    // memchr is vectorized by the C library, which matters for the
+    // multi-kilobyte Cookie headers that some sites accumulate.
+    auto separator = static_cast<const char *>(
+        memchr(remaining.data(), ';', remaining.size()));
+    auto length = separator == nullptr
+                      ? remaining.size()
+                      : static_cast<size_t>(separator - remaining.data());
+    auto cookie = remaining.substr(0, length);
+    remaining.remove_prefix(separator == nullptr ? length : length + 1);
+
+    auto equals = cookie.find('=');
+    if (equals == absl::string_view::npos) {
+      continue;
+    }
+    auto name = absl::StripAsciiWhitespace(cookie.substr(0, equals));
+    if (name.empty()) {
+      continue;
+    }
+    if (!f(name, absl::StripAsciiWhitespace(cookie.substr(equals + 1)))) {
+      return;
     }
   }
-  return builder.str();
 }
 
-absl::optional<std::multimap<std::string, std::string>> http::DecodeFormData(
-    absl::string_view form) {
+// The maximum number of chunks a cookie may be split into.
+const size_t max_cookie_chunks_ = 16;
+// The first chunk of a chunked cookie is prefixed with the number of chunks
+// and this separator, which is not in the web safe base64 alphabet.
+const char chunk_count_separator_ = '.';
+
+absl::optional<std::multimap<std::string, std::string>> ToMultimap(
+    const absl::optional<Parameters> &parameters) {
+  if (!parameters.has_value()) {
+    return absl::nullopt;
+  }
   std::multimap<std::string, std::string> result;
-  std::vector<std::string> parts;
-  boost::split(parts, form, boost::is_any_of("&"));
-  for (auto part : parts) {
-    std::vector<std::string> pair;
-    boost::split(pair, part, boost::is_any_of("="));
-    if (pair.size() != 2) {
-      return absl::nullopt;
-    }
-    auto escaped_key = SafeDecode(pair[0], IsFormDataSafeCharacter);
-    if (!escaped_key.has_value()) {
-      return absl::nullopt;
+  for (const auto &parameter : *parameters) {
+    result.emplace(std::string(parameter.first.data(), parameter.first.size()),
+                   std::string(parameter.second.data(),
+                               parameter.second.size()));
+  }
+  return result;
+}
+
+}  // namespace
+
+std::string http::UrlSafeEncode(absl::string_view url) {
+  return SafeEncode(url, Unreserved);
+}
+
+absl::optional<std::string> http::UrlSafeDecode(absl::string_view url) {
+  return SafeDecode(url, Unreserved);
+}
+
+std::string http::EncodeQueryData(
+    const std::multimap<absl::string_view, absl::string_view> &data) {
+  std::string result;
+  for (auto pair = data.cbegin(); pair != data.cend(); ++pair) {
+    if (pair != data.cbegin()) {
+      result.push_back('&');
     }
-    std::replace(escaped_key->begin(), escaped_key->end(), '+', ' ');
-    auto escaped_value = SafeDecode(pair[1], IsFormDataSafeCharacter);
-    if (!escaped_value.has_value()) {
-      return absl::nullopt;
+    SafeEncode(pair->first, Unreserved, &result);
+    result.push_back('=');
+    SafeEncode(pair->second, Unreserved, &result);
+  }
+  return result;
+}
+
+absl::optional<std::multimap<std::string, std::string>> http::DecodeQueryData(
+    absl::string_view query) {
+  std::string scratch;
+  return ToMultimap(ParseQueryData(query, &scratch));
+}
+
+absl::optional<Parameters> http::ParseQueryData(absl::string_view query,
+                                                      std::string *scratch) {
+  return ParseParameters(query, Unreserved, scratch);
+}
+
+std::string http::EncodeFormData(
+    const std::multimap<absl::string_view, absl::string_view> &data) {
+  std::string result;
+  for (auto pair = data.cbegin(); pair != data.cend(); ++pair) {
+    if (pair != data.cbegin()) {
+      result.push_back('&');
     }
-    std::replace(escaped_value->begin(), escaped_value->end(), '+', ' ');
-    result.insert(std::make_pair(*escaped_key, *escaped_value));
+    SafeEncode(pair->first, FormSafe, &result);
+    result.push_back('=');
+    SafeEncode(pair->second, FormSafe, &result);
   }
   return result;
 }
 
+absl::optional<std::multimap<std::string, std::string>> http::DecodeFormData(
+    absl::string_view form) {
+  std::string scratch;
+  return ToMultimap(ParseFormData(form, &scratch));
+}
+
+absl::optional<Parameters> http::ParseFormData(absl::string_view form,
+                                                     std::string *scratch) {
+  return ParseParameters(form, FormSafe, scratch);
+}
+
 std::string http::EncodeBasicAuth(absl::string_view username,
                                   absl::string_view password) {
   return absl::StrCat(
@@ -219,21 +422,127 @@ std::string http::EncodeSetCookie(
   return builder.str();
 }
 
-absl::optional<std::map<std::string, std::string>> http::DecodeCookies(
-    absl::string_view cookies) {
-  // https://tools.ietf.org/html/rfc6265#section-5.4
-  std::map<std::string, std::string> result;
-  std::vector<absl::string_view> cookie_list = absl::StrSplit(cookies, "; ");
-  for (auto cookie : cookie_list) {
-    std::vector<absl::string_view> cookie_parts = absl::StrSplit(cookie, '=');
-    if (cookie_parts.size() != 2) {
-      // Invalid cookie encoding. Must Name=Value
-      return absl::nullopt;
+void http::FindCookies(absl::string_view cookies,
+                       absl::Span<const absl::string_view> names,
+                       absl::Span<absl::optional<absl::string_view>> values) {
+  assert(names.size() == values.size());
+  size_t wanted = names.size();
+  if (wanted == 0) {
+    return;
+  }
+  ForEachCookie(cookies, [&](absl::string_view name, absl::string_view value) {
+    for (size_t i = 0; i < names.size(); ++i) {
+      if (!values[i].has_value() && names[i] == name) {
+        values[i] = value;
+        --wanted;
+        break;
+      }
     }
-    result.emplace(std::string(cookie_parts[0].data(), cookie_parts[0].size()),
-                   std::string(cookie_parts[1].data(), cookie_parts[1].size()));
+    return wanted > 0;
+  });
+}
+
+std::vector<std::pair<std::string, std::string>> http::EncodeCookieChunks(
+    absl::string_view name, absl::string_view value, size_t max_size) {
+  std::vector<std::pair<std::string, std::string>> chunks;
+  if (name.size() + 1 + value.size() <= max_size) {
+    chunks.emplace_back(std::string(name), std::string(value));
+    return chunks;
+  }
+  // Size chunks for the longest index and count, so that every chunk fits.
+  auto max_index = std::to_string(max_cookie_chunks_ - 1);
+  auto max_count = std::to_string(max_cookie_chunks_);
+  auto overhead = name.size() + 1 + max_index.size() + 1 + max_count.size() + 1;
+  if (overhead >= max_size) {
+    return chunks;
+  }
+  auto capacity = max_size - overhead;
+  auto count = (value.size() + capacity - 1) / capacity;
+  if (count > max_cookie_chunks_) {
+    return chunks;
+  }
+  chunks.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    auto chunk = value.substr(i * capacity, capacity);
+    chunks.emplace_back(
+        absl::StrCat(name, "-", i),
+        i == 0 ? absl::StrCat(count, std::string(1, chunk_count_separator_),
+                              chunk)
+               : std::string(chunk));
+  }
+  return chunks;
+}
+
+void http::FindChunkedCookies(
+    absl::string_view cookies, absl::Span<const absl::string_view> names,
+    absl::Span<absl::optional<absl::string_view>> values,
+    absl::Span<std::string> scratch) {
+  assert(names.size() == values.size());
+  assert(names.size() == scratch.size());
+  typedef std::array<absl::optional<absl::string_view>, max_cookie_chunks_>
+      chunks_t;
+  absl::InlinedVector<chunks_t, 4> chunks(names.size());
+  // Gather whole cookies and chunks in a single scan of the header.
+  ForEachCookie(cookies, [&](absl::string_view name, absl::string_view value) {
+    for (size_t i = 0; i < names.size(); ++i) {
+      if (!absl::StartsWith(name, names[i])) {
+        continue;
+      }
+      if (name.size() == names[i].size()) {
+        if (!values[i].has_value()) {
+          values[i] = value;
+        }
+        break;
+      }
+      auto suffix = name.substr(names[i].size());
+      size_t index;
+      // Chunk indexes are written without leading zeros.
+      if (suffix.size() > 1 && suffix.size() <= 3 && suffix[0] == '-' &&
+          absl::ascii_isdigit(suffix[1]) &&
+          (suffix.size() == 2 || suffix[1] != '0') &&
+          absl::SimpleAtoi(suffix.substr(1), &index) &&
+          index < max_cookie_chunks_ && !chunks[i][index].has_value()) {
+        chunks[i][index] = value;
+        break;
+      }
+    }
+    return true;
+  });
+  // A whole cookie is preferred, as it is set in place of any chunks.
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (values[i].has_value() || !chunks[i][0].has_value()) {
+      continue;
+    }
+    auto first = *chunks[i][0];
+    auto separator = first.find(chunk_count_separator_);
+    size_t count;
+    if (separator == absl::string_view::npos ||
+        !absl::SimpleAtoi(first.substr(0, separator), &count) || count < 1 ||
+        count > max_cookie_chunks_) {
+      continue;
+    }
+    first.remove_prefix(separator + 1);
+    size_t size = first.size();
+    bool complete = true;
+    for (size_t j = 1; j < count; ++j) {
+      if (!chunks[i][j].has_value()) {
+        complete = false;
+        break;
+      }
+      size += chunks[i][j]->size();
+    }
+    if (!complete) {
+      continue;
+    }
+    auto &value = scratch[i];
+    value.clear();
+    value.reserve(size);
+    value.append(first.data(), first.size());
+    for (size_t j = 1; j < count; ++j) {
+      value.append(chunks[i][j]->data(), chunks[i][j]->size());
+    }
+    values[i] = value;
   }
-  return result;
 }
 
 std::array<std::string, 3> http::DecodePath(absl::string_view path) {
@@ -285,70 +594,269 @@ std::string http::ToUrl(const authservice::config::common::Endpoint &endpoint) {
   return builder.str();
 }
 
+http_impl::http_impl() : pool_(ConnectionPool::Default()) {}
+
+http_impl::http_impl(ConnectionPoolPtr pool) : pool_(std::move(pool)) {}
+
+namespace {
+
+/** @brief A handle for requests that complete before returning. */
+class CompletedRequest : public RequestHandle {
+ public:
+  void Cancel() override {}
+};
+
+beast::http::request<beast::http::string_body> BuildRequest(
+    beast::http::verb verb,
+    const authservice::config::common::Endpoint &endpoint,
+    const std::map<absl::string_view, absl::string_view> &headers,
+    absl::string_view body) {
+  int version = 11;
+
+  // Set up an HTTP request message
+  beast::http::request<beast::http::string_body> req{verb, endpoint.path(),
+                                                     version};
+  req.set(beast::http::field::host, endpoint.hostname());
+  for (auto header : headers) {
+    req.set(boost::beast::string_view(header.first.data(), header.first.size()),
+            boost::beast::string_view(header.second.data(),
+                                      header.second.size()));
+  }
+  if (verb != beast::http::verb::get) {
+    auto &req_body = req.body();
+    req_body.reserve(body.size());
+    req_body.append(body.begin(), body.end());
+    req.prepare_payload();
+  }
+  req.keep_alive(true);
+  return req;
+}
+
+/**
+ * AsyncPost drives a single request over a pooled connection on the pool's
+ * io_context. All of its handlers run on a strand so that cancellation does
+ * not race with completion.
+ */
+class AsyncPost : public RequestHandle,
+                  public std::enable_shared_from_this<AsyncPost> {
+ private:
+  typedef net::strand<net::io_context::executor_type> strand_t;
+
+  ConnectionPoolPtr pool_;
+  authservice::config::common::Endpoint endpoint_;
+  beast::http::request<beast::http::string_body> req_;
+  std::chrono::steady_clock::time_point deadline_;
+  callback_t callback_;
+  strand_t strand_;
+  ConnectionPool::lease_ptr_t lease_;
+  beast::flat_buffer buffer_;
+  response_t res_;
+  int attempt_;
+  bool done_;
+
+  void Complete(response_t res) {
+    if (done_) {
+      return;
+    }
+    done_ = true;
+    if (lease_) {
+      if (res && res->keep_alive()) {
+        lease_->Release();
+      }
+      // Otherwise the connection is closed when the lease is destroyed.
+      lease_.reset();
+    }
+    callback_(std::move(res));
+  }
+
+  void Acquire() {
+    auto self = shared_from_this();
+    pool_->AcquireAsync(
+        endpoint_, deadline_,
+        [self](const boost::system::error_code &ec,
+               ConnectionPool::lease_ptr_t lease) {
+          // Move the lease through a shared_ptr as handlers must be copyable.
+          auto shared = std::make_shared<ConnectionPool::lease_ptr_t>(
+              std::move(lease));
+          net::dispatch(self->strand_, [self, ec, shared]() {
+            self->OnAcquire(ec, std::move(*shared));
+          });
+        });
+  }
+
+  void OnAcquire(const boost::system::error_code &ec,
+                 ConnectionPool::lease_ptr_t lease) {
+    if (done_) {
+      // Cancelled whilst connecting. The connection is still good.
+      if (lease) {
+        lease->Release();
+      }
+      return;
+    }
+    if (ec) {
+      spdlog::info("{}: unable to connect: {}", __func__, ec.message());
+      return Complete(nullptr);
+    }
+    lease_ = std::move(lease);
+    beast::get_lowest_layer(lease_->Stream()).expires_at(deadline_);
+    beast::http::async_write(
+        lease_->Stream(), req_,
+        net::bind_executor(
+            strand_, std::bind(&AsyncPost::OnWrite, shared_from_this(),
+                               std::placeholders::_1, std::placeholders::_2)));
+  }
+
+  void OnWrite(const boost::system::error_code &ec, size_t) {
+    if (done_) {
+      return;
+    }
+    if (ec) {
+      return Retry(ec);
+    }
+    res_.reset(new beast::http::response<beast::http::string_body>);
+    beast::http::async_read(
+        lease_->Stream(), buffer_, *res_,
+        net::bind_executor(
+            strand_, std::bind(&AsyncPost::OnRead, shared_from_this(),
+                               std::placeholders::_1, std::placeholders::_2)));
+  }
+
+  void OnRead(const boost::system::error_code &ec, size_t) {
+    if (done_) {
+      return;
+    }
+    if (ec) {
+      return Retry(ec);
+    }
+    beast::get_lowest_layer(lease_->Stream()).expires_never();
+    Complete(std::move(res_));
+  }
+
+  void Retry(const boost::system::error_code &ec) {
+    // A pooled connection may have been closed by the server since it was
+    // last health checked. In that case retry once on a fresh connection.
+    if (!lease_->Reused() || attempt_ > 0 ||
+        std::chrono::steady_clock::now() >= deadline_) {
+      spdlog::info("{}: request failed: {}", __func__, ec.message());
+      return Complete(nullptr);
+    }
+    spdlog::debug("{}: pooled connection failed, retrying: {}", __func__,
+                  ec.message());
+    attempt_++;
+    lease_.reset();
+    buffer_.consume(buffer_.size());
+    Acquire();
+  }
+
+ public:
+  AsyncPost(ConnectionPoolPtr pool,
+            const authservice::config::common::Endpoint &endpoint,
+            beast::http::request<beast::http::string_body> req,
+            std::chrono::steady_clock::time_point deadline,
+            callback_t callback)
+      : pool_(pool),
+        endpoint_(endpoint),
+        req_(std::move(req)),
+        deadline_(deadline),
+        callback_(std::move(callback)),
+        strand_(pool->IoContext().get_executor()),
+        attempt_(0),
+        done_(false) {}
+
+  void Start() {
+    auto self = shared_from_this();
+    net::dispatch(strand_, [self]() { self->Acquire(); });
+  }
+
+  void Cancel() override {
+    auto self = shared_from_this();
+    net::dispatch(strand_, [self]() {
+      if (self->lease_) {
+        // Abort any outstanding operation. Its handler sees done_ set.
+        beast::get_lowest_layer(self->lease_->Stream()).cancel();
+      }
+      self->Complete(nullptr);
+    });
+  }
+};
+
+}  // namespace
+
+request_handle_t http::PostAsync(
+    const authservice::config::common::Endpoint &endpoint,
+    const std::map<absl::string_view, absl::string_view> &headers,
+    absl::string_view body, std::chrono::milliseconds,
+    callback_t callback) const {
+  callback(Post(endpoint, headers, body));
+  return std::make_shared<CompletedRequest>();
+}
+
 response_t http_impl::Post(
     const authservice::config::common::Endpoint &endpoint,
     const std::map<absl::string_view, absl::string_view> &headers,
     absl::string_view body) const {
   spdlog::trace("{}", __func__);
+  return Send(endpoint, BuildRequest(beast::http::verb::post, endpoint, headers,
+                                     body));
+}
+
+response_t http_impl::Get(
+    const authservice::config::common::Endpoint &endpoint,
+    const std::map<absl::string_view, absl::string_view> &headers) const {
+  spdlog::trace("{}", __func__);
+  return Send(endpoint,
+              BuildRequest(beast::http::verb::get, endpoint, headers, ""));
+}
+
+response_t http_impl::Send(
+    const authservice::config::common::Endpoint &endpoint,
+    const beast::http::request<beast::http::string_body> &req) const {
   try {
-    int version = 11;
-    beast::error_code ec;
-
-    // The io_context is required for all I/O
-    net::io_context ioc;
-    ssl::context ctx(ssl::context::tlsv12_client);
-    // TODO: verify_peer should be used but is not currently working.
-    ctx.set_verify_mode(ssl::verify_none);
-    ctx.set_default_verify_paths();
-
-    tcp::resolver resolver(ioc);
-    beast::ssl_stream<beast::tcp_stream> stream(ioc, ctx);
-    if (!SSL_set_tlsext_host_name(stream.native_handle(),
-                                  endpoint.hostname().c_str())) {
-      boost::system::error_code ec{static_cast<int>(::ERR_get_error()),
-                                   boost::asio::error::get_ssl_category()};
-      throw boost::system::system_error{ec};
-    }
-    const auto results =
-        resolver.resolve(endpoint.hostname(), std::to_string(endpoint.port()));
-    beast::get_lowest_layer(stream).connect(results);
-    stream.handshake(ssl::stream_base::client);
-    // Set up an HTTP POST request message
-    beast::http::request<beast::http::string_body> req{
-        beast::http::verb::post, endpoint.path(), version};
-    req.set(beast::http::field::host, endpoint.hostname());
-    for (auto header : headers) {
-      req.set(boost::beast::string_view(header.first.data()),
-              boost::beast::string_view(header.second.data()));
+    // A pooled connection may have been closed by the server since it was
+    // last health checked. In that case retry once on a fresh connection.
+    for (int attempt = 0;; ++attempt) {
+      auto lease = pool_->Acquire(endpoint);
+      try {
+        // Send the HTTP request to the remote host
+        beast::http::write(lease.Stream(), req);
+
+        // Read response
+        beast::flat_buffer buffer;
+        response_t res(new beast::http::response<beast::http::string_body>);
+        beast::http::read(lease.Stream(), buffer, *res);
+        if (res->keep_alive()) {
+          lease.Release();
+        }
+        // Otherwise the connection is closed when the lease is destroyed.
+        return res;
+      } catch (boost::system::system_error const &e) {
+        if (!lease.Reused() || attempt > 0) {
+          throw;
+        }
+        spdlog::debug("{}: pooled connection failed, retrying: {}", __func__,
+                      e.what());
+      }
     }
-    auto &req_body = req.body();
-    req_body.reserve(body.size());
-    req_body.append(body.begin(), body.end());
-    req.prepare_payload();
-    // Send the HTTP request to the remote host
-    beast::http::write(stream, req);
-
-    // Read response
-    beast::flat_buffer buffer;
-    response_t res(new beast::http::response<beast::http::string_body>);
-    beast::http::read(stream, buffer, *res);
-
-    // Gracefully close the socket
-    stream.shutdown(ec);
-    // not_connected happens sometimes
-    // so don't bother reporting it.
-    if (ec && ec != beast::errc::not_connected) {
-      spdlog::info("{}: HTTP error encountered: {}", __func__, ec.message());
-      return response_t();
-    }
-    return res;
-    // If we get here then the connection is closed gracefully
   } catch (std::exception const &e) {
     spdlog::info("{}: unexpected exception: {}", __func__, e.what());
     return response_t();
   }
 }
 
+request_handle_t http_impl::PostAsync(
+    const authservice::config::common::Endpoint &endpoint,
+    const std::map<absl::string_view, absl::string_view> &headers,
+    absl::string_view body, std::chrono::milliseconds timeout,
+    callback_t callback) const {
+  spdlog::trace("{}", __func__);
+  auto op = std::make_shared<AsyncPost>(
+      pool_, endpoint,
+      BuildRequest(beast::http::verb::post, endpoint, headers, body),
+      std::chrono::steady_clock::now() + timeout, std::move(callback));
+  op->Start();
+  return op;
+}
+
 }  // namespace http
 }  // namespace common
 }  // namespace authservice
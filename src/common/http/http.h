@@ -2,14 +2,20 @@
 #define AUTHSERVICE_SRC_COMMON_HTTP_HTTP_H_
 #include <array>
 #include <boost/beast.hpp>
+#include <chrono>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
+#include "absl/container/inlined_vector.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "config/common/config.pb.h"
+#include "src/common/http/connection_pool.h"
 namespace beast = boost::beast;  // from <boost/beast.hpp>
 
 namespace authservice {
@@ -20,6 +26,24 @@ class http;
 typedef std::shared_ptr<http> ptr_t;
 typedef std::unique_ptr<beast::http::response<beast::http::string_body>>
     response_t;
+typedef std::function<void(response_t)> callback_t;
+/** @brief Key and value pairs parsed from query or form data. */
+typedef absl::InlinedVector<std::pair<absl::string_view, absl::string_view>,
+                            4>
+    Parameters;
+
+/** @brief A handle on an in-flight asynchronous request. */
+class RequestHandle {
+ public:
+  virtual ~RequestHandle() = default;
+  /** @brief Abort the request.
+   *
+   * The request's callback is invoked with a null response if it has not
+   * already been invoked.
+   */
+  virtual void Cancel() = 0;
+};
+typedef std::shared_ptr<RequestHandle> request_handle_t;
 
 class http {
  public:
@@ -54,6 +78,19 @@ class http {
    */
   static absl::optional<std::multimap<std::string, std::string>>
   DecodeQueryData(absl::string_view query);
+  /**
+   * @brief parse query data without copying it.
+   *
+   * Keys and values are views into the query, except for those that contain
+   * percent encoding, which are decoded into the scratch arena.
+   *
+   * @param query the query to be parsed
+   * @param scratch the arena for decoded keys and values. It is cleared, and
+   * must not be modified while the result is in use.
+   * @return the parsed query in order, or absl::nullopt if it is invalid
+   */
+  static absl::optional<Parameters> ParseQueryData(absl::string_view query,
+                                                   std::string *scratch);
   /** @brief encode form data.
    *
    * @param data the data to encode.
@@ -68,6 +105,17 @@ class http {
    */
   static absl::optional<std::multimap<std::string, std::string>> DecodeFormData(
       absl::string_view form);
+  /** @brief Parse form-encoded data without copying it.
+   *
+   * As ParseQueryData, except that '+' is decoded as a space.
+   *
+   * @param form the form-encoded data to parse.
+   * @param scratch the arena for decoded keys and values. It is cleared, and
+   * must not be modified while the result is in use.
+   * @return the parsed form in order, or absl::nullopt if it is invalid.
+   */
+  static absl::optional<Parameters> ParseFormData(absl::string_view form,
+                                                  std::string *scratch);
 
   /** @brief Encode basic auth parameters for use in an authorization header.
    *
@@ -93,12 +141,58 @@ class http {
       const std::set<absl::string_view> &directives);
 
   /**
-   * Decode a Cookie header value into cookies.
-   * @param cookies The Cookie header value.
-   * @return A map of Cookies or a nullopt.
+   * Find the named cookies in a Cookie header value.
+   *
+   * The header is scanned once and the values returned are views into it.
+   * Parsing is tolerant: pairs without a name are skipped, values may contain
+   * '=', and whitespace around names and values is ignored. If a cookie
+   * appears more than once the first value is used.
+   *
+   * @param cookies the Cookie header value.
+   * @param names the names of the cookies to find.
+   * @param values set to the value of each named cookie that is found, in the
+   * same order as names. Must be the same size as names.
+   */
+  static void FindCookies(absl::string_view cookies,
+                          absl::Span<const absl::string_view> names,
+                          absl::Span<absl::optional<absl::string_view>> values);
+
+  /**
+   * Split a cookie that is too large for browsers to store into chunks.
+   *
+   * A cookie whose name and value fit in max_size is returned whole.
+   * Otherwise its value is split across cookies named name-0, name-1, and so
+   * on, and the first chunk's value records the number of chunks.
+   *
+   * @param name the cookie's name.
+   * @param value the cookie's value.
+   * @param max_size the maximum size of each cookie's name and value.
+   * @return the names and values of the cookies to set, or none if the value
+   * needs more than 16 chunks.
    */
-  static absl::optional<std::map<std::string, std::string>> DecodeCookies(
-      absl::string_view cookies);
+  static std::vector<std::pair<std::string, std::string>> EncodeCookieChunks(
+      absl::string_view name, absl::string_view value, size_t max_size);
+
+  /**
+   * Find the named cookies in a Cookie header value, reassembling any that
+   * were split by EncodeCookieChunks.
+   *
+   * The header is scanned once. Whole cookies are returned as views into it,
+   * and reassembled cookies as views into scratch. A whole cookie takes
+   * precedence over chunks of the same name, and chunks that are incomplete
+   * are ignored.
+   *
+   * @param cookies the Cookie header value.
+   * @param names the names of the cookies to find.
+   * @param values set to the value of each named cookie that is found, in the
+   * same order as names. Must be the same size as names.
+   * @param scratch storage for reassembled values. Must be the same size as
+   * names, and outlive the values.
+   */
+  static void FindChunkedCookies(
+      absl::string_view cookies, absl::Span<const absl::string_view> names,
+      absl::Span<absl::optional<absl::string_view>> values,
+      absl::Span<std::string> scratch);
 
   /**
    * Decode a path into a path, query and fragment triple.
@@ -130,16 +224,73 @@ class http {
       const std::map<absl::string_view, absl::string_view> &headers,
       absl::string_view body)
       const = 0;  // TODO: use string_view instead of const char *
+
+  /** @brief Send a Get http message.
+   *
+   * @param endpoint the endpoint to call
+   * @param headers the http headers
+   * @return http response.
+   */
+  virtual response_t Get(
+      const authservice::config::common::Endpoint &endpoint,
+      const std::map<absl::string_view, absl::string_view> &headers) const = 0;
+
+  /** @brief Send a Post http message without blocking the caller.
+   *
+   * The callback is invoked exactly once with the response, or with a null
+   * response on failure, timeout or cancellation. The default implementation
+   * calls Post synchronously and invokes the callback before returning.
+   *
+   * @param endpoint the endpoint to call
+   * @param headers the http headers
+   * @param body the http request body
+   * @param timeout the time allowed for the whole exchange
+   * @param callback invoked with the http response.
+   * @return a handle that can be used to cancel the request.
+   */
+  virtual request_handle_t PostAsync(
+      const authservice::config::common::Endpoint &endpoint,
+      const std::map<absl::string_view, absl::string_view> &headers,
+      absl::string_view body, std::chrono::milliseconds timeout,
+      callback_t callback) const;
 };
 
 /**
  * HTTP request implementation
  */
 class http_impl : public http {
+ private:
+  ConnectionPoolPtr pool_;
+
+  /** @brief Send a request over a pooled connection.
+   *
+   * @param endpoint the endpoint to call
+   * @param req the request to send
+   * @return http response, or null on failure.
+   */
+  response_t Send(
+      const authservice::config::common::Endpoint &endpoint,
+      const beast::http::request<beast::http::string_body> &req) const;
+
  public:
+  /** @brief Construct an http_impl using the process-wide connection pool. */
+  http_impl();
+  /** @brief Construct an http_impl using the given connection pool. */
+  explicit http_impl(ConnectionPoolPtr pool);
+
   response_t Post(const authservice::config::common::Endpoint &Endpoint,
                   const std::map<absl::string_view, absl::string_view> &headers,
                   absl::string_view body) const override;
+
+  response_t Get(const authservice::config::common::Endpoint &endpoint,
+                 const std::map<absl::string_view, absl::string_view>
+                     &headers) const override;
+
+  request_handle_t PostAsync(
+      const authservice::config::common::Endpoint &endpoint,
+      const std::map<absl::string_view, absl::string_view> &headers,
+      absl::string_view body, std::chrono::milliseconds timeout,
+      callback_t callback) const override;
 };
 
 }  // namespace http
@@ -0,0 +1,84 @@
+#include "tls_session_cache.h"
+#include "src/common/metrics/metrics.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+namespace {
+const char *full_handshakes_metric_ = "tls_handshakes_full_total";
+const char *resumed_handshakes_metric_ = "tls_handshakes_resumed_total";
+
+int CacheIndex() {
+  static int index =
+      SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+
+void FreeServer(void *, void *server, CRYPTO_EX_DATA *, int, long, void *) {
+  delete static_cast<std::string *>(server);
+}
+
+// The server a connection was made to, as given to Resume.
+int ServerIndex() {
+  static int index =
+      SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, &FreeServer);
+  return index;
+}
+}  // namespace
+
+TlsSessionCache::TlsSessionCache(SSL_CTX *ctx) {
+  SSL_CTX_set_ex_data(ctx, CacheIndex(), this);
+  // We hold on to sessions ourselves, keyed by hostname, so there is no need
+  // for the context's internal store.
+  SSL_CTX_set_session_cache_mode(
+      ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx, &TlsSessionCache::OnNewSession);
+}
+
+int TlsSessionCache::OnNewSession(SSL *ssl, SSL_SESSION *session) {
+  auto cache = static_cast<TlsSessionCache *>(
+      SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), CacheIndex()));
+  auto server = static_cast<std::string *>(SSL_get_ex_data(ssl, ServerIndex()));
+  if (cache == nullptr || server == nullptr) {
+    return 0;
+  }
+  std::unique_lock<std::mutex> lock(cache->mtx_);
+  auto entry = cache->sessions_.find(*server);
+  if (entry == cache->sessions_.end()) {
+    cache->sessions_.emplace(*server,
+                             session_ptr_t(session, &SSL_SESSION_free));
+  } else {
+    entry->second.reset(session);
+  }
+  // Returning 1 takes ownership of the session.
+  return 1;
+}
+
+void TlsSessionCache::Resume(SSL *ssl, const std::string &server) {
+  delete static_cast<std::string *>(SSL_get_ex_data(ssl, ServerIndex()));
+  SSL_set_ex_data(ssl, ServerIndex(), new std::string(server));
+  std::unique_lock<std::mutex> lock(mtx_);
+  auto entry = sessions_.find(server);
+  if (entry != sessions_.end()) {
+    // SSL_set_session takes its own reference to the session.
+    SSL_set_session(ssl, entry->second.get());
+  }
+}
+
+void TlsSessionCache::Record(SSL *ssl) {
+  auto &metrics = metrics::Registry::Instance();
+  if (SSL_session_reused(ssl)) {
+    metrics.GetCounter(resumed_handshakes_metric_).Increment();
+  } else {
+    metrics.GetCounter(full_handshakes_metric_).Increment();
+  }
+}
+
+size_t TlsSessionCache::Size() {
+  std::unique_lock<std::mutex> lock(mtx_);
+  return sessions_.size();
+}
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,63 @@
+#ifndef AUTHSERVICE_SRC_COMMON_HTTP_TLS_SESSION_CACHE_H_
+#define AUTHSERVICE_SRC_COMMON_HTTP_TLS_SESSION_CACHE_H_
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "openssl/ssl.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+
+/** @brief A client-side cache of TLS sessions keyed by server.
+ *
+ * TlsSessionCache attaches to a client SSL_CTX and records the sessions (and
+ * session tickets) that servers issue, keyed by the server's host and port.
+ * New connections to the same server offer the most recent session so that
+ * the server can perform an abbreviated handshake. Different ports on one
+ * host may be different servers, so they do not share sessions.
+ */
+class TlsSessionCache {
+ private:
+  typedef std::unique_ptr<SSL_SESSION, decltype(&SSL_SESSION_free)>
+      session_ptr_t;
+
+  std::mutex mtx_;
+  std::map<std::string, session_ptr_t> sessions_;
+
+  /** @brief SSL_CTX new session callback. */
+  static int OnNewSession(SSL *ssl, SSL_SESSION *session);
+
+ public:
+  /** @brief Attach a session cache to the given client context.
+   *
+   * The context must not outlive the cache.
+   * @param ctx the client context.
+   */
+  explicit TlsSessionCache(SSL_CTX *ctx);
+
+  /** @brief Offer a cached session for the given server, if there is one.
+   *
+   * Must be called before the handshake, for every connection whose session
+   * should be cached.
+   * @param ssl the connection.
+   * @param server the server, as host:port.
+   */
+  void Resume(SSL *ssl, const std::string &server);
+
+  /** @brief Record whether a completed handshake resumed a session.
+   *
+   * @param ssl the connection.
+   */
+  void Record(SSL *ssl);
+
+  /** @brief The number of servers with a cached session. */
+  size_t Size();
+};
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_COMMON_HTTP_TLS_SESSION_CACHE_H_
@@ -0,0 +1,69 @@
+#include "metrics.h"
+#include "absl/strings/str_cat.h"
+
+namespace authservice {
+namespace common {
+namespace metrics {
+
+Counter::Counter() : value_(0) {}
+
+void Counter::Increment(uint64_t amount) {
+  value_.fetch_add(amount, std::memory_order_relaxed);
+}
+
+uint64_t Counter::Value() const {
+  return value_.load(std::memory_order_relaxed);
+}
+
+Gauge::Gauge() : value_(0) {}
+
+void Gauge::Set(int64_t value) {
+  value_.store(value, std::memory_order_relaxed);
+}
+
+void Gauge::Add(int64_t amount) {
+  value_.fetch_add(amount, std::memory_order_relaxed);
+}
+
+int64_t Gauge::Value() const { return value_.load(std::memory_order_relaxed); }
+
+Registry &Registry::Instance() {
+  // Intentionally leaked so that metrics may be updated during static
+  // destruction.
+  static Registry *instance = new Registry;
+  return *instance;
+}
+
+Counter &Registry::GetCounter(absl::string_view name) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  auto &counter = counters_[std::string(name)];
+  if (!counter) {
+    counter.reset(new Counter);
+  }
+  return *counter;
+}
+
+Gauge &Registry::GetGauge(absl::string_view name) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  auto &gauge = gauges_[std::string(name)];
+  if (!gauge) {
+    gauge.reset(new Gauge);
+  }
+  return *gauge;
+}
+
+std::string Registry::Dump() const {
+  std::unique_lock<std::mutex> lock(mtx_);
+  std::string result;
+  for (const auto &counter : counters_) {
+    absl::StrAppend(&result, counter.first, " ", counter.second->Value(), "\n");
+  }
+  for (const auto &gauge : gauges_) {
+    absl::StrAppend(&result, gauge.first, " ", gauge.second->Value(), "\n");
+  }
+  return result;
+}
+
+}  // namespace metrics
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,71 @@
+#ifndef AUTHSERVICE_SRC_COMMON_METRICS_METRICS_H_
+#define AUTHSERVICE_SRC_COMMON_METRICS_METRICS_H_
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "absl/strings/string_view.h"
+
+namespace authservice {
+namespace common {
+namespace metrics {
+
+/** @brief A monotonically increasing value. */
+class Counter {
+ private:
+  std::atomic<uint64_t> value_;
+
+ public:
+  Counter();
+  void Increment(uint64_t amount = 1);
+  uint64_t Value() const;
+};
+
+/** @brief A value that can go up and down. */
+class Gauge {
+ private:
+  std::atomic<int64_t> value_;
+
+ public:
+  Gauge();
+  void Set(int64_t value);
+  void Add(int64_t amount);
+  int64_t Value() const;
+};
+
+/** @brief A process-wide collection of named metrics.
+ *
+ * Metrics are created on first use and live for the lifetime of the process,
+ * so callers may hold on to the returned references. Updating a metric never
+ * takes a lock.
+ */
+class Registry {
+ private:
+  mutable std::mutex mtx_;
+  std::map<std::string, std::unique_ptr<Counter>> counters_;
+  std::map<std::string, std::unique_ptr<Gauge>> gauges_;
+
+ public:
+  /** @brief The process-wide registry. */
+  static Registry &Instance();
+
+  /** @brief Get or create the counter with the given name. */
+  Counter &GetCounter(absl::string_view name);
+
+  /** @brief Get or create the gauge with the given name. */
+  Gauge &GetGauge(absl::string_view name);
+
+  /** @brief Render all metrics, one `name value` pair per line, for logging.
+   *
+   * @return the rendered metrics.
+   */
+  std::string Dump() const;
+};
+
+}  // namespace metrics
+}  // namespace common
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_COMMON_METRICS_METRICS_H_
@@ -0,0 +1,196 @@
+#include "src/common/session/compact_token.h"
+#include <zlib.h>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+namespace {
+// Packed tokens are laid out as:
+//     marker || flags || varint expiry, if flagged || token
+// where the token is either kept verbatim, if flagged, or packed as:
+//     varint sizes of the decoded header, claims and signature ||
+//     header and claims, deflated if flagged || signature
+// No JWT or opaque token starts with the marker, which tells packed tokens
+// apart from those stored as they are.
+const char marker_ = '\0';
+const uint8_t deflated_ = 1;
+const uint8_t expiry_ = 2;
+const uint8_t verbatim_ = 4;
+// Tokens are stored in at most 16 cookies of 4KB, so no real token expands
+// past this.
+const uint64_t max_expanded_size_ = 64 * 1024;
+
+void AppendVarint(uint64_t value, std::string &out) {
+  for (; value >= 0x80; value >>= 7) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+bool ConsumeVarint(absl::string_view &in, uint64_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+    auto byte = static_cast<uint8_t>(in.front());
+    in.remove_prefix(1);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Decode a segment of a JWT, which must be in the unpadded encoding that
+// ExpandToken produces for the token to be rebuilt exactly.
+bool DecodeSegment(absl::string_view segment, std::string &out) {
+  return absl::WebSafeBase64Unescape(segment, &out) &&
+         absl::WebSafeBase64Escape(out) == segment;
+}
+
+// Raw deflate, without a zlib header or checksum: the AEAD the packed token
+// is sealed with already detects corruption.
+bool Deflate(absl::string_view in, std::string &out) {
+  z_stream stream = {};
+  if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 9,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+  out.resize(deflateBound(&stream, in.size()));
+  stream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+  stream.avail_in = in.size();
+  stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+  stream.avail_out = out.size();
+  auto result = deflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  return result == Z_STREAM_END;
+}
+
+bool Inflate(absl::string_view in, size_t size, std::string &out) {
+  z_stream stream = {};
+  if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+    return false;
+  }
+  out.resize(size);
+  stream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+  stream.avail_in = in.size();
+  stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+  stream.avail_out = out.size();
+  auto result = inflate(&stream, Z_FINISH);
+  inflateEnd(&stream);
+  return result == Z_STREAM_END && stream.avail_in == 0 &&
+         stream.total_out == size;
+}
+}  // namespace
+
+std::string CompactToken(absl::string_view token,
+                         absl::optional<int64_t> expiry) {
+  uint8_t flags = 0;
+  std::string compact(1, marker_);
+  compact.push_back(static_cast<char>(flags));
+  if (expiry.has_value()) {
+    flags |= expiry_;
+    AppendVarint(static_cast<uint64_t>(std::max<int64_t>(*expiry, 0)),
+                 compact);
+  }
+
+  std::vector<absl::string_view> segments = absl::StrSplit(token, '.');
+  std::string header, claims, signature;
+  if (segments.size() != 3 || !DecodeSegment(segments[0], header) ||
+      !DecodeSegment(segments[1], claims) ||
+      !DecodeSegment(segments[2], signature) ||
+      header.size() + claims.size() > max_expanded_size_) {
+    if (!expiry.has_value()) {
+      return std::string(token);
+    }
+    compact[1] = static_cast<char>(flags | verbatim_);
+    compact.append(token.data(), token.size());
+    return compact;
+  }
+
+  auto json = absl::StrCat(header, claims);
+  std::string deflated;
+  if (Deflate(json, deflated) && deflated.size() < json.size()) {
+    flags |= deflated_;
+    json.swap(deflated);
+  }
+  compact[1] = static_cast<char>(flags);
+  AppendVarint(header.size(), compact);
+  AppendVarint(claims.size(), compact);
+  AppendVarint(signature.size(), compact);
+  compact.append(json);
+  compact.append(signature);
+  if (!expiry.has_value() && compact.size() >= token.size()) {
+    return std::string(token);
+  }
+  return compact;
+}
+
+absl::optional<std::string> ExpandToken(absl::string_view compact) {
+  absl::optional<int64_t> expiry;
+  return ExpandToken(compact, expiry);
+}
+
+absl::optional<std::string> ExpandToken(absl::string_view compact,
+                                        absl::optional<int64_t> &expiry) {
+  expiry = absl::nullopt;
+  if (compact.empty() || compact.front() != marker_) {
+    return std::string(compact);
+  }
+  if (compact.size() < 2) {
+    return absl::nullopt;
+  }
+  auto flags = static_cast<uint8_t>(compact[1]);
+  auto in = compact.substr(2);
+  if ((flags & ~(deflated_ | expiry_ | verbatim_)) != 0) {
+    return absl::nullopt;
+  }
+  if (flags & expiry_) {
+    uint64_t value;
+    if (!ConsumeVarint(in, value) ||
+        value > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+      return absl::nullopt;
+    }
+    expiry = static_cast<int64_t>(value);
+  }
+  if (flags & verbatim_) {
+    return std::string(in);
+  }
+  uint64_t header_size, claims_size, signature_size;
+  if (!ConsumeVarint(in, header_size) ||
+      !ConsumeVarint(in, claims_size) || !ConsumeVarint(in, signature_size) ||
+      header_size > max_expanded_size_ ||
+      claims_size > max_expanded_size_ - header_size ||
+      signature_size > in.size()) {
+    return absl::nullopt;
+  }
+  auto json = in.substr(0, in.size() - signature_size);
+  auto signature = in.substr(in.size() - signature_size);
+  std::string inflated;
+  if (flags & deflated_) {
+    if (!Inflate(json, header_size + claims_size, inflated)) {
+      return absl::nullopt;
+    }
+    json = inflated;
+  } else if (json.size() != header_size + claims_size) {
+    return absl::nullopt;
+  }
+  return absl::StrCat(absl::WebSafeBase64Escape(json.substr(0, header_size)),
+                      ".",
+                      absl::WebSafeBase64Escape(json.substr(header_size)),
+                      ".", absl::WebSafeBase64Escape(signature));
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,50 @@
+#ifndef AUTHSERVICE_SRC_COMMON_SESSION_COMPACT_TOKEN_H_
+#define AUTHSERVICE_SRC_COMMON_SESSION_COMPACT_TOKEN_H_
+#include <cstdint>
+#include <string>
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+/** @brief Pack a token into a compact binary form for storing in a cookie.
+ *
+ * The segments of a JWT are stored as raw bytes rather than base64, and its
+ * JSON header and claims are deflated when that makes them smaller. The
+ * signature is kept, so that ExpandToken can rebuild the exact token the IdP
+ * signed. Without an expiry, tokens that are not JWTs in canonical encoding,
+ * or that packing would not shrink, are returned as they are.
+ *
+ * @param token the token to pack.
+ * @param expiry when the token expires, in unix seconds, to store alongside
+ * it so that it can be checked without parsing the token.
+ * @return the packed token.
+ */
+std::string CompactToken(absl::string_view token,
+                         absl::optional<int64_t> expiry = absl::nullopt);
+
+/** @brief Rebuild a token packed by CompactToken.
+ *
+ * Tokens that were stored as they are, including those stored before
+ * CompactToken was introduced, are returned unchanged.
+ *
+ * @param compact the packed token.
+ * @return the token, or nullopt if compact is malformed.
+ */
+absl::optional<std::string> ExpandToken(absl::string_view compact);
+
+/** @brief Rebuild a token packed by CompactToken, along with its expiry.
+ *
+ * @param compact the packed token.
+ * @param expiry set to the expiry stored with the token, if any.
+ * @return the token, or nullopt if compact is malformed.
+ */
+absl::optional<std::string> ExpandToken(absl::string_view compact,
+                                        absl::optional<int64_t> &expiry);
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
+#endif  // AUTHSERVICE_SRC_COMMON_SESSION_COMPACT_TOKEN_H_
@@ -11,6 +11,7 @@ class GcmEncryptorImpl : public GcmEncryptor {
  public:
   GcmEncryptorImpl(const std::vector<unsigned char>& key,
                    size_t tag_len = EVP_AEAD_DEFAULT_TAG_LENGTH);
+  GcmEncryptorImpl(const EVP_AEAD* aead, const std::vector<unsigned char>& key);
   virtual ~GcmEncryptorImpl() override;
 
   virtual std::vector<unsigned char> Seal(
@@ -21,6 +22,15 @@ class GcmEncryptorImpl : public GcmEncryptor {
       const std::vector<unsigned char>& ciphertext,
       const std::vector<unsigned char>& aad = {}) override;
 
+  virtual size_t NonceLength() const override;
+  virtual size_t Overhead() const override;
+  virtual size_t Seal(absl::Span<const uint8_t> plaintext,
+                      absl::Span<const uint8_t> aad,
+                      absl::Span<uint8_t> out) override;
+  virtual absl::optional<size_t> Open(absl::Span<const uint8_t> ciphertext,
+                                      absl::Span<const uint8_t> aad,
+                                      absl::Span<uint8_t> out) override;
+
  private:
   bssl::UniquePtr<EVP_AEAD_CTX> ctx_;
 };
@@ -40,6 +50,16 @@ GcmEncryptorImpl::GcmEncryptorImpl(const std::vector<unsigned char>& key,
   assert(ctx_);
 }
 
+GcmEncryptorImpl::GcmEncryptorImpl(const EVP_AEAD* aead,
+                                   const std::vector<unsigned char>& key) {
+  if (key.size() != EVP_AEAD_key_length(aead)) {
+    throw std::range_error("AEAD key is incorrect size");
+  }
+  ctx_.reset(EVP_AEAD_CTX_new(aead, key.data(), key.size(),
+                              EVP_AEAD_DEFAULT_TAG_LENGTH));
+  assert(ctx_);
+}
+
 GcmEncryptorImpl::~GcmEncryptorImpl() {
   EVP_AEAD_CTX_cleanup(ctx_.get());
   ctx_.reset(nullptr);
@@ -116,11 +136,69 @@ absl::optional<std::vector<unsigned char>> GcmEncryptorImpl::Open(
   return out;
 }
 
+size_t GcmEncryptorImpl::NonceLength() const {
+  return EVP_AEAD_nonce_length(EVP_AEAD_CTX_aead(ctx_.get()));
+}
+
+size_t GcmEncryptorImpl::Overhead() const {
+  auto aead = EVP_AEAD_CTX_aead(ctx_.get());
+  return EVP_AEAD_nonce_length(aead) + EVP_AEAD_max_overhead(aead);
+}
+
+size_t GcmEncryptorImpl::Seal(absl::Span<const uint8_t> plaintext,
+                              absl::Span<const uint8_t> aad,
+                              absl::Span<uint8_t> out) {
+  auto nonce_len = NonceLength();
+  if (out.size() < plaintext.size() + Overhead()) {
+    throw std::range_error("GCM output buffer is too small");
+  }
+
+  int rc = RAND_bytes(out.data(), nonce_len);
+  assert(rc == 1);
+
+  // Result ciphertext will then contain:
+  //     nonce || ciphertext || tag
+  size_t out_len = 0;
+  rc = EVP_AEAD_CTX_seal(ctx_.get(), out.data() + nonce_len, &out_len,
+                         out.size() - nonce_len, out.data(), nonce_len,
+                         plaintext.data(), plaintext.size(), aad.data(),
+                         aad.size());
+  assert(rc == 1);
+  (void)rc;
+  return nonce_len + out_len;
+}
+
+absl::optional<size_t> GcmEncryptorImpl::Open(
+    absl::Span<const uint8_t> ciphertext, absl::Span<const uint8_t> aad,
+    absl::Span<uint8_t> out) {
+  auto nonce_len = NonceLength();
+  if (ciphertext.size() < nonce_len ||
+      out.size() < ciphertext.size() - nonce_len) {
+    return absl::nullopt;
+  }
+
+  size_t out_len = 0;
+  auto rc = EVP_AEAD_CTX_open(
+      ctx_.get(), out.data(), &out_len, ciphertext.size() - nonce_len,
+      ciphertext.data(), nonce_len, ciphertext.data() + nonce_len,
+      ciphertext.size() - nonce_len, aad.data(), aad.size());
+  if (rc != 1) {
+    // Decryption or validation failed in some way
+    return absl::nullopt;
+  }
+  return out_len;
+}
+
 GcmEncryptorPtr GcmEncryptor::Create(const std::vector<unsigned char>& key,
                                      size_t tag_len) {
   return std::make_shared<GcmEncryptorImpl>(key, tag_len);
 }
 
+GcmEncryptorPtr GcmEncryptor::Create(const EVP_AEAD* aead,
+                                     const std::vector<unsigned char>& key) {
+  return std::make_shared<GcmEncryptorImpl>(aead, key);
+}
+
 }  // namespace session
 }  // namespace common
 }  // namespace authservice
@@ -1,9 +1,11 @@
 #ifndef AUTHSERVICE_SRC_COMMON_SESSION_GCM_ENCRYPTOR_H_
 #define AUTHSERVICE_SRC_COMMON_SESSION_GCM_ENCRYPTOR_H_
+#include <cstdint>
 #include <memory>
 #include <vector>
 
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "openssl/aead.h"
 
 namespace authservice {
@@ -42,6 +44,47 @@ class GcmEncryptor {
       const std::vector<unsigned char>& ciphertext,
       const std::vector<unsigned char>& aad = {}) = 0;
 
+  /**
+   * The length of the nonce that prefixes sealed data.
+   * @return the nonce length in bytes.
+   */
+  virtual size_t NonceLength() const = 0;
+
+  /**
+   * The most bytes that sealing adds to a plaintext, for the nonce and tag.
+   * @return the overhead in bytes.
+   */
+  virtual size_t Overhead() const = 0;
+
+  /**
+   * GCM encrypt and authenticate some data into a caller supplied buffer with
+   * a randomly generated nonce.
+   * @param plaintext the data to encrypt and authenticate.
+   * @param aad       additional authenticated data.
+   * @param out       the buffer to write nonce || ciphertext || tag to. It must
+   * hold at least plaintext.size() + Overhead() bytes and must not overlap the
+   * plaintext.
+   * @return the number of bytes written.
+   */
+  virtual size_t Seal(absl::Span<const uint8_t> plaintext,
+                      absl::Span<const uint8_t> aad,
+                      absl::Span<uint8_t> out) = 0;
+
+  /**
+   * GCM decrypt and verify some data into a caller supplied buffer.
+   * @param ciphertext the data (nonce || ciphertext || tag) to be decrypted.
+   * @param aad        additional authenticated data.
+   * @param out        the buffer to write the plaintext to. It must hold at
+   * least as many bytes as follow the nonce in the ciphertext. It may start
+   * exactly where they do, to decrypt in place, but must not otherwise
+   * overlap the ciphertext.
+   * @return the length of the plaintext, or absl::nullopt if verification
+   * failed.
+   */
+  virtual absl::optional<size_t> Open(absl::Span<const uint8_t> ciphertext,
+                                      absl::Span<const uint8_t> aad,
+                                      absl::Span<uint8_t> out) = 0;
+
   /**
    * Create an instance of a GcmEncryptor.
    * @param key       data of the key used to encrypt/decrypt.
@@ -50,6 +93,16 @@ class GcmEncryptor {
    */
   static GcmEncryptorPtr Create(const std::vector<unsigned char>& key,
                                 size_t tag_len = EVP_AEAD_DEFAULT_TAG_LENGTH);
+
+  /**
+   * Create an instance that uses another AEAD, such as
+   * EVP_aead_chacha20_poly1305(), in place of AES-GCM.
+   * @param aead      the AEAD to use.
+   * @param key       data of the key used to encrypt/decrypt.
+   * @return an instance of a GcmEncryptor.
+   */
+  static GcmEncryptorPtr Create(const EVP_AEAD* aead,
+                                const std::vector<unsigned char>& key);
 };
 
 }  // namespace session
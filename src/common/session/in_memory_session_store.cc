@@ -0,0 +1,155 @@
+#include "src/common/session/in_memory_session_store.h"
+#include <algorithm>
+#include "absl/hash/hash.h"
+#include "src/common/metrics/metrics.h"
+#include "src/common/utilities/random.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+namespace {
+const char *sessions_metric_ = "session_store_sessions";
+const char *expired_metric_ = "session_store_expired_total";
+// 128 bits of randomness, which encode as 22 characters.
+const size_t session_id_size_ = 16;
+}  // namespace
+
+InMemorySessionStore::InMemorySessionStore(size_t shards,
+                                           std::chrono::milliseconds tick,
+                                           size_t slots)
+    : tick_(std::max(tick, std::chrono::milliseconds(1))),
+      shards_(std::max<size_t>(1, shards)) {
+  for (auto &shard : shards_) {
+    shard.wheel.resize(std::max<size_t>(1, slots));
+  }
+  thread_ = std::thread(&InMemorySessionStore::Run, this);
+}
+
+InMemorySessionStore::~InMemorySessionStore() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stopped_ = true;
+  }
+  wake_.notify_all();
+  thread_.join();
+  metrics::Registry::Instance()
+      .GetGauge(sessions_metric_)
+      .Add(-static_cast<int64_t>(Size()));
+}
+
+InMemorySessionStore::Shard &InMemorySessionStore::ShardFor(
+    absl::string_view id) {
+  return shards_[absl::Hash<absl::string_view>()(id) % shards_.size()];
+}
+
+int64_t InMemorySessionStore::Tick(time_point time) const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             time.time_since_epoch())
+             .count() /
+         tick_.count();
+}
+
+void InMemorySessionStore::Erase(
+    Shard &shard, std::unordered_map<std::string, Entry>::iterator session) {
+  shard.sessions.erase(session);
+  metrics::Registry::Instance().GetGauge(sessions_metric_).Add(-1);
+}
+
+std::string InMemorySessionStore::Put(const Session &session,
+                                      time_point expiry) {
+  auto id = utilities::RandomGenerator().Generate(session_id_size_).Str();
+  auto &shard = ShardFor(id);
+  {
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    shard.sessions[id] = Entry{session, expiry};
+    shard.wheel[Tick(expiry) % shard.wheel.size()].push_back(id);
+  }
+  metrics::Registry::Instance().GetGauge(sessions_metric_).Add(1);
+  return id;
+}
+
+absl::optional<Session> InMemorySessionStore::Get(absl::string_view id) {
+  auto &shard = ShardFor(id);
+  std::lock_guard<std::mutex> lock(shard.mtx);
+  auto found = shard.sessions.find(std::string(id));
+  if (found == shard.sessions.end()) {
+    return absl::nullopt;
+  }
+  // The sweep may not have caught up with the session yet.
+  if (found->second.expiry <= std::chrono::system_clock::now()) {
+    Erase(shard, found);
+    metrics::Registry::Instance().GetCounter(expired_metric_).Increment();
+    return absl::nullopt;
+  }
+  return found->second.session;
+}
+
+void InMemorySessionStore::Remove(absl::string_view id) {
+  auto &shard = ShardFor(id);
+  std::lock_guard<std::mutex> lock(shard.mtx);
+  auto found = shard.sessions.find(std::string(id));
+  if (found != shard.sessions.end()) {
+    // Its id is dropped from the wheel when its slot is next swept.
+    Erase(shard, found);
+  }
+}
+
+size_t InMemorySessionStore::Size() const {
+  size_t size = 0;
+  for (const auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    size += shard.sessions.size();
+  }
+  return size;
+}
+
+void InMemorySessionStore::Sweep(time_point now) {
+  auto &expired = metrics::Registry::Instance().GetCounter(expired_metric_);
+  auto current = Tick(now);
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto slots = static_cast<int64_t>(shard.wheel.size());
+    // Visit each slot at most once, however long it has been since the last
+    // sweep.
+    for (auto tick = std::max(shard.swept + 1, current - slots + 1);
+         tick <= current; ++tick) {
+      auto &ids = shard.wheel[tick % slots];
+      auto kept = std::remove_if(
+          ids.begin(), ids.end(),
+          [this, &shard, &expired, now](const std::string &id) {
+            auto found = shard.sessions.find(id);
+            if (found == shard.sessions.end()) {
+              // Removed since it was filed.
+              return true;
+            }
+            if (found->second.expiry > now) {
+              // Due in a later turn of the wheel.
+              return false;
+            }
+            Erase(shard, found);
+            expired.Increment();
+            return true;
+          });
+      ids.erase(kept, ids.end());
+    }
+    shard.swept = std::max(shard.swept, current);
+  }
+}
+
+void InMemorySessionStore::Run() {
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (!stopped_) {
+    wake_.wait_for(lock, tick_, [this]() { return stopped_.load(); });
+    if (stopped_) {
+      break;
+    }
+    lock.unlock();
+    Sweep(std::chrono::system_clock::now());
+    lock.lock();
+  }
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
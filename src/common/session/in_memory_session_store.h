@@ -0,0 +1,94 @@
+#ifndef AUTHSERVICE_SRC_COMMON_SESSION_IN_MEMORY_SESSION_STORE_H_
+#define AUTHSERVICE_SRC_COMMON_SESSION_IN_MEMORY_SESSION_STORE_H_
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "src/common/session/session_store.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+/** @brief A session store that keeps sessions in this process.
+ *
+ * Sessions are spread over independently locked shards. Each shard files its
+ * sessions in a timer wheel by expiry, which a background thread advances to
+ * remove expired sessions without scanning the whole store.
+ */
+class InMemorySessionStore final : public SessionStore {
+ public:
+  /** @brief Construct a store and start sweeping it.
+   *
+   * @param shards the number of shards to spread sessions over.
+   * @param tick how often expired sessions are removed.
+   * @param slots the number of ticks in a turn of the timer wheel. Sessions
+   * that expire further ahead stay in their slot for more than one turn.
+   */
+  explicit InMemorySessionStore(
+      size_t shards = 16,
+      std::chrono::milliseconds tick = std::chrono::seconds(1),
+      size_t slots = 256);
+  ~InMemorySessionStore();
+
+  InMemorySessionStore(const InMemorySessionStore &) = delete;
+  InMemorySessionStore &operator=(const InMemorySessionStore &) = delete;
+
+  std::string Put(const Session &session, time_point expiry) override;
+  absl::optional<Session> Get(absl::string_view id) override;
+  void Remove(absl::string_view id) override;
+
+  /** @brief The number of stored sessions, including any that have expired
+   * but not yet been swept.
+   */
+  size_t Size() const;
+
+  /** @brief Remove the sessions that have expired by the given time.
+   *
+   * This is called by the background thread once per tick, and is exposed
+   * for tests.
+   *
+   * @param now the current time.
+   */
+  void Sweep(time_point now);
+
+ private:
+  struct Entry {
+    Session session;
+    time_point expiry;
+  };
+
+  struct Shard {
+    mutable std::mutex mtx;
+    std::unordered_map<std::string, Entry> sessions;
+    // The ids of sessions by the slot of the tick in which they expire.
+    std::vector<std::vector<std::string>> wheel;
+    // The tick up to which the wheel has been swept.
+    int64_t swept = -1;
+  };
+
+  std::chrono::milliseconds tick_;
+  std::vector<Shard> shards_;
+
+  std::mutex mtx_;
+  std::condition_variable wake_;
+  std::atomic<bool> stopped_{false};
+  std::thread thread_;
+
+  Shard &ShardFor(absl::string_view id);
+  int64_t Tick(time_point time) const;
+  /** @brief Remove a session. Must be called with the shard's lock held. */
+  void Erase(Shard &shard,
+             std::unordered_map<std::string, Entry>::iterator session);
+
+  /** @brief Sweep once per tick until stopped. */
+  void Run();
+};
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
+#endif  // AUTHSERVICE_SRC_COMMON_SESSION_IN_MEMORY_SESSION_STORE_H_
@@ -0,0 +1,251 @@
+#include "src/common/session/redis_client.h"
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <future>
+#include <stdexcept>
+#include "absl/strings/str_cat.h"
+#include "spdlog/spdlog.h"
+#include "src/common/metrics/metrics.h"
+
+namespace net = boost::asio;
+
+namespace authservice {
+namespace common {
+namespace session {
+
+namespace {
+const char *commands_metric_ = "redis_commands_total";
+const char *round_trips_metric_ = "redis_round_trips_total";
+const char *connects_metric_ = "redis_connects_total";
+const char *errors_metric_ = "redis_errors_total";
+const size_t read_size_ = 16 * 1024;
+}  // namespace
+
+/** @brief A connection to the server.
+ *
+ * Each connection runs its own io_context so that every operation can be
+ * bounded by a timeout. A connection is only used by one thread at a time.
+ */
+class RedisClient::Connection {
+ private:
+  const std::chrono::milliseconds timeout_;
+  net::io_context io_context_;
+  net::ip::tcp::socket socket_;
+  // Received data that has not yet been parsed.
+  std::string received_;
+
+  /** @brief Run the io_context until the pending operation completes.
+   *
+   * @param done set by the operation's handler.
+   * @param ec the error code set by the operation's handler.
+   * @param what the operation, for error messages.
+   * @param resolver the resolver, when the operation is a lookup.
+   * @throws std::runtime_error if the operation fails or times out.
+   */
+  void Wait(const bool &done, const boost::system::error_code &ec,
+            const char *what, net::ip::tcp::resolver *resolver = nullptr) {
+    io_context_.restart();
+    io_context_.run_for(timeout_);
+    if (!done) {
+      // The handler refers to the caller's locals, so must run before
+      // returning.
+      if (resolver != nullptr) {
+        resolver->cancel();
+      }
+      boost::system::error_code ignored;
+      socket_.close(ignored);
+      io_context_.restart();
+      io_context_.run();
+      throw std::runtime_error(absl::StrCat(what, " timed out"));
+    }
+    if (ec) {
+      throw std::runtime_error(absl::StrCat(what, " failed: ", ec.message()));
+    }
+  }
+
+ public:
+  Connection(const std::string &hostname, uint16_t port,
+             std::chrono::milliseconds timeout)
+      : timeout_(timeout), socket_(io_context_) {
+    bool done = false;
+    boost::system::error_code ec;
+    net::ip::tcp::resolver resolver(io_context_);
+    net::ip::tcp::resolver::results_type endpoints;
+    resolver.async_resolve(
+        hostname, std::to_string(port),
+        [&done, &ec, &endpoints](
+            const boost::system::error_code &error,
+            net::ip::tcp::resolver::results_type results) {
+          done = true;
+          ec = error;
+          endpoints = std::move(results);
+        });
+    Wait(done, ec, "resolve", &resolver);
+    done = false;
+    net::async_connect(socket_, endpoints,
+                       [&done, &ec](const boost::system::error_code &error,
+                                    const net::ip::tcp::endpoint &) {
+                         done = true;
+                         ec = error;
+                       });
+    Wait(done, ec, "connect");
+    socket_.set_option(net::ip::tcp::no_delay(true));
+    metrics::Registry::Instance().GetCounter(connects_metric_).Increment();
+  }
+
+  /** @brief Write a pipeline of commands and read their replies.
+   *
+   * @param requests the encoded commands.
+   * @param count the number of commands.
+   * @return the replies, in the order of the commands.
+   */
+  std::vector<RespReply> RoundTrip(absl::string_view requests, size_t count) {
+    bool done = false;
+    boost::system::error_code ec;
+    net::async_write(socket_, net::buffer(requests.data(), requests.size()),
+                     [&done, &ec](const boost::system::error_code &error,
+                                  size_t) {
+                       done = true;
+                       ec = error;
+                     });
+    Wait(done, ec, "write");
+
+    std::vector<RespReply> replies;
+    replies.reserve(count);
+    size_t parsed = 0;
+    while (replies.size() < count) {
+      size_t consumed = 0;
+      auto reply = ParseRespReply(
+          absl::string_view(received_).substr(parsed), consumed);
+      if (reply.has_value()) {
+        parsed += consumed;
+        replies.push_back(std::move(*reply));
+        continue;
+      }
+      auto size = received_.size();
+      received_.resize(size + read_size_);
+      size_t read = 0;
+      done = false;
+      socket_.async_read_some(
+          net::buffer(&received_[size], read_size_),
+          [&done, &ec, &read](const boost::system::error_code &error,
+                              size_t n) {
+            done = true;
+            ec = error;
+            read = n;
+          });
+      try {
+        Wait(done, ec, "read");
+      } catch (...) {
+        received_.resize(size);
+        throw;
+      }
+      received_.resize(size + read);
+    }
+    received_.erase(0, parsed);
+    return replies;
+  }
+};
+
+struct RedisClient::Pending {
+  std::string request;
+  std::promise<RespReply> reply;
+  // Whether the command is still in queue_. Guarded by mtx_.
+  bool queued = true;
+};
+
+RedisClient::RedisClient(std::string hostname, uint16_t port, Options options)
+    : hostname_(std::move(hostname)),
+      port_(port),
+      options_(options),
+      connections_(std::max<size_t>(1, options.connections)) {
+  for (size_t i = connections_.size(); i > 0; --i) {
+    idle_.push_back(i - 1);
+  }
+}
+
+RedisClient::RedisClient(std::string hostname, uint16_t port)
+    : RedisClient(std::move(hostname), port, Options()) {}
+
+RedisClient::~RedisClient() = default;
+
+RespReply RedisClient::Execute(absl::Span<const absl::string_view> args) {
+  auto pending = std::make_shared<Pending>();
+  AppendRespCommand(args, pending->request);
+  auto reply = pending->reply.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    queue_.push_back(pending);
+  }
+  Flush(*pending);
+  return reply.get();
+}
+
+void RedisClient::Flush(const Pending &own) {
+  auto max_batch = std::max<size_t>(1, options_.max_batch);
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (own.queued) {
+    if (idle_.empty()) {
+      // Another caller may send the command whilst this one waits.
+      returned_.wait(lock);
+      continue;
+    }
+    auto connection = idle_.back();
+    idle_.pop_back();
+    std::vector<std::shared_ptr<Pending>> batch;
+    while (!queue_.empty() && batch.size() < max_batch) {
+      queue_.front()->queued = false;
+      batch.push_back(std::move(queue_.front()));
+      queue_.pop_front();
+    }
+    lock.unlock();
+    Send(connection, batch);
+    lock.lock();
+    idle_.push_back(connection);
+    // Hand the connection to a caller whose command is still queued.
+    returned_.notify_all();
+  }
+}
+
+void RedisClient::Send(size_t connection,
+                       const std::vector<std::shared_ptr<Pending>> &batch) {
+  auto &registry = metrics::Registry::Instance();
+  std::string requests;
+  for (const auto &pending : batch) {
+    requests.append(pending->request);
+  }
+  auto &conn = connections_[connection];
+  // A pooled connection may have been closed by the server since it was last
+  // used. In that case retry once on a fresh connection.
+  for (int attempt = 0;; ++attempt) {
+    bool reused = conn != nullptr;
+    try {
+      if (!reused) {
+        conn.reset(new Connection(hostname_, port_, options_.timeout));
+      }
+      auto replies = conn->RoundTrip(requests, batch.size());
+      registry.GetCounter(round_trips_metric_).Increment();
+      registry.GetCounter(commands_metric_).Increment(batch.size());
+      for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i]->reply.set_value(std::move(replies[i]));
+      }
+      return;
+    } catch (const std::exception &e) {
+      conn.reset();
+      if (!reused || attempt > 0) {
+        spdlog::info("{}: redis request failed: {}", __func__, e.what());
+        registry.GetCounter(errors_metric_).Increment();
+        for (const auto &pending : batch) {
+          pending->reply.set_exception(std::current_exception());
+        }
+        return;
+      }
+      spdlog::debug("{}: pooled redis connection failed, retrying: {}",
+                    __func__, e.what());
+    }
+  }
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,103 @@
+#ifndef AUTHSERVICE_SRC_COMMON_SESSION_REDIS_CLIENT_H_
+#define AUTHSERVICE_SRC_COMMON_SESSION_REDIS_CLIENT_H_
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "src/common/session/resp.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+class RedisClient;
+typedef std::shared_ptr<RedisClient> RedisClientPtr;
+
+/** @brief A client for servers that speak the Redis protocol.
+ *
+ * Commands are sent over a small pool of persistent connections. Commands
+ * issued concurrently are batched: whichever caller finds a connection free
+ * writes the queued commands up to and including its own in a single
+ * pipeline and hands each caller its reply, so a burst of requests costs one
+ * round trip per connection rather than one per command. A caller stops
+ * sending once its own command is sent, and the callers still queued take
+ * over, so no caller waits on more than the commands queued ahead of it.
+ *
+ * Commands block the calling thread. The OIDC filter uses the session store,
+ * and so this client, on the service's completion queue polling threads and
+ * the HTTP connection pool's I/O threads, each of which is then held for up
+ * to a round trip or, if the server is unreachable, the timeout. Size the
+ * timeout with that in mind.
+ */
+class RedisClient {
+ public:
+  struct Options {
+    // The maximum number of connections to the server.
+    size_t connections = 4;
+    // The maximum number of commands sent in one pipeline.
+    size_t max_batch = 64;
+    // How long to wait for a connection to be established, or for a pipeline
+    // to be written or its replies read.
+    std::chrono::milliseconds timeout = std::chrono::milliseconds(500);
+  };
+
+  RedisClient(std::string hostname, uint16_t port, Options options);
+  RedisClient(std::string hostname, uint16_t port);
+  ~RedisClient();
+
+  RedisClient(const RedisClient &) = delete;
+  RedisClient &operator=(const RedisClient &) = delete;
+
+  /** @brief Run a command.
+   *
+   * Blocks until the reply is received, sending the pipeline that carries
+   * the command if a connection is free. Error replies from the server are
+   * returned rather than thrown.
+   *
+   * @param args the command name followed by its arguments.
+   * @return the reply.
+   * @throws std::runtime_error if the server cannot be reached or does not
+   * reply in time.
+   */
+  RespReply Execute(absl::Span<const absl::string_view> args);
+
+ private:
+  class Connection;
+  struct Pending;
+
+  const std::string hostname_;
+  const uint16_t port_;
+  const Options options_;
+
+  std::mutex mtx_;
+  // Signalled when a connection is returned to idle_.
+  std::condition_variable returned_;
+  // Commands waiting to be sent.
+  std::deque<std::shared_ptr<Pending>> queue_;
+  // The indexes of connections not currently sending a pipeline. A null
+  // connection is opened when next used.
+  std::vector<size_t> idle_;
+  std::vector<std::unique_ptr<Connection>> connections_;
+
+  /** @brief Send queued commands until a pipeline carries the given one,
+   * waiting for a connection to be free if need be.
+   */
+  void Flush(const Pending &own);
+
+  /** @brief Send a pipeline of commands over a connection that the caller has
+   * taken from idle_, and complete each command with its reply.
+   */
+  void Send(size_t connection,
+            const std::vector<std::shared_ptr<Pending>> &batch);
+};
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
+#endif  // AUTHSERVICE_SRC_COMMON_SESSION_REDIS_CLIENT_H_
@@ -0,0 +1,179 @@
+#include "src/common/session/redis_session_store.h"
+#include <algorithm>
+#include <stdexcept>
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "spdlog/spdlog.h"
+#include "src/common/utilities/random.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+namespace {
+// 128 bits of randomness, which encode as 22 characters.
+const size_t session_id_size_ = 16;
+
+void AppendField(absl::string_view field, std::string &out) {
+  absl::StrAppend(&out, field.size(), "\n", field);
+}
+
+bool ConsumeField(absl::string_view &data, absl::string_view &field) {
+  auto end = data.find('\n');
+  size_t size;
+  if (end == absl::string_view::npos ||
+      !absl::SimpleAtoi(data.substr(0, end), &size) ||
+      data.size() - end - 1 < size) {
+    return false;
+  }
+  field = data.substr(end + 1, size);
+  data.remove_prefix(end + 1 + size);
+  return true;
+}
+
+/** @brief Encode a session and its expiry as length prefixed fields. */
+std::string Encode(const Session &session, SessionStore::time_point expiry) {
+  auto expiry_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       expiry.time_since_epoch())
+                       .count();
+  std::string out;
+  AppendField(absl::StrCat(expiry_ms), out);
+  AppendField(session.id_token, out);
+  if (session.access_token.has_value()) {
+    AppendField(*session.access_token, out);
+  }
+  return out;
+}
+
+absl::optional<std::pair<Session, SessionStore::time_point>> Decode(
+    absl::string_view data) {
+  absl::string_view expiry_field, id_token;
+  int64_t expiry;
+  if (!ConsumeField(data, expiry_field) ||
+      !absl::SimpleAtoi(expiry_field, &expiry) ||
+      !ConsumeField(data, id_token)) {
+    return absl::nullopt;
+  }
+  Session session{std::string(id_token), absl::nullopt};
+  if (!data.empty()) {
+    absl::string_view access_token;
+    if (!ConsumeField(data, access_token) || !data.empty()) {
+      return absl::nullopt;
+    }
+    session.access_token = std::string(access_token);
+  }
+  return std::make_pair(std::move(session),
+                        SessionStore::time_point(
+                            std::chrono::milliseconds(expiry)));
+}
+}  // namespace
+
+RedisSessionStore::RedisSessionStore(RedisClientPtr client,
+                                     TokenEncryptorPtr cryptor,
+                                     Options options)
+    : client_(std::move(client)),
+      cryptor_(std::move(cryptor)),
+      options_(std::move(options)) {
+  if (options_.cache_capacity > 0) {
+    cache_.reset(new TokenCache(options_.cache_capacity));
+  }
+}
+
+RedisSessionStore::RedisSessionStore(RedisClientPtr client,
+                                     TokenEncryptorPtr cryptor)
+    : RedisSessionStore(std::move(client), std::move(cryptor), Options()) {}
+
+std::string RedisSessionStore::Key(absl::string_view id) const {
+  return absl::StrCat(options_.key_prefix, id);
+}
+
+void RedisSessionStore::Cache(absl::string_view id, absl::string_view value,
+                              time_point expiry) {
+  if (cache_) {
+    cache_->Put(id, value,
+                std::min(expiry, std::chrono::system_clock::now() +
+                                     options_.cache_ttl));
+  }
+}
+
+std::string RedisSessionStore::Put(const Session &session, time_point expiry) {
+  auto id = utilities::RandomGenerator().Generate(session_id_size_).Str();
+  auto value = Encode(session, expiry);
+  // The server counts in whole seconds, so keep the session until just after
+  // it expires. Get checks the exact expiry.
+  auto ttl = std::chrono::duration_cast<std::chrono::seconds>(
+                 expiry - std::chrono::system_clock::now())
+                 .count() +
+             1;
+  auto key = Key(id);
+  auto seconds = std::to_string(std::max<int64_t>(ttl, 1));
+  auto sealed = cryptor_->Encrypt(value, id);
+  const absl::string_view command[] = {"SETEX", key, seconds, sealed};
+  auto reply = client_->Execute(command);
+  if (reply.type != RespReply::Type::STATUS) {
+    throw std::runtime_error(
+        absl::StrCat("unable to store session: ", reply.str));
+  }
+  Cache(id, value, expiry);
+  return id;
+}
+
+absl::optional<Session> RedisSessionStore::Get(absl::string_view id) {
+  auto now = std::chrono::system_clock::now();
+  absl::optional<std::string> value;
+  if (cache_) {
+    value = cache_->Get(id, now);
+  }
+  bool cached = value.has_value();
+  if (!cached) {
+    auto key = Key(id);
+    const absl::string_view command[] = {"GET", key};
+    try {
+      auto reply = client_->Execute(command);
+      if (reply.type == RespReply::Type::NIL) {
+        return absl::nullopt;
+      }
+      if (reply.type != RespReply::Type::BULK) {
+        spdlog::info("{}: unable to read session: {}", __func__, reply.str);
+        return absl::nullopt;
+      }
+      value = cryptor_->Decrypt(reply.str, std::string(id));
+    } catch (const std::exception &e) {
+      spdlog::info("{}: unable to read session: {}", __func__, e.what());
+      return absl::nullopt;
+    }
+    if (!value.has_value()) {
+      spdlog::info("{}: unable to open session", __func__);
+      return absl::nullopt;
+    }
+  }
+  auto decoded = Decode(*value);
+  if (!decoded.has_value()) {
+    spdlog::info("{}: invalid session", __func__);
+    return absl::nullopt;
+  }
+  if (decoded->second <= now) {
+    return absl::nullopt;
+  }
+  if (!cached) {
+    Cache(id, *value, decoded->second);
+  }
+  return std::move(decoded->first);
+}
+
+void RedisSessionStore::Remove(absl::string_view id) {
+  if (cache_) {
+    cache_->Remove(id);
+  }
+  auto key = Key(id);
+  const absl::string_view command[] = {"DEL", key};
+  try {
+    client_->Execute(command);
+  } catch (const std::exception &e) {
+    spdlog::info("{}: unable to remove session: {}", __func__, e.what());
+  }
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
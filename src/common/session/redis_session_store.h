@@ -0,0 +1,69 @@
+#ifndef AUTHSERVICE_SRC_COMMON_SESSION_REDIS_SESSION_STORE_H_
+#define AUTHSERVICE_SRC_COMMON_SESSION_REDIS_SESSION_STORE_H_
+#include <chrono>
+#include <string>
+#include "src/common/session/redis_client.h"
+#include "src/common/session/session_store.h"
+#include "src/common/session/token_cache.h"
+#include "src/common/session/token_encryptor.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+/** @brief A session store kept in a Redis server, so that every replica
+ * sharing the server sees the same sessions.
+ *
+ * Sessions are sealed with the filter's TokenEncryptor, bound to their id,
+ * so that the server never sees tokens in the clear and a session cannot be
+ * read from under another id. They are written with SETEX so that the server
+ * drops them once their tokens expire. Sessions that have been read or
+ * written recently are also kept in a local cache, so that the server is only
+ * consulted once every cache_ttl per session on each replica. A session
+ * removed on another replica may therefore be served from the cache for up to
+ * cache_ttl.
+ */
+class RedisSessionStore final : public SessionStore {
+ public:
+  struct Options {
+    // Prepended to session ids to form the server's keys.
+    std::string key_prefix = "authservice:session:";
+    // The maximum number of sessions in the local cache. Zero disables it.
+    size_t cache_capacity = 10000;
+    // How long a session may be served from the local cache.
+    std::chrono::milliseconds cache_ttl = std::chrono::seconds(5);
+  };
+
+  RedisSessionStore(RedisClientPtr client, TokenEncryptorPtr cryptor,
+                    Options options);
+  RedisSessionStore(RedisClientPtr client, TokenEncryptorPtr cryptor);
+
+  /** @copydoc SessionStore::Put
+   *
+   * @throws std::runtime_error if the server cannot store the session.
+   */
+  std::string Put(const Session &session, time_point expiry) override;
+
+  /** @copydoc SessionStore::Get
+   *
+   * Sessions that cannot be read from the server are treated as unknown.
+   */
+  absl::optional<Session> Get(absl::string_view id) override;
+
+  void Remove(absl::string_view id) override;
+
+ private:
+  RedisClientPtr client_;
+  TokenEncryptorPtr cryptor_;
+  const Options options_;
+  std::unique_ptr<TokenCache> cache_;
+
+  std::string Key(absl::string_view id) const;
+  /** @brief Cache an encoded session until it expires or for cache_ttl. */
+  void Cache(absl::string_view id, absl::string_view value, time_point expiry);
+};
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
+#endif  // AUTHSERVICE_SRC_COMMON_SESSION_REDIS_SESSION_STORE_H_
@@ -0,0 +1,119 @@
+#include "src/common/session/resp.h"
+#include <stdexcept>
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+namespace {
+const absl::string_view crlf_ = "\r\n";
+// Bounds on replies from a misbehaving server.
+const int64_t max_bulk_size_ = 512 * 1024 * 1024;
+const int64_t max_array_size_ = 1024 * 1024;
+const int max_depth_ = 8;
+
+/** @brief Parse a reply starting at pos, advancing pos past it. */
+absl::optional<RespReply> Parse(absl::string_view data, size_t &pos,
+                                int depth) {
+  if (depth > max_depth_) {
+    throw std::runtime_error("RESP reply nested too deeply");
+  }
+  auto end = data.find(crlf_, pos);
+  if (end == absl::string_view::npos) {
+    return absl::nullopt;
+  }
+  if (end == pos) {
+    throw std::runtime_error("empty RESP reply");
+  }
+  auto marker = data[pos];
+  auto line = data.substr(pos + 1, end - pos - 1);
+  auto next = end + crlf_.size();
+  RespReply reply;
+  switch (marker) {
+    case '+':
+      reply.type = RespReply::Type::STATUS;
+      reply.str = std::string(line);
+      break;
+    case '-':
+      reply.type = RespReply::Type::ERROR;
+      reply.str = std::string(line);
+      break;
+    case ':':
+      reply.type = RespReply::Type::INTEGER;
+      if (!absl::SimpleAtoi(line, &reply.integer)) {
+        throw std::runtime_error("invalid RESP integer");
+      }
+      break;
+    case '$': {
+      int64_t size;
+      if (!absl::SimpleAtoi(line, &size) || size < -1 ||
+          size > max_bulk_size_) {
+        throw std::runtime_error("invalid RESP bulk string length");
+      }
+      if (size == -1) {
+        reply.type = RespReply::Type::NIL;
+        break;
+      }
+      if (data.size() < next + size + crlf_.size()) {
+        return absl::nullopt;
+      }
+      if (data.substr(next + size, crlf_.size()) != crlf_) {
+        throw std::runtime_error("unterminated RESP bulk string");
+      }
+      reply.type = RespReply::Type::BULK;
+      reply.str = std::string(data.substr(next, size));
+      next += size + crlf_.size();
+      break;
+    }
+    case '*': {
+      int64_t size;
+      if (!absl::SimpleAtoi(line, &size) || size < -1 ||
+          size > max_array_size_) {
+        throw std::runtime_error("invalid RESP array length");
+      }
+      if (size == -1) {
+        reply.type = RespReply::Type::NIL;
+        break;
+      }
+      reply.type = RespReply::Type::ARRAY;
+      reply.elements.reserve(size);
+      for (int64_t i = 0; i < size; ++i) {
+        auto element = Parse(data, next, depth + 1);
+        if (!element.has_value()) {
+          return absl::nullopt;
+        }
+        reply.elements.push_back(std::move(*element));
+      }
+      break;
+    }
+    default:
+      throw std::runtime_error("unknown RESP reply type");
+  }
+  pos = next;
+  return reply;
+}
+}  // namespace
+
+void AppendRespCommand(absl::Span<const absl::string_view> args,
+                       std::string &out) {
+  absl::StrAppend(&out, "*", args.size(), crlf_);
+  for (auto arg : args) {
+    absl::StrAppend(&out, "$", arg.size(), crlf_, arg, crlf_);
+  }
+}
+
+absl::optional<RespReply> ParseRespReply(absl::string_view data,
+                                         size_t &consumed) {
+  size_t pos = 0;
+  auto reply = Parse(data, pos, 0);
+  if (reply.has_value()) {
+    consumed = pos;
+  }
+  return reply;
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,52 @@
+#ifndef AUTHSERVICE_SRC_COMMON_SESSION_RESP_H_
+#define AUTHSERVICE_SRC_COMMON_SESSION_RESP_H_
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+/** @brief A reply in the Redis serialization protocol (RESP). */
+struct RespReply {
+  enum class Type { STATUS, ERROR, INTEGER, BULK, NIL, ARRAY };
+
+  Type type = Type::NIL;
+  // The text of a status, error or bulk reply.
+  std::string str;
+  // The value of an integer reply.
+  int64_t integer = 0;
+  // The elements of an array reply.
+  std::vector<RespReply> elements;
+};
+
+/** @brief Append a command to a buffer of requests.
+ *
+ * Commands are encoded as arrays of bulk strings, so arguments may hold any
+ * bytes.
+ *
+ * @param args the command name followed by its arguments.
+ * @param out the buffer to append to.
+ */
+void AppendRespCommand(absl::Span<const absl::string_view> args,
+                       std::string &out);
+
+/** @brief Parse the first reply in a buffer.
+ *
+ * @param data the received data.
+ * @param consumed set to the number of bytes of data the reply occupies.
+ * @return the reply, or absl::nullopt if data does not yet hold a complete
+ * reply.
+ * @throws std::runtime_error if data is not valid RESP.
+ */
+absl::optional<RespReply> ParseRespReply(absl::string_view data,
+                                         size_t &consumed);
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
+#endif  // AUTHSERVICE_SRC_COMMON_SESSION_RESP_H_
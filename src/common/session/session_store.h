@@ -0,0 +1,57 @@
+#ifndef AUTHSERVICE_SRC_COMMON_SESSION_SESSION_STORE_H_
+#define AUTHSERVICE_SRC_COMMON_SESSION_SESSION_STORE_H_
+#include <chrono>
+#include <memory>
+#include <string>
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+/** @brief The tokens of a logged in user. */
+struct Session {
+  std::string id_token;
+  absl::optional<std::string> access_token;
+};
+
+class SessionStore;
+typedef std::shared_ptr<SessionStore> SessionStorePtr;
+
+/** @brief Keeps sessions on the server, so that browsers need only be sent a
+ * short session id rather than the tokens themselves.
+ */
+class SessionStore {
+ public:
+  typedef std::chrono::system_clock::time_point time_point;
+
+  virtual ~SessionStore(){};
+
+  /** @brief Start a session.
+   *
+   * @param session the session to store.
+   * @param expiry the time after which the session must not be used.
+   * @return the id of the new session.
+   * @throws std::runtime_error if the session cannot be stored.
+   */
+  virtual std::string Put(const Session &session, time_point expiry) = 0;
+
+  /** @brief Look up a session.
+   *
+   * @param id the id of the session.
+   * @return the session, or absl::nullopt if it does not exist or has expired.
+   */
+  virtual absl::optional<Session> Get(absl::string_view id) = 0;
+
+  /** @brief End a session.
+   *
+   * @param id the id of the session.
+   */
+  virtual void Remove(absl::string_view id) = 0;
+};
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
+#endif  // AUTHSERVICE_SRC_COMMON_SESSION_SESSION_STORE_H_
@@ -0,0 +1,147 @@
+#include "src/common/session/token_cache.h"
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include "openssl/rand.h"
+#include "src/common/metrics/metrics.h"
+#include "src/common/utilities/siphash.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+namespace {
+const char *hits_metric_ = "token_cache_hits_total";
+const char *misses_metric_ = "token_cache_misses_total";
+const char *evictions_metric_ = "token_cache_evictions_total";
+const char *bytes_metric_ = "token_cache_bytes";
+
+// An estimate of the memory used by an entry, including the list node and
+// index slot that hold it.
+int64_t EntrySize(size_t ciphertext_size, size_t plaintext_size) {
+  return static_cast<int64_t>(ciphertext_size + plaintext_size + 128);
+}
+}  // namespace
+
+TokenCache::TokenCache(size_t capacity, size_t shards)
+    : shard_capacity_(
+          std::max<size_t>(1, capacity / std::max<size_t>(1, shards))),
+      shards_(std::max<size_t>(1, shards)),
+      hits_(metrics::Registry::Instance().GetCounter(hits_metric_)),
+      misses_(metrics::Registry::Instance().GetCounter(misses_metric_)),
+      evictions_(metrics::Registry::Instance().GetCounter(evictions_metric_)),
+      bytes_(metrics::Registry::Instance().GetGauge(bytes_metric_)) {
+  int rc = RAND_bytes(reinterpret_cast<uint8_t *>(hash_key_),
+                      sizeof(hash_key_));
+  assert(rc == 1);
+  (void)rc;
+}
+
+TokenCache::~TokenCache() {
+  int64_t bytes = 0;
+  for (auto &shard : shards_) {
+    for (const auto &entry : shard.entries) {
+      bytes += EntrySize(entry.ciphertext.size(), entry.plaintext.size());
+    }
+  }
+  bytes_.Add(-bytes);
+}
+
+uint64_t TokenCache::Hash(absl::string_view ciphertext) const {
+  return utilities::SipHash24(hash_key_, ciphertext);
+}
+
+TokenCache::Shard &TokenCache::ShardFor(uint64_t hash) {
+  // The low bits select the bucket within a shard's index, so use the high
+  // bits to select the shard.
+  return shards_[(hash >> 32) % shards_.size()];
+}
+
+int64_t TokenCache::Erase(Shard &shard, std::list<Entry>::iterator entry) {
+  auto size = EntrySize(entry->ciphertext.size(), entry->plaintext.size());
+  shard.index.erase(entry->hash);
+  shard.entries.erase(entry);
+  return size;
+}
+
+absl::optional<std::string> TokenCache::Get(absl::string_view ciphertext,
+                                            time_point now) {
+  auto hash = Hash(ciphertext);
+  auto &shard = ShardFor(hash);
+  absl::optional<std::string> plaintext;
+  int64_t freed = 0;
+  {
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto found = shard.index.find(hash);
+    if (found != shard.index.end() &&
+        found->second->ciphertext == ciphertext) {
+      auto entry = found->second;
+      if (entry->expiry <= now) {
+        freed = Erase(shard, entry);
+      } else {
+        shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+        plaintext = entry->plaintext;
+      }
+    }
+  }
+  if (freed != 0) {
+    bytes_.Add(-freed);
+  }
+  (plaintext.has_value() ? hits_ : misses_).Increment();
+  return plaintext;
+}
+
+void TokenCache::Put(absl::string_view ciphertext, absl::string_view plaintext,
+                     time_point expiry) {
+  auto hash = Hash(ciphertext);
+  auto &shard = ShardFor(hash);
+  int64_t freed = 0;
+  bool evicted = false;
+  {
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto found = shard.index.find(hash);
+    if (found != shard.index.end()) {
+      freed = Erase(shard, found->second);
+    } else if (shard.entries.size() >= shard_capacity_) {
+      freed = Erase(shard, std::prev(shard.entries.end()));
+      evicted = true;
+    }
+    shard.entries.push_front(Entry{hash, std::string(ciphertext),
+                                   std::string(plaintext), expiry});
+    shard.index[hash] = shard.entries.begin();
+  }
+  if (evicted) {
+    evictions_.Increment();
+  }
+  bytes_.Add(EntrySize(ciphertext.size(), plaintext.size()) - freed);
+}
+
+void TokenCache::Remove(absl::string_view ciphertext) {
+  auto hash = Hash(ciphertext);
+  auto &shard = ShardFor(hash);
+  int64_t freed = 0;
+  {
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto found = shard.index.find(hash);
+    if (found != shard.index.end() &&
+        found->second->ciphertext == ciphertext) {
+      freed = Erase(shard, found->second);
+    }
+  }
+  if (freed != 0) {
+    bytes_.Add(-freed);
+  }
+}
+
+size_t TokenCache::Size() const {
+  size_t size = 0;
+  for (const auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    size += shard.entries.size();
+  }
+  return size;
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,112 @@
+#ifndef AUTHSERVICE_SRC_COMMON_SESSION_TOKEN_CACHE_H_
+#define AUTHSERVICE_SRC_COMMON_SESSION_TOKEN_CACHE_H_
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "src/common/metrics/metrics.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+class TokenCache;
+typedef std::shared_ptr<TokenCache> TokenCachePtr;
+
+/** @brief A bounded cache of decrypted tokens keyed by their ciphertext.
+ *
+ * Browsers send the same encrypted cookie with every request of a session, so
+ * caching the plaintext lets repeat requests skip decoding and decryption.
+ *
+ * Entries are spread over independently locked shards, each of which evicts
+ * its least recently used entry when full. Ciphertexts are indexed by a
+ * keyed hash so that clients cannot choose cookies that collide.
+ */
+class TokenCache {
+ public:
+  typedef std::chrono::system_clock::time_point time_point;
+
+  /** @brief Construct a cache.
+   *
+   * @param capacity the maximum number of entries.
+   * @param shards the number of shards to spread entries over.
+   */
+  explicit TokenCache(size_t capacity, size_t shards = 16);
+  ~TokenCache();
+
+  TokenCache(const TokenCache &) = delete;
+  TokenCache &operator=(const TokenCache &) = delete;
+
+  /** @brief Look up the plaintext of a ciphertext.
+   *
+   * @param ciphertext the encrypted token.
+   * @param now the current time, used to discard expired entries.
+   * @return the plaintext, or absl::nullopt if it is not cached.
+   */
+  absl::optional<std::string> Get(
+      absl::string_view ciphertext,
+      time_point now = std::chrono::system_clock::now());
+
+  /** @brief Cache the plaintext of a ciphertext.
+   *
+   * @param ciphertext the encrypted token.
+   * @param plaintext the decrypted token.
+   * @param expiry the time after which the entry must not be used.
+   */
+  void Put(absl::string_view ciphertext, absl::string_view plaintext,
+           time_point expiry);
+
+  /** @brief Drop the entry for a ciphertext, if cached.
+   *
+   * @param ciphertext the encrypted token.
+   */
+  void Remove(absl::string_view ciphertext);
+
+  /** @brief The number of cached entries. */
+  size_t Size() const;
+
+ private:
+  struct Entry {
+    uint64_t hash;
+    std::string ciphertext;
+    std::string plaintext;
+    time_point expiry;
+  };
+
+  struct Shard {
+    mutable std::mutex mtx;
+    // Most recently used first.
+    std::list<Entry> entries;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+  };
+
+  size_t shard_capacity_;
+  std::vector<Shard> shards_;
+  // The SipHash key, chosen at random per cache.
+  uint64_t hash_key_[2];
+  // Looked up once, as the registry takes a lock to find a metric.
+  metrics::Counter &hits_;
+  metrics::Counter &misses_;
+  metrics::Counter &evictions_;
+  metrics::Gauge &bytes_;
+
+  uint64_t Hash(absl::string_view ciphertext) const;
+  Shard &ShardFor(uint64_t hash);
+  /** @brief Remove an entry. Must be called with the shard's lock held.
+   *
+   * @return the estimated size of the entry, for updating bytes_ once the
+   * lock is released.
+   */
+  int64_t Erase(Shard &shard, std::list<Entry>::iterator entry);
+};
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
+#endif  // AUTHSERVICE_SRC_COMMON_SESSION_TOKEN_CACHE_H_
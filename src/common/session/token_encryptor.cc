@@ -1,15 +1,102 @@
 #include "src/common/session/token_encryptor.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
 #include "absl/strings/escaping.h"
+#include "openssl/aead.h"
 #include "src/common/session/gcm_encryptor.h"
-#include "src/common/utilities/random.h"
 
 namespace authservice {
 namespace common {
 namespace session {
 
 namespace {
+// Legacy tokens derive a key per token from a random nonce:
+//     derive_nonce || gcm_nonce || ciphertext || tag
 const size_t NONCE_SIZE = 32;
 const size_t DERIVED_KEY_SIZE = 32;
+
+// Versioned tokens are encrypted with a key derived once per secret and
+// algorithm:
+//     format || key_id || nonce || ciphertext || tag
+// The format identifies the algorithm, so that tokens sealed with any
+// algorithm can be opened whichever is configured. The format and key id are
+// authenticated as additional data.
+const size_t KEY_ID_SIZE = 4;
+const size_t HEADER_SIZE = 1 + KEY_ID_SIZE;
+const char* KEY_ID_INFO = "authservice token key id v1";
+
+struct Format {
+  EncryptionAlg alg;
+  unsigned char format;
+  const char* key_info;
+};
+const Format FORMATS[] = {
+    {EncryptionAlg::AES256GCM, 1, "authservice token key v1"},
+    {EncryptionAlg::CHACHA20POLY1305, 2,
+     "authservice chacha20-poly1305 token key v1"},
+    {EncryptionAlg::AES128GCM, 3, "authservice aes-128-gcm token key v1"},
+};
+const size_t MAX_FORMAT = 3;
+
+std::vector<unsigned char> Info(const char* info) {
+  return std::vector<unsigned char>(info, info + strlen(info));
+}
+
+const char WEB_SAFE_BASE64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// The length of the unpadded web safe base64 encoding of len bytes.
+size_t WebSafeBase64Length(size_t len) { return (len * 4 + 2) / 3; }
+
+// Encode len bytes as unpadded web safe base64, as absl::WebSafeBase64Escape
+// does. Each group of bytes is read before its encoding is written, so the
+// input may lie within the output provided that it ends where the output
+// does.
+void WebSafeBase64Encode(const uint8_t* in, size_t len, char* out) {
+  for (; len >= 3; in += 3, len -= 3, out += 4) {
+    uint32_t group = (in[0] << 16) | (in[1] << 8) | in[2];
+    out[0] = WEB_SAFE_BASE64[group >> 18];
+    out[1] = WEB_SAFE_BASE64[(group >> 12) & 0x3f];
+    out[2] = WEB_SAFE_BASE64[(group >> 6) & 0x3f];
+    out[3] = WEB_SAFE_BASE64[group & 0x3f];
+  }
+  if (len == 1) {
+    uint32_t group = in[0] << 16;
+    out[0] = WEB_SAFE_BASE64[group >> 18];
+    out[1] = WEB_SAFE_BASE64[(group >> 12) & 0x3f];
+  } else if (len == 2) {
+    uint32_t group = (in[0] << 16) | (in[1] << 8);
+    out[0] = WEB_SAFE_BASE64[group >> 18];
+    out[1] = WEB_SAFE_BASE64[(group >> 12) & 0x3f];
+    out[2] = WEB_SAFE_BASE64[(group >> 6) & 0x3f];
+  }
+}
+
+GcmEncryptorPtr CreateEncryptor(HkdfDeriver& deriver, const Format& format) {
+  auto info = Info(format.key_info);
+  switch (format.alg) {
+    case EncryptionAlg::AES128GCM:
+      return GcmEncryptor::Create(deriver.Derive(16, {}, info));
+    case EncryptionAlg::AES256GCM:
+      return GcmEncryptor::Create(deriver.Derive(32, {}, info));
+    case EncryptionAlg::CHACHA20POLY1305:
+      return GcmEncryptor::Create(EVP_aead_chacha20_poly1305(),
+                                  deriver.Derive(32, {}, info));
+    default:
+      throw std::range_error("Unsupported encryption algorithm");
+  }
+}
+
+absl::Span<uint8_t> Bytes(std::string& str) {
+  return absl::Span<uint8_t>(reinterpret_cast<uint8_t*>(&str[0]), str.size());
+}
+
+absl::Span<const uint8_t> Bytes(const std::string& str) {
+  return absl::Span<const uint8_t>(reinterpret_cast<const uint8_t*>(str.data()),
+                                   str.size());
+}
 }  // namespace
 
 class TokenEncryptorImpl : public TokenEncryptor {
@@ -18,79 +105,125 @@ class TokenEncryptorImpl : public TokenEncryptor {
                      HKDFHash hash_alg);
 
   std::string Encrypt(const std::string& token) override;
+  std::string Encrypt(const std::string& token,
+                      const std::string& aad) override;
   absl::optional<std::string> Decrypt(const std::string& ciphertext) override;
+  absl::optional<std::string> Decrypt(const std::string& ciphertext,
+                                      const std::string& aad) override;
 
  private:
-  EncryptionAlg enc_alg_;
   HkdfDeriverPtr deriver_;
-  utilities::RandomGenerator generator_;
+  // Open versioned tokens, indexed by format. Their key schedules are
+  // computed once and reused for every token.
+  std::array<GcmEncryptorPtr, MAX_FORMAT + 1> decryptors_;
+  // Seals versioned tokens with the configured algorithm.
+  GcmEncryptorPtr encryptor_;
+  // The format and key id that prefix tokens that we seal.
+  std::vector<unsigned char> header_;
 
-  size_t KeySize() const;
-
-  std::vector<unsigned char> EncryptInternal(
-      const std::string& token, const std::vector<unsigned char>& key) const;
+  absl::optional<std::string> DecryptLegacy(std::string decoded);
 };
 
 TokenEncryptorImpl::TokenEncryptorImpl(const std::string& secret,
-                                       EncryptionAlg enc_alg, HKDFHash hash_alg)
-    : enc_alg_(enc_alg) {
-  // Get the secret from the config and use it and the claim nonce to derive a
-  // new AES-256 key
+                                       EncryptionAlg enc_alg,
+                                       HKDFHash hash_alg) {
+  // Get the secret from the config and use it to derive a key per algorithm.
   std::vector<unsigned char> secret_vec(secret.begin(), secret.end());
   deriver_ = HkdfDeriver::Create(secret_vec, hash_alg);
-}
 
-size_t TokenEncryptorImpl::KeySize() const {
-  switch (enc_alg_) {
-    case EncryptionAlg::AES128GCM:
-      return 16;
-    case EncryptionAlg::AES256GCM:
-      return 32;
-    default:
-      throw std::range_error("Unsupported encryption algorithm");
-  }
-}
-
-std::vector<unsigned char> TokenEncryptorImpl::EncryptInternal(
-    const std::string& token, const std::vector<unsigned char>& key) const {
-  switch (enc_alg_) {
-    case EncryptionAlg::AES128GCM:
-    case EncryptionAlg::AES256GCM: {
-      // Encrypt the JWT, using the derived key and a random nonce
-      // Ouput is: gcm_nonce || ciphertext || tag
-      auto encryptor = GcmEncryptor::Create(key);
-      std::vector<unsigned char> tokenVec(token.begin(), token.end());
-      auto encrypted = encryptor->Seal(tokenVec);
-      return encrypted;
+  auto key_id = deriver_->Derive(KEY_ID_SIZE, {}, Info(KEY_ID_INFO));
+  for (const auto& format : FORMATS) {
+    decryptors_[format.format] = CreateEncryptor(*deriver_, format);
+    if (format.alg == enc_alg) {
+      encryptor_ = decryptors_[format.format];
+      header_.push_back(format.format);
+      header_.insert(header_.end(), key_id.begin(), key_id.end());
     }
-    default:
-      throw std::range_error("Unsupported encryption algorithm");
+  }
+  if (!encryptor_) {
+    throw std::range_error("Unsupported encryption algorithm");
   }
 }
 
 std::string TokenEncryptorImpl::Encrypt(const std::string& token) {
-  auto nonce = generator_.Generate(NONCE_SIZE);
-  std::vector<unsigned char> nonce_vec(nonce.Begin(), nonce.End());
-  auto derivedKey = deriver_->Derive(KeySize(), nonce_vec);
-
-  auto encrypted = EncryptInternal(token, derivedKey);
+  return Encrypt(token, std::string());
+}
 
-  // Concatenate the claim nonce and the ciphertext
-  // Result is: derive_nonce || gcm_nonce || ciphertext || tag
-  std::vector<unsigned char> output(nonce_vec);
-  output.insert(output.end(), encrypted.begin(), encrypted.end());
+std::string TokenEncryptorImpl::Encrypt(const std::string& token,
+                                        const std::string& aad) {
+  // Result is: format || key_id || nonce || ciphertext || tag
+  // It is assembled at the end of the output string and then UrlBase64
+  // encoded in place, so that the string is the only allocation.
+  auto max_len = header_.size() + token.size() + encryptor_->Overhead();
+  std::string output(WebSafeBase64Length(max_len), '\0');
+  auto raw = Bytes(output).subspan(output.size() - max_len);
+  std::copy(header_.begin(), header_.end(), raw.begin());
+  std::vector<unsigned char> full_aad;
+  if (!aad.empty()) {
+    full_aad = header_;
+    full_aad.insert(full_aad.end(), aad.begin(), aad.end());
+  }
+  auto len = header_.size() +
+             encryptor_->Seal(Bytes(token), aad.empty() ? header_ : full_aad,
+                              raw.subspan(HEADER_SIZE));
 
-  // UrlBase64 encode the final encrypted JWT
-  return absl::WebSafeBase64Escape(absl::string_view(
-      reinterpret_cast<const char*>(output.data()), output.size()));
+  WebSafeBase64Encode(raw.data(), len, &output[0]);
+  output.resize(WebSafeBase64Length(len));
+  return output;
 }
 
 absl::optional<std::string> TokenEncryptorImpl::Decrypt(
     const std::string& ciphertext) {
+  return Decrypt(ciphertext, std::string());
+}
+
+absl::optional<std::string> TokenEncryptorImpl::Decrypt(
+    const std::string& ciphertext, const std::string& aad) {
   // UrlBase64 decode the token
   std::string decoded;
-  if (!absl::WebSafeBase64Unescape(ciphertext, &decoded) ||
-      decoded.size() < NONCE_SIZE) {
+  if (!absl::WebSafeBase64Unescape(ciphertext, &decoded)) {
+    return absl::nullopt;
+  }
+
+  auto bytes = Bytes(decoded);
+  if (bytes.size() >= HEADER_SIZE && bytes[0] <= MAX_FORMAT &&
+      decryptors_[bytes[0]] &&
+      std::equal(header_.begin() + 1, header_.end(), bytes.begin() + 1)) {
+    // Decrypt in place, then move the plaintext to the front of the string.
+    auto& decryptor = decryptors_[bytes[0]];
+    auto prefix_len = HEADER_SIZE + decryptor->NonceLength();
+    absl::Span<const uint8_t> additional = bytes.first(HEADER_SIZE);
+    std::vector<unsigned char> full_aad;
+    if (!aad.empty()) {
+      full_aad.assign(additional.begin(), additional.end());
+      full_aad.insert(full_aad.end(), aad.begin(), aad.end());
+      additional = full_aad;
+    }
+    auto len = decoded.size() >= prefix_len
+                   ? decryptor->Open(bytes.subspan(HEADER_SIZE), additional,
+                                     bytes.subspan(prefix_len))
+                   : absl::nullopt;
+    if (len) {
+      decoded.erase(0, prefix_len);
+      decoded.resize(*len);
+      return decoded;
+    }
+    // A legacy token may begin with the same bytes by chance. Decryption
+    // may have overwritten it, so decode it again.
+    if (!absl::WebSafeBase64Unescape(ciphertext, &decoded)) {
+      return absl::nullopt;
+    }
+  }
+  // Legacy tokens were never sealed with additional data.
+  if (!aad.empty()) {
+    return absl::nullopt;
+  }
+  return DecryptLegacy(std::move(decoded));
+}
+
+absl::optional<std::string> TokenEncryptorImpl::DecryptLegacy(
+    std::string decoded) {
+  if (decoded.size() < NONCE_SIZE) {
     return absl::nullopt;
   }
 
@@ -100,15 +233,25 @@ absl::optional<std::string> TokenEncryptorImpl::Decrypt(
 
   // Decrypt the JWT
   auto decryptor = GcmEncryptor::Create(derivedKey);
-  std::vector<unsigned char> ciphertext_vec(decoded.begin() + NONCE_SIZE,
-                                            decoded.end());
-  auto decrypted = decryptor->Open(ciphertext_vec);
+  auto prefix_len = NONCE_SIZE + decryptor->NonceLength();
+  auto bytes = Bytes(decoded);
+  auto len = decoded.size() >= prefix_len
+                 ? decryptor->Open(bytes.subspan(NONCE_SIZE), {},
+                                   bytes.subspan(prefix_len))
+                 : absl::nullopt;
 
-  if (!decrypted) {
+  if (!len) {
     return absl::nullopt;
   }
 
-  return std::string(decrypted->begin(), decrypted->end());
+  decoded.erase(0, prefix_len);
+  decoded.resize(*len);
+  return decoded;
+}
+
+EncryptionAlg PreferredEncryptionAlg() {
+  return EVP_has_aes_hardware() ? EncryptionAlg::AES256GCM
+                                : EncryptionAlg::CHACHA20POLY1305;
 }
 
 TokenEncryptorPtr TokenEncryptor::Create(const std::string& secret,
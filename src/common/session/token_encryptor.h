@@ -15,8 +15,17 @@ typedef std::shared_ptr<TokenEncryptor> TokenEncryptorPtr;
 enum class EncryptionAlg {
   AES128GCM,
   AES256GCM,
+  CHACHA20POLY1305,
 };
 
+/**
+ * The fastest encryption algorithm on this CPU. AES-GCM is used where the CPU
+ * accelerates AES, and ChaCha20-Poly1305, which is faster in software,
+ * elsewhere.
+ * @return the encryption algorithm.
+ */
+EncryptionAlg PreferredEncryptionAlg();
+
 /** Token encryption utility */
 class TokenEncryptor {
  public:
@@ -30,6 +39,17 @@ class TokenEncryptor {
    */
   virtual std::string Encrypt(const std::string& token) = 0;
 
+  /**
+   * Encrypt the given token, binding it to additional data that must be
+   * supplied again to decrypt it.
+   * @param token the token to encrypt and authenticate.
+   * @param aad   additional authenticated data, which is not included in the
+   * result.
+   * @return base64 string representing the encrypted/authenticated data
+   */
+  virtual std::string Encrypt(const std::string& token,
+                              const std::string& aad) = 0;
+
   /**
    * Decrypt the given token.
    * @param ciphertext the data (nonce || ciphertext || tag) to be decrypted.
@@ -39,12 +59,21 @@ class TokenEncryptor {
   virtual absl::optional<std::string> Decrypt(
       const std::string& ciphertext) = 0;
 
+  /**
+   * Decrypt a token encrypted with additional authenticated data.
+   * @param ciphertext the data (nonce || ciphertext || tag) to be decrypted.
+   * @param aad        the additional authenticated data it was encrypted with.
+   * @return plaintext string, or absl::nullopt if verification failed.
+   */
+  virtual absl::optional<std::string> Decrypt(const std::string& ciphertext,
+                                              const std::string& aad) = 0;
+
   /**
    * Create an instance of a TokenEncryptor.
    * @param secret       base64 encoded data of the secret used to derive the
    * encryption key.
-   * @param enc_alg      encryption algorithm to be used for
-   * encryption/decryption.
+   * @param enc_alg      encryption algorithm to be used for encryption.
+   * Tokens encrypted with any algorithm are decrypted.
    * @param hash_alg     hash algorithm to be used for key derivation.
    * @return an instance of a TokenEncryptor.
    */
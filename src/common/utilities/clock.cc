@@ -0,0 +1,23 @@
+#include "src/common/utilities/clock.h"
+#include <time.h>
+#include <chrono>
+
+namespace authservice {
+namespace common {
+namespace utilities {
+
+int64_t CoarseUnixSeconds() {
+#ifdef CLOCK_REALTIME_COARSE
+  struct timespec now;
+  if (clock_gettime(CLOCK_REALTIME_COARSE, &now) == 0) {
+    return now.tv_sec;
+  }
+#endif
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace utilities
+}  // namespace common
+}  // namespace authservice
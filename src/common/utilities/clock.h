@@ -0,0 +1,22 @@
+#ifndef AUTHSERVICE_SRC_COMMON_UTILITIES_CLOCK_H_
+#define AUTHSERVICE_SRC_COMMON_UTILITIES_CLOCK_H_
+#include <cstdint>
+
+namespace authservice {
+namespace common {
+namespace utilities {
+
+/** @brief The current unix time in seconds, read from a coarse clock.
+ *
+ * The kernel caches the coarse clock and updates it once per tick, so it
+ * is read without a system call or a hardware counter read. It is ample for
+ * comparing against token expiry times, which are in whole seconds.
+ *
+ * @return the number of seconds since the unix epoch.
+ */
+int64_t CoarseUnixSeconds();
+
+}  // namespace utilities
+}  // namespace common
+}  // namespace authservice
+#endif  // AUTHSERVICE_SRC_COMMON_UTILITIES_CLOCK_H_
@@ -1,14 +1,94 @@
 #include "random.h"
-#include <iomanip>
-#include <sstream>
+#include <pthread.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include "absl/strings/escaping.h"
+#include "openssl/chacha.h"
 #include "openssl/crypto.h"
+#include "openssl/mem.h"
 #include "openssl/rand.h"
 
 namespace authservice {
 namespace common {
 namespace utilities {
 
+namespace {
+// The number of bytes a thread's generator produces before it is reseeded.
+const uint64_t reseed_interval_ = 1 << 20;
+
+// Incremented in the child of every fork so that threads reseed rather than
+// repeat output that their parent also produces.
+std::atomic<uint64_t> fork_generation_(0);
+void OnFork() { fork_generation_.fetch_add(1, std::memory_order_relaxed); }
+const int atfork_registered_ = pthread_atfork(nullptr, nullptr, &OnFork);
+
+class Drbg {
+ public:
+  ~Drbg() {
+    OPENSSL_cleanse(key_, sizeof(key_));
+    OPENSSL_cleanse(block_, sizeof(block_));
+  }
+
+  void Fill(uint8_t *out, size_t len) {
+    auto generation = fork_generation_.load(std::memory_order_relaxed);
+    if (!seeded_ || generation != generation_ ||
+        generated_ >= reseed_interval_) {
+      Reseed(generation);
+    }
+    while (len > 0) {
+      if (available_ == 0) {
+        NextBlock();
+      }
+      auto count = std::min(len, available_);
+      auto next = block_ + sizeof(block_) - available_;
+      memcpy(out, next, count);
+      OPENSSL_cleanse(next, count);
+      out += count;
+      len -= count;
+      available_ -= count;
+      generated_ += count;
+    }
+  }
+
+ private:
+  uint8_t key_[32];
+  uint8_t block_[512];
+  size_t available_ = 0;
+  uint64_t generated_ = 0;
+  uint64_t generation_ = 0;
+  bool seeded_ = false;
+
+  void Reseed(uint64_t generation) {
+    // boringssl guarantees to return 1 (or abort) but we'll play safe
+    // and check and abort() just in case.
+    if (RAND_bytes(key_, sizeof(key_)) != 1) {
+      abort();
+    }
+    OPENSSL_cleanse(block_, sizeof(block_));
+    available_ = 0;
+    generated_ = 0;
+    generation_ = generation;
+    seeded_ = true;
+  }
+
+  void NextBlock() {
+    static const uint8_t nonce[12] = {0};
+    memset(block_, 0, sizeof(block_));
+    CRYPTO_chacha_20(block_, block_, sizeof(block_), key_, nonce, 0);
+    // The start of each block keys the next, so the nonce never needs to
+    // change.
+    memcpy(key_, block_, sizeof(key_));
+    OPENSSL_cleanse(block_, sizeof(key_));
+    available_ = sizeof(block_) - sizeof(key_);
+  }
+};
+
+thread_local Drbg drbg_;
+}  // namespace
+
+Random::Random(size_t len) : internal_buffer_(len) {}
+
 Random::Random(const uint8_t *randomness, size_t len)
     : internal_buffer_(randomness, randomness + len) {}
 
@@ -25,12 +105,10 @@ bool Random::operator!=(const Random &rhs) const { return !(*this == rhs); }
 
 size_t Random::Size() const { return internal_buffer_.size(); }
 
-std::vector<uint8_t>::const_iterator Random::Begin() const {
-  return internal_buffer_.cbegin();
-}
+const uint8_t *Random::Begin() const { return internal_buffer_.data(); }
 
-std::vector<uint8_t>::const_iterator Random::End() const {
-  return internal_buffer_.cend();
+const uint8_t *Random::End() const {
+  return internal_buffer_.data() + internal_buffer_.size();
 }
 
 std::string Random::Str() const {
@@ -47,14 +125,15 @@ absl::optional<Random> Random::FromString(absl::string_view str) {
   return Random(reinterpret_cast<const uint8_t *>(tmp.c_str()), tmp.size());
 }
 
+void RandomGenerator::Fill(uint8_t *out, size_t len) {
+  (void)atfork_registered_;
+  drbg_.Fill(out, len);
+}
+
 Random RandomGenerator::Generate(size_t sz) {
-  // boringssl guarantees to return 1 (or abort) but we'll play safe
-  // and check and abort() just in case.
-  uint8_t tmp[sz];
-  if (RAND_bytes(tmp, sz) != 1) {
-    abort();
-  }
-  return Random(tmp, sz);
+  Random random(sz);
+  Fill(random.internal_buffer_.data(), sz);
+  return random;
 }
 }  // namespace utilities
 }  // namespace common
@@ -1,8 +1,9 @@
 #ifndef AUTHSERVICE_SRC_COMMON_UTILITIES_RANDOM_H_
 #define AUTHSERVICE_SRC_COMMON_UTILITIES_RANDOM_H_
+#include <cstdint>
 #include <memory>
 #include <string>
-#include <vector>
+#include "absl/container/inlined_vector.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 
@@ -11,7 +12,12 @@ namespace common {
 namespace utilities {
 class Random {
  private:
-  std::vector<uint8_t> internal_buffer_;
+  // Values of up to 32 bytes, the size of state and nonce values, are held
+  // without a heap allocation.
+  absl::InlinedVector<uint8_t, 32> internal_buffer_;
+
+  explicit Random(size_t len);
+  friend class RandomGenerator;
 
  public:
   /**
@@ -40,12 +46,12 @@ class Random {
    * An iterator to the first item of the internal buffer.
    * @return A const iterator
    */
-  std::vector<uint8_t>::const_iterator Begin() const;
+  const uint8_t *Begin() const;
   /**
    * An iterator to indicate an iterator has completed or is not valid.
    * @return A const iterator
    */
-  std::vector<uint8_t>::const_iterator End() const;
+  const uint8_t *End() const;
   /**
    * Encode a representation to string suitable for use in HTTP requests.
    * or unique state index.
@@ -61,8 +67,22 @@ class Random {
   static absl::optional<Random> FromString(absl::string_view str);
 };
 
+/**
+ * Each thread draws from its own ChaCha20 based generator, which is seeded
+ * from BoringSSL's RAND_bytes and reseeded after every megabyte of output and
+ * in the child of a fork. Generated keystream is erased once handed out and the
+ * key is replaced after every block, so earlier output cannot be recovered
+ * from a thread's generator state.
+ */
 class RandomGenerator {
  public:
+  /**
+   * Fill a buffer with random data.
+   * @param out the buffer to fill.
+   * @param len the number of bytes to write.
+   */
+  static void Fill(uint8_t *out, size_t len);
+
   /**
    * Generate a Random with the requested number of bytes of data read from the
    * generator's random source.
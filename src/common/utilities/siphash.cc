@@ -0,0 +1,60 @@
+#include "src/common/utilities/siphash.h"
+
+namespace authservice {
+namespace common {
+namespace utilities {
+
+namespace {
+uint64_t RotateLeft(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+void SipRound(uint64_t v[4]) {
+  v[0] += v[1];
+  v[1] = RotateLeft(v[1], 13) ^ v[0];
+  v[0] = RotateLeft(v[0], 32);
+  v[2] += v[3];
+  v[3] = RotateLeft(v[3], 16) ^ v[2];
+  v[0] += v[3];
+  v[3] = RotateLeft(v[3], 21) ^ v[0];
+  v[2] += v[1];
+  v[1] = RotateLeft(v[1], 17) ^ v[2];
+  v[2] = RotateLeft(v[2], 32);
+}
+}  // namespace
+
+uint64_t SipHash24(const uint64_t key[2], absl::string_view in) {
+  uint64_t v[4] = {key[0] ^ 0x736f6d6570736575ull,
+                   key[1] ^ 0x646f72616e646f6dull,
+                   key[0] ^ 0x6c7967656e657261ull,
+                   key[1] ^ 0x7465646279746573ull};
+  auto data = reinterpret_cast<const uint8_t *>(in.data());
+  auto size = in.size();
+  for (; size >= 8; data += 8, size -= 8) {
+    uint64_t m = 0;
+    for (int i = 7; i >= 0; --i) {
+      m = (m << 8) | data[i];
+    }
+    v[3] ^= m;
+    SipRound(v);
+    SipRound(v);
+    v[0] ^= m;
+  }
+  uint64_t m = static_cast<uint64_t>(in.size()) << 56;
+  for (size_t i = 0; i < size; ++i) {
+    m |= static_cast<uint64_t>(data[i]) << (8 * i);
+  }
+  v[3] ^= m;
+  SipRound(v);
+  SipRound(v);
+  v[0] ^= m;
+  v[2] ^= 0xff;
+  for (int i = 0; i < 4; ++i) {
+    SipRound(v);
+  }
+  return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+}  // namespace utilities
+}  // namespace common
+}  // namespace authservice
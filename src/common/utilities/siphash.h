@@ -0,0 +1,25 @@
+#ifndef AUTHSERVICE_SRC_COMMON_UTILITIES_SIPHASH_H_
+#define AUTHSERVICE_SRC_COMMON_UTILITIES_SIPHASH_H_
+#include <cstdint>
+#include "absl/strings/string_view.h"
+
+namespace authservice {
+namespace common {
+namespace utilities {
+
+/** @brief SipHash-2-4 of the given input.
+ *
+ * A keyed hash that is cheap for short inputs yet keeps clients who do not
+ * know the key from choosing colliding inputs, for use in hash tables indexed
+ * by client supplied values.
+ *
+ * @param key the 128 bit key, as two little endian 64 bit words.
+ * @param in the input to hash.
+ * @return the 64 bit hash.
+ */
+uint64_t SipHash24(const uint64_t key[2], absl::string_view in);
+
+}  // namespace utilities
+}  // namespace common
+}  // namespace authservice
+#endif  // AUTHSERVICE_SRC_COMMON_UTILITIES_SIPHASH_H_
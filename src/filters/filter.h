@@ -1,5 +1,6 @@
 #ifndef AUTHSERVICE_SRC_FILTERS_FILTER_H_
 #define AUTHSERVICE_SRC_FILTERS_FILTER_H_
+#include <functional>
 #include "absl/strings/string_view.h"
 #include "envoy/service/auth/v2/external_auth.grpc.pb.h"
 #include "google/rpc/code.pb.h"
@@ -8,6 +9,10 @@ using namespace envoy::service::auth::v2;
 
 namespace authservice {
 namespace filters {
+
+/** @brief Invoked with the status of asynchronous processing. */
+typedef std::function<void(google::rpc::Code)> ProcessCallback;
+
 /** @brief Filter defines an abstract class for processing requests.
  *
  * Filter defines an abstract class for processing requests. Filters are
@@ -40,6 +45,26 @@ class Filter {
       const ::envoy::service::auth::v2::CheckRequest* request,
       ::envoy::service::auth::v2::CheckResponse* response) = 0;
 
+  /** @brief Process a request without blocking on I/O.
+   *
+   * As Process, except that the status is passed to the given callback rather
+   * than returned. Filters that wait on the network should override this so
+   * that the calling thread is released whilst they do. The callback is
+   * invoked exactly once, possibly on another thread and possibly before this
+   * call returns. The request and response must remain valid until then.
+   * The default implementation calls Process.
+   *
+   * @param request the request process.
+   * @param response the response to augment.
+   * @param callback invoked with the status of the processing.
+   */
+  virtual void ProcessAsync(
+      const ::envoy::service::auth::v2::CheckRequest* request,
+      ::envoy::service::auth::v2::CheckResponse* response,
+      ProcessCallback callback) {
+    callback(Process(request, response));
+  }
+
   /** @brief Name the well-known name of the filter.
    *
    * Name the well-known name of the filter which can be used for logging
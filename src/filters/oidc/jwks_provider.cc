@@ -0,0 +1,276 @@
+#include "jwks_provider.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "spdlog/spdlog.h"
+#include "src/common/metrics/metrics.h"
+
+namespace authservice {
+namespace filters {
+namespace oidc {
+namespace {
+const char *max_age_directive_ = "max-age=";
+const char *no_cache_directive_ = "no-cache";
+const char *no_store_directive_ = "no-store";
+const char *fetches_metric_ = "jwks_fetches_total";
+const char *fetch_failures_metric_ = "jwks_fetch_failures_total";
+const char *refreshes_metric_ = "jwks_kid_refreshes_total";
+// Bounds the memory used to remember unknown key ids.
+const size_t max_missed_kids_ = 1024;
+
+JwksSnapshotPtr ParseJwks(const std::string &raw) {
+  auto jwks = google::jwt_verify::Jwks::createFrom(
+      raw, google::jwt_verify::Jwks::Type::JWKS);
+  if (jwks->getStatus() != google::jwt_verify::Status::Ok) {
+    spdlog::info("{}: invalid key set: {}", __func__,
+                 google::jwt_verify::getStatusString(jwks->getStatus()));
+    return nullptr;
+  }
+  return JwksSnapshotPtr(std::move(jwks));
+}
+
+JwksSnapshotPtr LoadSnapshot(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    spdlog::info("{}: no key set snapshot at {}", __func__, path);
+    return nullptr;
+  }
+  std::stringstream raw;
+  raw << file.rdbuf();
+  auto jwks = ParseJwks(raw.str());
+  if (jwks) {
+    spdlog::info("{}: loaded key set snapshot from {}", __func__, path);
+  }
+  return jwks;
+}
+
+void WriteSnapshot(const std::string &path, const std::string &raw) {
+  // Write to a temporary file and rename it into place so that a crash
+  // cannot leave a truncated snapshot behind.
+  auto temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file << raw;
+    if (!file.flush()) {
+      spdlog::info("{}: unable to write key set snapshot to {}", __func__,
+                   temporary);
+      return;
+    }
+  }
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    spdlog::info("{}: unable to replace key set snapshot at {}", __func__,
+                 path);
+  }
+}
+}  // namespace
+
+struct RemoteJwksProvider::State {
+  common::http::ptr_t http;
+  authservice::config::common::Endpoint jwks_uri;
+  std::string snapshot_path;
+  Options options;
+  // Only accessed through std::atomic_load/std::atomic_store.
+  JwksSnapshotPtr jwks;
+  std::mutex mtx;
+  // Wakes the background thread to stop or to refetch.
+  std::condition_variable wake;
+  // The following are guarded by mtx.
+  bool stopped = false;
+  std::chrono::steady_clock::time_point last_fetch;
+  // Whether a fetch for an unknown key id is pending or in progress.
+  bool refetch = false;
+  bool fetching = false;
+  // Unknown key ids waiting on the next fetch.
+  std::set<std::string> requested_kids;
+  // Unknown key ids that a fetch did not help with, and when they may next
+  // be refreshed for.
+  std::map<std::string, std::chrono::steady_clock::time_point> missed_kids;
+
+  /** @brief Remember that refreshing did not help with a key id.
+   *
+   * Must be called with mtx held.
+   */
+  void RememberMiss(const std::string &kid,
+                    std::chrono::steady_clock::time_point now) {
+    if (missed_kids.size() >= max_missed_kids_) {
+      for (auto it = missed_kids.begin(); it != missed_kids.end();) {
+        it = it->second <= now ? missed_kids.erase(it) : std::next(it);
+      }
+      if (missed_kids.size() >= max_missed_kids_) {
+        missed_kids.clear();
+      }
+    }
+    missed_kids[kid] = now + options.negative_ttl;
+  }
+
+  /** @brief Fetch the key set.
+   *
+   * @return the time until the next fetch.
+   */
+  std::chrono::seconds Fetch() {
+    auto &metrics = common::metrics::Registry::Instance();
+    metrics.GetCounter(fetches_metric_).Increment();
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      last_fetch = std::chrono::steady_clock::now();
+    }
+    auto response = http->Get(jwks_uri, {});
+    if (response == nullptr ||
+        response->result() != boost::beast::http::status::ok) {
+      spdlog::info("{}: unable to fetch key set from {}", __func__,
+                   common::http::http::ToUrl(jwks_uri));
+      metrics.GetCounter(fetch_failures_metric_).Increment();
+      return options.retry;
+    }
+    auto updated = ParseJwks(response->body());
+    if (updated == nullptr) {
+      metrics.GetCounter(fetch_failures_metric_).Increment();
+      return options.retry;
+    }
+    std::atomic_store(&jwks, updated);
+    if (!snapshot_path.empty()) {
+      WriteSnapshot(snapshot_path, response->body());
+    }
+    auto cache_control = (*response)[boost::beast::http::field::cache_control];
+    auto interval = RefreshInterval(
+        absl::string_view(cache_control.data(), cache_control.size()),
+        options);
+    spdlog::debug("{}: fetched key set, refreshing in {}s", __func__,
+                  interval.count());
+    return interval;
+  }
+};
+
+StaticJwksProvider::StaticJwksProvider(google::jwt_verify::JwksPtr jwks)
+    : jwks_(std::move(jwks)) {}
+
+JwksSnapshotPtr StaticJwksProvider::Get() const { return jwks_; }
+
+RemoteJwksProvider::RemoteJwksProvider(
+    common::http::ptr_t http,
+    const authservice::config::common::Endpoint &jwks_uri,
+    const std::string &snapshot_path, Options options)
+    : state_(std::make_shared<State>()) {
+  state_->http = http;
+  state_->jwks_uri = jwks_uri;
+  state_->snapshot_path = snapshot_path;
+  state_->options = options;
+  if (!snapshot_path.empty()) {
+    std::atomic_store(&state_->jwks, LoadSnapshot(snapshot_path));
+  }
+  thread_ = std::thread(&RemoteJwksProvider::Run, state_);
+}
+
+RemoteJwksProvider::RemoteJwksProvider(
+    common::http::ptr_t http,
+    const authservice::config::common::Endpoint &jwks_uri,
+    const std::string &snapshot_path)
+    : RemoteJwksProvider(http, jwks_uri, snapshot_path, Options()) {}
+
+RemoteJwksProvider::~RemoteJwksProvider() {
+  {
+    std::unique_lock<std::mutex> lock(state_->mtx);
+    state_->stopped = true;
+  }
+  state_->wake.notify_all();
+  // Don't wait on a fetch that is in progress. The thread exits as soon as it
+  // completes.
+  thread_.detach();
+}
+
+JwksSnapshotPtr RemoteJwksProvider::Get() const {
+  return std::atomic_load(&state_->jwks);
+}
+
+JwksSnapshotPtr RemoteJwksProvider::Refresh(const std::string &kid) {
+  {
+    std::lock_guard<std::mutex> lock(state_->mtx);
+    auto now = std::chrono::steady_clock::now();
+    auto missed = state_->missed_kids.find(kid);
+    if (missed != state_->missed_kids.end() && now < missed->second) {
+      return Get();
+    }
+    if (state_->requested_kids.size() >= max_missed_kids_ ||
+        !state_->requested_kids.insert(kid).second) {
+      return Get();
+    }
+    // A fetch in progress may predate the key, so the background thread
+    // fetches again once it completes.
+    if (state_->refetch || state_->fetching) {
+      return Get();
+    }
+    state_->refetch = true;
+  }
+  spdlog::info("{}: refreshing key set for unknown key id {}", __func__, kid);
+  common::metrics::Registry::Instance()
+      .GetCounter(refreshes_metric_)
+      .Increment();
+  state_->wake.notify_all();
+  return Get();
+}
+
+std::chrono::seconds RemoteJwksProvider::RefreshInterval(
+    absl::string_view cache_control, const Options &options) {
+  auto interval = options.default_refresh;
+  for (auto directive : absl::StrSplit(cache_control, ',')) {
+    directive = absl::StripAsciiWhitespace(directive);
+    if (absl::EqualsIgnoreCase(directive, no_cache_directive_) ||
+        absl::EqualsIgnoreCase(directive, no_store_directive_)) {
+      return options.min_refresh;
+    }
+    if (absl::StartsWithIgnoreCase(directive, max_age_directive_)) {
+      int64_t max_age;
+      directive.remove_prefix(strlen(max_age_directive_));
+      if (absl::SimpleAtoi(directive, &max_age)) {
+        interval = std::chrono::seconds(max_age);
+      }
+    }
+  }
+  return std::min(std::max(interval, options.min_refresh),
+                  options.max_refresh);
+}
+
+void RemoteJwksProvider::Run(std::shared_ptr<State> state) {
+  std::unique_lock<std::mutex> lock(state->mtx);
+  while (!state->stopped) {
+    std::set<std::string> requested;
+    requested.swap(state->requested_kids);
+    state->refetch = false;
+    state->fetching = true;
+    lock.unlock();
+    auto interval = state->Fetch();
+    lock.lock();
+    state->fetching = false;
+    // Key ids are remembered even if the fetch found them, as callers only
+    // refresh for key ids that are missing.
+    auto now = std::chrono::steady_clock::now();
+    for (const auto &kid : requested) {
+      state->RememberMiss(kid, now);
+    }
+    if (!state->requested_kids.empty()) {
+      state->refetch = true;
+    }
+    state->wake.wait_for(lock, interval, [&state]() {
+      return state->stopped || state->refetch;
+    });
+    // Refetches are deferred, rather than dropped, until min_refetch after
+    // the previous fetch, so that made up key ids cannot flood the IdP.
+    state->wake.wait_until(
+        lock, state->last_fetch + state->options.min_refetch,
+        [&state]() { return state->stopped; });
+  }
+}
+
+}  // namespace oidc
+}  // namespace filters
+}  // namespace authservice
@@ -0,0 +1,134 @@
+#ifndef AUTHSERVICE_SRC_FILTERS_OIDC_JWKS_PROVIDER_H_
+#define AUTHSERVICE_SRC_FILTERS_OIDC_JWKS_PROVIDER_H_
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include "absl/strings/string_view.h"
+#include "config/common/config.pb.h"
+#include "jwt_verify_lib/jwks.h"
+#include "src/common/http/http.h"
+
+namespace authservice {
+namespace filters {
+namespace oidc {
+
+typedef std::shared_ptr<const google::jwt_verify::Jwks> JwksSnapshotPtr;
+
+/** @brief JwksProvider supplies the key set used to verify id tokens. */
+class JwksProvider {
+ public:
+  virtual ~JwksProvider() = default;
+
+  /** @brief The current key set.
+   *
+   * The returned key set is immutable and remains valid for as long as the
+   * caller holds it, even if the provider moves on to a newer one.
+   *
+   * @return the current key set, or null if none is available yet.
+   */
+  virtual JwksSnapshotPtr Get() const = 0;
+
+  /** @brief Ask for the key set to be refreshed as it has no key for a token.
+   *
+   * Called when a token is signed with a key that is not in the current key
+   * set, as happens when the IdP rotates its keys. Tokens are verified on the
+   * threads that handle responses from the IdP, so this must not block on a
+   * fetch: the token in hand is checked against whatever key set is current,
+   * and later tokens see the refreshed one. The first login with a newly
+   * rotated key therefore fails unless the refreshed key set has already
+   * arrived. Providers that cannot refresh return the current key set.
+   *
+   * @param kid the key id of the token, which may be empty.
+   * @return the current key set, or null if none is available.
+   */
+  virtual JwksSnapshotPtr Refresh(const std::string & /* kid */) {
+    return Get();
+  }
+};
+typedef std::shared_ptr<JwksProvider> JwksProviderPtr;
+
+/** @brief A provider of a key set that never changes. */
+class StaticJwksProvider final : public JwksProvider {
+ private:
+  JwksSnapshotPtr jwks_;
+
+ public:
+  explicit StaticJwksProvider(google::jwt_verify::JwksPtr jwks);
+
+  JwksSnapshotPtr Get() const override;
+};
+
+/** @brief A provider of a key set fetched from an IdP's jwks_uri.
+ *
+ * The key set is fetched by a background thread and refreshed as directed by
+ * the Cache-Control header of each response. New key sets are published by
+ * atomically swapping the current snapshot, so Get never blocks. When
+ * configured with a snapshot path the last good key set is also written to
+ * disk and read back on construction, so that tokens can be verified at start
+ * up without waiting on the IdP.
+ */
+class RemoteJwksProvider final : public JwksProvider {
+ public:
+  struct Options {
+    // The refresh interval when the response does not specify a max-age.
+    std::chrono::seconds default_refresh = std::chrono::hours(1);
+    // Bounds on the refresh interval requested by the IdP.
+    std::chrono::seconds min_refresh = std::chrono::minutes(1);
+    std::chrono::seconds max_refresh = std::chrono::hours(24);
+    // How long to wait before retrying a failed fetch.
+    std::chrono::seconds retry = std::chrono::seconds(10);
+    // The minimum time between a fetch and a refresh for an unknown key id.
+    std::chrono::seconds min_refetch = std::chrono::seconds(30);
+    // How long a key id that a refresh did not help is ignored for.
+    std::chrono::seconds negative_ttl = std::chrono::minutes(5);
+  };
+
+  RemoteJwksProvider(common::http::ptr_t http,
+                     const authservice::config::common::Endpoint &jwks_uri,
+                     const std::string &snapshot_path, Options options);
+  RemoteJwksProvider(common::http::ptr_t http,
+                     const authservice::config::common::Endpoint &jwks_uri,
+                     const std::string &snapshot_path);
+  ~RemoteJwksProvider();
+
+  JwksSnapshotPtr Get() const override;
+
+  /** @brief Wake the background thread to refetch for an unknown key id.
+   *
+   * Returns without waiting for the fetch, so the login that presented the
+   * key id fails, having already spent its authorization code; the user's
+   * next login is verified against the refreshed key set. Refreshes made
+   * whilst a fetch is pending are coalesced into it, and those made whilst a
+   * fetch is in progress into the one after. To protect the IdP from tokens
+   * with made up key ids, a refetch is deferred until min_refetch after the
+   * previous fetch, and a key id that a fetch did not help with is not
+   * refreshed for again until negative_ttl has passed.
+   */
+  JwksSnapshotPtr Refresh(const std::string &kid) override;
+
+  /** @brief Determine when to next refresh from a Cache-Control header.
+   *
+   * @param cache_control the Cache-Control header value, which may be empty.
+   * @param options the bounds to apply.
+   * @return the time until the key set should next be fetched.
+   */
+  static std::chrono::seconds RefreshInterval(absl::string_view cache_control,
+                                              const Options &options);
+
+ private:
+  struct State;
+  // Shared with the background thread, which may outlive the provider until
+  // its current fetch completes.
+  std::shared_ptr<State> state_;
+  std::thread thread_;
+
+  /** @brief Fetch and refresh the key set until stopped. */
+  static void Run(std::shared_ptr<State> state);
+};
+
+}  // namespace oidc
+}  // namespace filters
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_FILTERS_OIDC_JWKS_PROVIDER_H_
@@ -0,0 +1,156 @@
+#include "src/filters/oidc/login_state_pool.h"
+#include <algorithm>
+#include <cstdint>
+#include "spdlog/spdlog.h"
+#include "src/common/metrics/metrics.h"
+#include "src/common/utilities/random.h"
+#include "src/filters/oidc/state_cookie_codec.h"
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace authservice {
+namespace filters {
+namespace oidc {
+
+namespace {
+const char *hits_metric_ = "login_state_pool_hits_total";
+const char *misses_metric_ = "login_state_pool_misses_total";
+// How often the pool is checked when no one has asked for it to be refilled.
+const std::chrono::seconds refill_interval_ = std::chrono::seconds(1);
+// The niceness of the thread that fills the pool.
+const int fill_priority_ = 10;
+}  // namespace
+
+LoginState LoginState::Generate(common::session::TokenEncryptor &cryptor) {
+  common::utilities::RandomGenerator generator;
+  LoginState login;
+  login.state = generator.Generate(32).Str();
+  login.nonce = generator.Generate(32).Str();
+  StateCookieCodec codec;
+  login.cookie = cryptor.Encrypt(codec.Encode(login.state, login.nonce));
+  return login;
+}
+
+LoginStatePool::LoginStatePool(common::session::TokenEncryptorPtr cryptor,
+                               size_t capacity)
+    : cryptor_(cryptor),
+      hits_(common::metrics::Registry::Instance().GetCounter(hits_metric_)),
+      misses_(
+          common::metrics::Registry::Instance().GetCounter(misses_metric_)),
+      head_(0),
+      tail_(0) {
+  size_t size = 2;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  mask_ = size - 1;
+  slots_.reset(new Slot[size]);
+  for (size_t i = 0; i < size; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  thread_ = std::thread(&LoginStatePool::Run, this);
+}
+
+LoginStatePool::~LoginStatePool() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stopped_ = true;
+  }
+  wake_.notify_all();
+  thread_.join();
+}
+
+size_t LoginStatePool::Capacity() const { return mask_ + 1; }
+
+size_t LoginStatePool::Size() const {
+  auto tail = tail_.load(std::memory_order_relaxed);
+  auto head = head_.load(std::memory_order_relaxed);
+  return tail > head ? tail - head : 0;
+}
+
+bool LoginStatePool::Push(LoginState &&value) {
+  auto position = tail_.load(std::memory_order_relaxed);
+  for (;;) {
+    auto &slot = slots_[position & mask_];
+    auto sequence = slot.sequence.load(std::memory_order_acquire);
+    auto difference =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+    if (difference == 0) {
+      if (tail_.compare_exchange_weak(position, position + 1,
+                                      std::memory_order_relaxed)) {
+        slot.value = std::move(value);
+        slot.sequence.store(position + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (difference < 0) {
+      // The slot has not been read since the previous lap, so the pool is
+      // full.
+      return false;
+    } else {
+      position = tail_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+absl::optional<LoginState> LoginStatePool::Pop() {
+  auto position = head_.load(std::memory_order_relaxed);
+  for (;;) {
+    auto &slot = slots_[position & mask_];
+    auto sequence = slot.sequence.load(std::memory_order_acquire);
+    auto difference =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+    if (difference == 0) {
+      if (head_.compare_exchange_weak(position, position + 1,
+                                      std::memory_order_relaxed)) {
+        LoginState value = std::move(slot.value);
+        slot.sequence.store(position + mask_ + 1, std::memory_order_release);
+        if (Size() <= mask_ / 2) {
+          wake_.notify_one();
+        }
+        hits_.Increment();
+        return value;
+      }
+    } else if (difference < 0) {
+      // The slot has not been written in this lap, so the pool is empty.
+      wake_.notify_one();
+      misses_.Increment();
+      return absl::nullopt;
+    } else {
+      position = head_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void LoginStatePool::Run() {
+#ifdef __linux__
+  // Linux applies the niceness of a thread id to that thread alone, so this
+  // leaves request handling threads at their normal priority.
+  if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)),
+                  fill_priority_) != 0) {
+    spdlog::debug("{}: unable to lower the priority of the pool thread",
+                  __func__);
+  }
+#endif
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (!stopped_) {
+    lock.unlock();
+    while (!stopped_ && Size() < Capacity()) {
+      if (!Push(LoginState::Generate(*cryptor_))) {
+        break;
+      }
+    }
+    lock.lock();
+    // Consumers wake the thread without holding the lock, so a wake up may be
+    // missed. The timeout bounds how long the pool can then stay depleted.
+    wake_.wait_for(lock, refill_interval_, [this]() {
+      return stopped_ || Size() <= mask_ / 2;
+    });
+  }
+}
+
+}  // namespace oidc
+}  // namespace filters
+}  // namespace authservice
@@ -0,0 +1,108 @@
+#ifndef AUTHSERVICE_SRC_FILTERS_OIDC_LOGIN_STATE_POOL_H_
+#define AUTHSERVICE_SRC_FILTERS_OIDC_LOGIN_STATE_POOL_H_
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "absl/types/optional.h"
+#include "src/common/metrics/metrics.h"
+#include "src/common/session/token_encryptor.h"
+
+namespace authservice {
+namespace filters {
+namespace oidc {
+
+/** @brief The values needed to redirect a user to the IdP to log in. */
+struct LoginState {
+  std::string state;
+  std::string nonce;
+  // The state and nonce encoded and encrypted for the state cookie.
+  std::string cookie;
+
+  /** @brief Generate a fresh login state.
+   *
+   * @param cryptor the encryptor to encrypt the state cookie with.
+   * @return the login state.
+   */
+  static LoginState Generate(common::session::TokenEncryptor &cryptor);
+};
+
+class LoginStatePool;
+typedef std::shared_ptr<LoginStatePool> LoginStatePoolPtr;
+
+/** @brief A bounded pool of login states generated ahead of time.
+ *
+ * Generating a login state takes several calls into the random source and an
+ * encryption. A low priority background thread keeps the pool topped up so
+ * that bursts of logins, such as those that follow a deployment, only need to
+ * take a ready made state.
+ *
+ * Taking a state is lock free. When the pool is empty callers are expected to
+ * generate a state themselves.
+ */
+class LoginStatePool {
+ public:
+  /** @brief Construct a pool and start filling it.
+   *
+   * @param cryptor the encryptor to encrypt state cookies with.
+   * @param capacity the maximum number of states to hold, which is rounded up
+   * to a power of two.
+   */
+  LoginStatePool(common::session::TokenEncryptorPtr cryptor, size_t capacity);
+  ~LoginStatePool();
+
+  LoginStatePool(const LoginStatePool &) = delete;
+  LoginStatePool &operator=(const LoginStatePool &) = delete;
+
+  /** @brief Take a state from the pool.
+   *
+   * @return a state that has not been handed out before, or absl::nullopt if
+   * the pool is empty.
+   */
+  absl::optional<LoginState> Pop();
+
+  /** @brief The capacity of the pool. */
+  size_t Capacity() const;
+
+  /** @brief The approximate number of states in the pool. */
+  size_t Size() const;
+
+ private:
+  // A bounded multi-producer, multi-consumer queue. Each slot's sequence
+  // number records whether it is ready to be written or read in the current
+  // lap of the ring.
+  struct Slot {
+    std::atomic<size_t> sequence;
+    LoginState value;
+  };
+
+  /** @brief Add a state to the pool, failing if it is full. */
+  bool Push(LoginState &&value);
+
+  /** @brief Fill the pool until stopped. */
+  void Run();
+
+  common::session::TokenEncryptorPtr cryptor_;
+  // Looked up once, as the registry takes a lock to find a metric.
+  common::metrics::Counter &hits_;
+  common::metrics::Counter &misses_;
+  size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  // Kept on separate cache lines so that producer and consumers do not
+  // contend.
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+
+  std::mutex mtx_;
+  std::condition_variable wake_;
+  std::atomic<bool> stopped_{false};
+  std::thread thread_;
+};
+
+}  // namespace oidc
+}  // namespace filters
+}  // namespace authservice
+#endif  // AUTHSERVICE_SRC_FILTERS_OIDC_LOGIN_STATE_POOL_H_
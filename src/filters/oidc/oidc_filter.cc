@@ -1,16 +1,21 @@
 #include "oidc_filter.h"
 #include <boost/beast.hpp>
+#include <set>
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "absl/time/time.h"
 #include "external/com_google_googleapis/google/rpc/code.pb.h"
 #include "spdlog/spdlog.h"
 #include "src/common/http/headers.h"
 #include "src/common/http/http.h"
-#include "src/common/utilities/random.h"
+#include "src/common/session/compact_token.h"
+#include "src/common/utilities/clock.h"
+#include "src/filters/request_view.h"
 #include "state_cookie_codec.h"
 #include "absl/time/clock.h"
 #include <limits>
 #include <algorithm>
+#include <chrono>
 
 namespace beast = boost::beast;    // from <boost/beast.hpp>
 namespace http = beast::http;      // from <boost/beast/http.hpp>
@@ -24,6 +29,18 @@ namespace oidc {
 namespace {
 const char *filter_name_ = "oidc";
 const char *mandatory_scope_ = "openid";
+// The time allowed for an asynchronous token request to the IdP.
+const std::chrono::seconds token_request_timeout_(30);
+// How long a decrypted token cookie may be served from the token cache.
+const std::chrono::minutes token_cache_ttl_(5);
+// Browsers drop cookies larger than this, counting some or all of their
+// directives.
+const size_t max_cookie_size_ = 4096;
+// The most digits a cookie's Max-Age can have.
+const size_t max_timeout_digits_ = 19;
+// How long a server side session lasts when the IdP does not say when its
+// tokens expire.
+const std::chrono::hours default_session_ttl_(24);
 
 const std::map<const char *, const char *> standard_headers = {
     {common::http::headers::CacheControl,
@@ -36,12 +53,58 @@ const std::map<const char *, const char *> standard_headers = {
 OidcFilter::OidcFilter(common::http::ptr_t http_ptr,
                        const authservice::config::oidc::OIDCConfig &idp_config,
                        TokenResponseParserPtr parser,
-                       common::session::TokenEncryptorPtr cryptor)
+                       common::session::TokenEncryptorPtr cryptor,
+                       common::session::TokenCachePtr token_cache,
+                       LoginStatePoolPtr login_state_pool,
+                       common::session::SessionStorePtr session_store)
     : http_ptr_(http_ptr),
       idp_config_(idp_config),
       parser_(parser),
-      cryptor_(cryptor) {
+      cryptor_(cryptor),
+      token_cache_(token_cache),
+      login_state_pool_(login_state_pool),
+      session_store_(session_store),
+      state_cookie_name_(GetCookieName("state")),
+      id_token_cookie_name_(GetCookieName("id-token")),
+      access_token_cookie_name_(GetCookieName("access-token")),
+      session_cookie_name_(GetCookieName("session")) {
   spdlog::trace("{}", __func__);
+  // The authorization request's query parameters are encoded in key order.
+  // Only the nonce and state vary, and being web safe base64 they need no
+  // encoding.
+  std::set<absl::string_view> scopes = {mandatory_scope_};
+  for (const auto &scope : idp_config_.scopes()) {
+    scopes.insert(scope);
+  }
+  auto callback = common::http::http::ToUrl(idp_config_.callback());
+  authorization_prefix_ = absl::StrCat(
+      common::http::http::ToUrl(idp_config_.authorization()), "?",
+      common::http::http::EncodeQueryData(
+          {{"client_id", idp_config_.client_id()}}),
+      "&nonce=");
+  authorization_infix_ = absl::StrCat(
+      "&",
+      common::http::http::EncodeQueryData(
+          {{"redirect_uri", callback},
+           {"response_type", "code"},
+           {"scope", absl::StrJoin(scopes, " ")}}),
+      "&state=");
+
+  // Set-Cookie directives are encoded in lexicographic order.
+  set_cookie_prefix_ =
+      absl::StrCat("; ", common::http::headers::SetCookieDirectives::HttpOnly,
+                   "; ", common::http::headers::SetCookieDirectives::MaxAge,
+                   "=");
+  set_cookie_suffix_ = absl::StrCat(
+      "; Path=/; ", common::http::headers::SetCookieDirectives::SameSiteLax,
+      "; ", common::http::headers::SetCookieDirectives::Secure);
+
+  basic_auth_ = common::http::http::EncodeBasicAuth(
+      idp_config_.client_id(), idp_config_.client_secret());
+  token_request_suffix_ = absl::StrCat(
+      "&", common::http::http::EncodeFormData(
+               {{"grant_type", "authorization_code"},
+                {"redirect_uri", callback}}));
 }
 
 void OidcFilter::SetHeader(
@@ -50,8 +113,8 @@ void OidcFilter::SetHeader(
     absl::string_view name, absl::string_view value) {
   auto header_value_option = headers->Add();
   auto header = header_value_option->mutable_header();
-  header->set_key(name.data());
-  header->set_value(value.data());
+  header->set_key(name.data(), name.size());
+  header->set_value(value.data(), value.size());
 }
 
 void OidcFilter::SetStandardResponseHeaders(
@@ -71,8 +134,11 @@ void OidcFilter::SetRedirectHeaders(
             common::http::headers::Location, redirect_url.data());
 }
 
-std::string OidcFilter::EncodeCookieTimeoutDirective(int64_t timeout) {
-  return std::string(common::http::headers::SetCookieDirectives::MaxAge) + "=" + std::to_string(timeout);
+std::string OidcFilter::EncodeSetCookie(absl::string_view name,
+                                        absl::string_view value,
+                                        int64_t timeout) const {
+  return absl::StrCat(name, "=", value, set_cookie_prefix_, timeout,
+                      set_cookie_suffix_);
 }
 
 std::string OidcFilter::GetCookieName(const std::string &cookie) const {
@@ -83,16 +149,20 @@ std::string OidcFilter::GetCookieName(const std::string &cookie) const {
          cookie + "-cookie";
 }
 
-std::string OidcFilter::GetStateCookieName() const {
-  return GetCookieName("state");
+const std::string &OidcFilter::GetStateCookieName() const {
+  return state_cookie_name_;
+}
+
+const std::string &OidcFilter::GetIdTokenCookieName() const {
+  return id_token_cookie_name_;
 }
 
-std::string OidcFilter::GetIdTokenCookieName() const {
-  return GetCookieName("id-token");
+const std::string &OidcFilter::GetAccessTokenCookieName() const {
+  return access_token_cookie_name_;
 }
 
-std::string OidcFilter::GetAccessTokenCookieName() const {
-  return GetCookieName("access-token");
+const std::string &OidcFilter::GetSessionCookieName() const {
+  return session_cookie_name_;
 }
 
 std::string OidcFilter::EncodeHeaderValue(const std::string &preamble,
@@ -107,68 +177,100 @@ void OidcFilter::SetStateCookie(
     ::google::protobuf::RepeatedPtrField<
         ::envoy::api::v2::core::HeaderValueOption> *headers,
     absl::string_view value, int64_t timeout) {
-  auto timeout_directive = EncodeCookieTimeoutDirective(timeout);
-  std::set<absl::string_view> token_set_cookie_header_directives =
-      {common::http::headers::SetCookieDirectives::HttpOnly,
-       common::http::headers::SetCookieDirectives::SameSiteLax,
-       common::http::headers::SetCookieDirectives::Secure, "Path=/",
-       timeout_directive};
-  auto state_cookie_header = common::http::http::EncodeSetCookie(
-      GetStateCookieName(), value, token_set_cookie_header_directives);
-  SetHeader(headers, common::http::headers::SetCookie, state_cookie_header);
+  SetHeader(headers, common::http::headers::SetCookie,
+            EncodeSetCookie(GetStateCookieName(), value, timeout));
 }
 
-absl::optional<std::string> OidcFilter::CookieFromHeaders(
-    const ::google::protobuf::Map<::std::string, ::std::string> &headers,
-    const std::string &cookie) {
-  const auto &cookie_header_value = headers.find(common::http::headers::Cookie);
-  if (cookie_header_value == headers.cend()) {
-    return absl::nullopt;
+bool OidcFilter::SetTokenCookie(
+    ::google::protobuf::RepeatedPtrField<
+        ::envoy::api::v2::core::HeaderValueOption> *headers,
+    absl::string_view name, absl::string_view value, int64_t timeout) {
+  auto max_size = max_cookie_size_ - set_cookie_prefix_.size() -
+                  max_timeout_digits_ - set_cookie_suffix_.size();
+  auto chunks = common::http::http::EncodeCookieChunks(name, value, max_size);
+  if (chunks.empty()) {
+    return false;
   }
-  auto cookies = common::http::http::DecodeCookies(cookie_header_value->second);
-  if (!cookies.has_value()) {
-    return absl::nullopt;
+  if (chunks.size() > 1) {
+    // A whole cookie left by an earlier login would take precedence over the
+    // chunks.
+    SetHeader(headers, common::http::headers::SetCookie,
+              EncodeSetCookie(name, "deleted", 0));
+  }
+  for (const auto &chunk : chunks) {
+    SetHeader(headers, common::http::headers::SetCookie,
+              EncodeSetCookie(chunk.first, chunk.second, timeout));
+  }
+  return true;
+}
+
+absl::optional<std::string> OidcFilter::DecryptToken(absl::string_view cookie) {
+  if (token_cache_) {
+    auto cached = token_cache_->Get(cookie);
+    if (cached.has_value()) {
+      return cached;
+    }
+  }
+  auto token = cryptor_->Decrypt(std::string(cookie));
+  if (!token.has_value()) {
+    return token;
+  }
+  absl::optional<int64_t> expiry;
+  token = common::session::ExpandToken(*token, expiry);
+  if (!token.has_value()) {
+    return token;
+  }
+  auto cache_expiry = std::chrono::system_clock::now() + token_cache_ttl_;
+  if (expiry.has_value()) {
+    // Token cookies are stored with the time they are refused from, and are
+    // only cached until then.
+    if (common::utilities::CoarseUnixSeconds() >= *expiry) {
+      spdlog::info("{}: token expired", __func__);
+      return absl::nullopt;
+    }
+    cache_expiry = std::min(cache_expiry,
+                            std::chrono::system_clock::from_time_t(*expiry));
   }
-  const auto &iter = cookies->find(cookie);
-  if (iter != cookies->cend()) {
-    return iter->second;
+  if (token_cache_) {
+    token_cache_->Put(cookie, *token, cache_expiry);
   }
-  return absl::nullopt;
+  return token;
+}
+
+int64_t OidcFilter::RefusedFrom(int64_t expiry) const {
+  auto skew = static_cast<int64_t>(idp_config_.expiry_skew());
+  if (skew == 0) {
+    return expiry;
+  }
+  auto now = common::utilities::CoarseUnixSeconds();
+  if (expiry - skew <= now) {
+    spdlog::warn(
+        "{}: expiry_skew of {}s is not shorter than the token's remaining "
+        "lifetime of {}s, ignoring it",
+        __func__, skew, expiry - now);
+    return expiry;
+  }
+  return expiry - skew;
 }
 
 google::rpc::Code OidcFilter::RedirectToIdP(
     ::envoy::service::auth::v2::CheckResponse *response) {
-  common::utilities::RandomGenerator generator;
-  auto state = generator.Generate(32).Str();
-  auto nonce = generator.Generate(32).Str();
-  std::set<absl::string_view> scopes = {mandatory_scope_};
-  for (const auto &scope : idp_config_.scopes()) {
-    scopes.insert(scope);
+  absl::optional<LoginState> login;
+  if (login_state_pool_) {
+    login = login_state_pool_->Pop();
+  }
+  if (!login.has_value()) {
+    login = LoginState::Generate(*cryptor_);
   }
-
-  auto callback = common::http::http::ToUrl(idp_config_.callback());
-  auto encoded_scopes = absl::StrJoin(scopes, " ");
-  std::multimap<absl::string_view, absl::string_view> params = {
-      {"response_type", "code"},
-      {"scope", encoded_scopes},
-      {"client_id", idp_config_.client_id()},
-      {"nonce", nonce},
-      {"state", state},
-      {"redirect_uri", callback}};
-  auto query = common::http::http::EncodeQueryData(params);
 
   // Set redirect
-  SetRedirectHeaders(
-      absl::StrJoin(
-          {common::http::http::ToUrl(idp_config_.authorization()), query}, "?"),
-      response);
+  SetRedirectHeaders(absl::StrCat(authorization_prefix_, login->nonce,
+                                  authorization_infix_, login->state),
+                     response);
 
-  // Create a secure state cookie that contains the state and nonce.
-  StateCookieCodec codec;
-  auto state_token = codec.Encode(state, nonce);
-  auto encrypted_state_token = cryptor_->Encrypt(state_token);
+  // Set a secure state cookie that contains the state and nonce.
   SetStateCookie(response->mutable_denied_response()->mutable_headers(),
-                 encrypted_state_token, idp_config_.timeout());
+                 login->cookie, idp_config_.timeout());
   return google::rpc::Code::UNAUTHENTICATED;
 }
 
@@ -176,12 +278,68 @@ google::rpc::Code OidcFilter::Process(
     const ::envoy::service::auth::v2::CheckRequest *request,
     ::envoy::service::auth::v2::CheckResponse *response) {
   spdlog::trace("{}", __func__);
+  absl::optional<TokenRequest> token_request;
+  auto result = Prepare(request, response, token_request);
+  if (!token_request.has_value()) {
+    return result;
+  }
+  auto token_response =
+      http_ptr_->Post(idp_config_.token(), TokenRequestHeaders(*token_request),
+                      token_request->body);
+  return HandleTokenResponse(*token_request, std::move(token_response),
+                             response);
+}
+
+void OidcFilter::ProcessAsync(
+    const ::envoy::service::auth::v2::CheckRequest *request,
+    ::envoy::service::auth::v2::CheckResponse *response,
+    ProcessCallback callback) {
+  spdlog::trace("{}", __func__);
+  absl::optional<TokenRequest> token_request;
+  auto result = Prepare(request, response, token_request);
+  if (!token_request.has_value()) {
+    callback(result);
+    return;
+  }
+  auto shared_request =
+      std::make_shared<TokenRequest>(std::move(*token_request));
+  http_ptr_->PostAsync(
+      idp_config_.token(), TokenRequestHeaders(*shared_request),
+      shared_request->body, token_request_timeout_,
+      [this, shared_request, response,
+       callback](common::http::response_t token_response) {
+        google::rpc::Code result;
+        try {
+          result = HandleTokenResponse(
+              *shared_request, std::move(token_response), response);
+        } catch (const std::exception &exception) {
+          spdlog::error("{}: unexpected error: {}", __func__, exception.what());
+          result = google::rpc::Code::INTERNAL;
+        }
+        callback(result);
+      });
+}
+
+std::map<absl::string_view, absl::string_view> OidcFilter::TokenRequestHeaders(
+    const TokenRequest &token_request) {
+  return {
+      {common::http::headers::ContentType,
+       common::http::headers::ContentTypeDirectives::FormUrlEncoded},
+      {common::http::headers::Authorization, token_request.authorization},
+  };
+}
+
+google::rpc::Code OidcFilter::Prepare(
+    const ::envoy::service::auth::v2::CheckRequest *request,
+    ::envoy::service::auth::v2::CheckResponse *response,
+    absl::optional<TokenRequest> &token_request) {
   spdlog::debug(
       "Call from {}@{} to {}@{}", request->attributes().source().principal(),
       request->attributes().source().address().socket_address().address(),
       request->attributes().destination().principal(),
       request->attributes().destination().address().socket_address().address());
-  if (!request->attributes().request().has_http()) {
+  RequestView view(*request);
+  if (!view.HasHttp()) {
     spdlog::info("{}: missing http in request", __func__);
     SetStandardResponseHeaders(response);
     ::grpc::Status err(::grpc::StatusCode::INVALID_ARGUMENT,
@@ -203,16 +361,44 @@ google::rpc::Code OidcFilter::Process(
   // Check if an id_token header already exists. If so let request
   // progress. It is up to the downstream system to validate the header is
   // valid.
-  auto headers = request->attributes().request().http().headers();
-  if (headers.contains(idp_config_.id_token().header())) {
+  if (view.Header(idp_config_.id_token().header()).has_value()) {
     return google::rpc::Code::OK;
   }
 
   // Check if we have a valid id_token cookie and optionally an access token
-  // cookie, If not go through authentication redirection dance.
-  auto id_token_cookie = CookieFromHeaders(headers, GetIdTokenCookieName());
+  // cookie, If not go through authentication redirection dance. Token
+  // cookies too large for browsers to store whole are split into chunks.
+  const absl::string_view cookie_names[] = {GetIdTokenCookieName(),
+                                            GetAccessTokenCookieName(),
+                                            GetSessionCookieName()};
+  absl::optional<absl::string_view> cookies[3];
+  std::string reassembled[3];
+  view.ChunkedCookies(cookie_names, absl::MakeSpan(cookies),
+                      absl::MakeSpan(reassembled));
+  const auto &session_cookie = cookies[2];
+  if (session_store_ && session_cookie.has_value()) {
+    auto session = session_store_->Get(*session_cookie);
+    if (session.has_value() && (!idp_config_.has_access_token() ||
+                                session->access_token.has_value())) {
+      // We have a valid session. Append its tokens to headers and let
+      // processing continue.
+      SetHeader(response->mutable_ok_response()->mutable_headers(),
+                idp_config_.id_token().header(),
+                EncodeHeaderValue(idp_config_.id_token().preamble(),
+                                  session->id_token));
+      if (idp_config_.has_access_token()) {
+        SetHeader(response->mutable_ok_response()->mutable_headers(),
+                  idp_config_.access_token().header(),
+                  EncodeHeaderValue(idp_config_.access_token().preamble(),
+                                    *session->access_token));
+      }
+      return google::rpc::Code::OK;
+    }
+    spdlog::info("{}: unknown or expired session", __func__);
+  }
+  const auto &id_token_cookie = cookies[0];
   if (id_token_cookie.has_value()) {
-    auto id_token = cryptor_->Decrypt(*id_token_cookie);
+    auto id_token = DecryptToken(*id_token_cookie);
     if (id_token.has_value()) {
       auto value = EncodeHeaderValue(idp_config_.id_token().preamble(),
                                      id_token.value());
@@ -221,10 +407,9 @@ google::rpc::Code OidcFilter::Process(
                 idp_config_.id_token().header(), value);
       // If it exists, extract the access token cookie and forward
       if (idp_config_.has_access_token()) {
-        auto access_token_cookie =
-            CookieFromHeaders(headers, GetAccessTokenCookieName());
+        const auto &access_token_cookie = cookies[1];
         if (access_token_cookie.has_value()) {
-          auto access_token = cryptor_->Decrypt(*access_token_cookie);
+          auto access_token = DecryptToken(*access_token_cookie);
           if (access_token.has_value()) {
             auto value = EncodeHeaderValue(
                 idp_config_.access_token().preamble(), access_token.value());
@@ -258,16 +443,16 @@ google::rpc::Code OidcFilter::Process(
       request->attributes().request().http().path());
   if (request->attributes().request().http().host() == callback_host &&
       path_parts[0] == idp_config_.callback().path()) {
-    return RetrieveToken(request, response, path_parts[1]);
+    return PrepareTokenRequest(request, response, path_parts[1],
+                               token_request);
   }
   return RedirectToIdP(response);
 }
 
-// Performs an HTTP POST and prints the response
-google::rpc::Code OidcFilter::RetrieveToken(
+google::rpc::Code OidcFilter::PrepareTokenRequest(
     const ::envoy::service::auth::v2::CheckRequest *request,
     ::envoy::service::auth::v2::CheckResponse *response,
-    absl::string_view query) {
+    absl::string_view query, absl::optional<TokenRequest> &token_request) {
   spdlog::trace("{}", __func__);
 
   // Best effort at deleting state cookie for all cases.
@@ -275,15 +460,16 @@ google::rpc::Code OidcFilter::RetrieveToken(
                  "deleted", 0);
 
   // Extract state and nonce from encrypted cookie.
-  auto encrypted_state_cookie = CookieFromHeaders(
-      request->attributes().request().http().headers(), GetStateCookieName());
+  auto encrypted_state_cookie =
+      RequestView(*request).Cookie(GetStateCookieName());
   if (!encrypted_state_cookie.has_value()) {
     spdlog::info("{}: missing state cookie", __func__);
     ::grpc::Status error(::grpc::StatusCode::INVALID_ARGUMENT,
                          "OIDC protocol error");
     return google::rpc::Code::INVALID_ARGUMENT;
   }
-  auto state_cookie = cryptor_->Decrypt(encrypted_state_cookie.value());
+  auto state_cookie =
+      cryptor_->Decrypt(std::string(encrypted_state_cookie.value()));
   if (!state_cookie.has_value()) {
     spdlog::info("{}: invalid state cookie", __func__);
     ::grpc::Status error(::grpc::StatusCode::INVALID_ARGUMENT,
@@ -300,16 +486,24 @@ google::rpc::Code OidcFilter::RetrieveToken(
   }
 
   // Extract expected state and authorization code from request
-  auto query_data = common::http::http::DecodeQueryData(query);
+  std::string scratch;
+  auto query_data = common::http::http::ParseQueryData(query, &scratch);
   if (!query_data.has_value()) {
     spdlog::info("{}: form data is invalid", __func__);
     ::grpc::Status error(::grpc::StatusCode::INVALID_ARGUMENT,
                          "OIDC protocol error");
     return google::rpc::Code::INVALID_ARGUMENT;
   }
-  const auto state = query_data->find("state");
-  const auto code = query_data->find("code");
-  if (state == query_data->end() || code == query_data->end()) {
+  absl::optional<absl::string_view> state;
+  absl::optional<absl::string_view> code;
+  for (const auto &parameter : *query_data) {
+    if (!state.has_value() && parameter.first == "state") {
+      state = parameter.second;
+    } else if (!code.has_value() && parameter.first == "code") {
+      code = parameter.second;
+    }
+  }
+  if (!state.has_value() || !code.has_value()) {
     spdlog::info(
         "{}: form data does not contain expected state and code parameters",
         __func__);
@@ -317,32 +511,28 @@ google::rpc::Code OidcFilter::RetrieveToken(
                          "OIDC protocol error");
     return google::rpc::Code::INVALID_ARGUMENT;
   }
-  if (state->second != state_and_nonce->first) {
+  if (*state != state_and_nonce->first) {
     spdlog::info("{}: mismatch state", __func__);
     ::grpc::Status error(::grpc::StatusCode::INVALID_ARGUMENT,
                          "OIDC protocol error");
     return google::rpc::Code::INVALID_ARGUMENT;
   }
 
-  // Build headers
-  auto authorization = common::http::http::EncodeBasicAuth(
-      idp_config_.client_id(), idp_config_.client_secret());
-  std::map<absl::string_view, absl::string_view> headers = {
-      {common::http::headers::ContentType,
-       common::http::headers::ContentTypeDirectives::FormUrlEncoded},
-      {common::http::headers::Authorization, authorization},
-  };
-
   // Build body
-  auto redirect_uri = common::http::http::ToUrl(idp_config_.callback());
-  std::multimap<absl::string_view, absl::string_view> params = {
-      {"code", code->second},
-      {"redirect_uri", redirect_uri},
-      {"grant_type", "authorization_code"},
-  };
+  token_request = TokenRequest{
+      basic_auth_,
+      absl::StrCat(common::http::http::EncodeFormData({{"code", *code}}),
+                   token_request_suffix_),
+      std::string(state_and_nonce->second.data(),
+                  state_and_nonce->second.size())};
+  return google::rpc::Code::OK;
+}
 
-  auto retrieve_token_response = http_ptr_->Post(
-      idp_config_.token(), headers, common::http::http::EncodeFormData(params));
+google::rpc::Code OidcFilter::HandleTokenResponse(
+    const TokenRequest &token_request,
+    common::http::response_t retrieve_token_response,
+    ::envoy::service::auth::v2::CheckResponse *response) {
+  spdlog::trace("{}", __func__);
   if (retrieve_token_response == nullptr) {
     spdlog::info("{}: HTTP error encountered: {}", __func__,
                  "IdP connection error");
@@ -355,9 +545,8 @@ google::rpc::Code OidcFilter::RetrieveToken(
     ::grpc::Status error(::grpc::StatusCode::UNKNOWN, "IdP connection error");
     return google::rpc::Code::UNKNOWN;
   } else {
-    auto token = parser_->Parse(idp_config_.client_id(),
-        std::string(state_and_nonce->second.data(), state_and_nonce->second.size()),
-        retrieve_token_response->body());
+    auto token = parser_->Parse(idp_config_.client_id(), token_request.nonce,
+                                retrieve_token_response->body());
     if (!token.has_value()) {
       spdlog::info("{}: Invalid token response", __func__);
       ::grpc::Status error(::grpc::StatusCode::INVALID_ARGUMENT,
@@ -366,36 +555,71 @@ google::rpc::Code OidcFilter::RetrieveToken(
     }
     auto expiry = token->Expiry();
     auto timeout = expiry.has_value() ? *expiry : std::numeric_limits<int64_t>::max();
-    auto timeout_directive = EncodeCookieTimeoutDirective(timeout);
-    std::set<absl::string_view> token_set_cookie_header_directives = {
-        common::http::headers::SetCookieDirectives::HttpOnly,
-        common::http::headers::SetCookieDirectives::SameSiteLax,
-        common::http::headers::SetCookieDirectives::Secure, "Path=/",
-        timeout_directive};
     // Check whether access_token forwarding is configured and if it is we have
     // an access token in our token response.
+    absl::optional<std::string> access_token;
     if (idp_config_.has_access_token()) {
-      auto access_token = token->AccessToken();
+      access_token = token->AccessToken();
       if (!access_token.has_value()) {
         spdlog::info("{}: Missing expected access_token", __func__);
         ::grpc::Status error(::grpc::StatusCode::INVALID_ARGUMENT,
                              "Missing expected access_token");
         return google::rpc::Code::INVALID_ARGUMENT;
       }
-      auto cookie_value = cryptor_->Encrypt(*access_token);
-      auto token_set_cookie_header = common::http::http::EncodeSetCookie(
-          GetAccessTokenCookieName(), cookie_value,
-          token_set_cookie_header_directives);
-      SetHeader(response->mutable_denied_response()->mutable_headers(),
-                common::http::headers::SetCookie, token_set_cookie_header);
     }
     SetRedirectHeaders(idp_config_.landing_page(), response);
-    auto cookie_value = cryptor_->Encrypt(token->IDToken().jwt_);
-    auto token_set_cookie_header = common::http::http::EncodeSetCookie(
-        GetIdTokenCookieName(), cookie_value,
-        token_set_cookie_header_directives);
-    SetHeader(response->mutable_denied_response()->mutable_headers(),
-              common::http::headers::SetCookie, token_set_cookie_header);
+
+    if (session_store_) {
+      // Keep the tokens server side and give the browser the session id.
+      auto now = std::chrono::system_clock::now();
+      auto session_expiry =
+          expiry.has_value()
+              ? std::chrono::system_clock::from_time_t(RefusedFrom(*expiry))
+              : now + default_session_ttl_;
+      auto session_id = session_store_->Put(
+          common::session::Session{token->IDToken().jwt_, access_token},
+          session_expiry);
+      auto session_timeout = std::chrono::duration_cast<std::chrono::seconds>(
+                                 session_expiry - now)
+                                 .count();
+      SetHeader(response->mutable_denied_response()->mutable_headers(),
+                common::http::headers::SetCookie,
+                EncodeSetCookie(GetSessionCookieName(), session_id,
+                                std::max<int64_t>(session_timeout, 0)));
+      return google::rpc::Code::UNAUTHENTICATED;
+    }
+
+    auto headers = response->mutable_denied_response()->mutable_headers();
+    // Token cookies are sent with every request, so they hold tokens packed
+    // as compactly as they can be while still rebuilding the tokens the IdP
+    // signed. Each is stored with the time it is refused from, which
+    // DecryptToken checks without parsing the token.
+    if (access_token.has_value()) {
+      absl::optional<int64_t> refused;
+      if (expiry.has_value()) {
+        refused = RefusedFrom(*expiry);
+      }
+      if (!SetTokenCookie(headers, GetAccessTokenCookieName(),
+                          cryptor_->Encrypt(common::session::CompactToken(
+                              *access_token, refused)),
+                          timeout)) {
+        spdlog::error("{}: access_token is too large to store in cookies",
+                      __func__);
+        return google::rpc::Code::INTERNAL;
+      }
+    }
+    absl::optional<int64_t> id_token_refused;
+    if (token->IDToken().exp_ != 0) {
+      id_token_refused =
+          RefusedFrom(static_cast<int64_t>(token->IDToken().exp_));
+    }
+    if (!SetTokenCookie(headers, GetIdTokenCookieName(),
+                        cryptor_->Encrypt(common::session::CompactToken(
+                            token->IDToken().jwt_, id_token_refused)),
+                        timeout)) {
+      spdlog::error("{}: id_token is too large to store in cookies", __func__);
+      return google::rpc::Code::INTERNAL;
+    }
     return google::rpc::Code::UNAUTHENTICATED;
   }
 }
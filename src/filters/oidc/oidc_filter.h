@@ -3,8 +3,11 @@
 #include "config/oidc/config.pb.h"
 #include "external/com_google_googleapis/google/rpc/code.pb.h"
 #include "src/common/http/http.h"
+#include "src/common/session/session_store.h"
+#include "src/common/session/token_cache.h"
 #include "src/common/session/token_encryptor.h"
 #include "src/filters/filter.h"
+#include "src/filters/oidc/login_state_pool.h"
 #include "src/filters/oidc/token_response.h"
 
 namespace authservice {
@@ -20,10 +23,34 @@ namespace oidc {
  */
 class OidcFilter final : public filters::Filter {
  private:
+  /** @brief A request to the IdP's token endpoint. */
+  struct TokenRequest {
+    std::string authorization;
+    std::string body;
+    std::string nonce;
+  };
+
   common::http::ptr_t http_ptr_;
   const authservice::config::oidc::OIDCConfig idp_config_;
   TokenResponseParserPtr parser_;
   common::session::TokenEncryptorPtr cryptor_;
+  common::session::TokenCachePtr token_cache_;
+  LoginStatePoolPtr login_state_pool_;
+  // Set when tokens are kept server side rather than in cookies.
+  common::session::SessionStorePtr session_store_;
+  // Cookie names are fixed by the configuration, so are built once.
+  const std::string state_cookie_name_;
+  const std::string id_token_cookie_name_;
+  const std::string access_token_cookie_name_;
+  const std::string session_cookie_name_;
+  // As are the constant parts of responses and token requests, between
+  // which per request values are spliced.
+  std::string authorization_prefix_;
+  std::string authorization_infix_;
+  std::string set_cookie_prefix_;
+  std::string set_cookie_suffix_;
+  std::string basic_auth_;
+  std::string token_request_suffix_;
 
   /**
    * Set HTTP header helper in a response.
@@ -52,12 +79,15 @@ class OidcFilter final : public filters::Filter {
       absl::string_view redirect_url,
       ::envoy::service::auth::v2::CheckResponse *response);
 
-  /** @brief Encode the given timeout as a cookie Max-Age directive.
+  /** @brief Encode a Set-Cookie header value for one of our cookies.
    *
-   * @param timeout the time out in seconds.
-   * @return the encoded cookie directive.
+   * @param name the name of the cookie.
+   * @param value the value of the cookie.
+   * @param timeout the number of seconds the cookie is valid for.
+   * @return the encoded Set-Cookie value.
    */
-  static std::string EncodeCookieTimeoutDirective(int64_t timeout);
+  std::string EncodeSetCookie(absl::string_view name, absl::string_view value,
+                              int64_t timeout) const;
 
   /** @brief Set state cookie.
    *
@@ -70,15 +100,39 @@ class OidcFilter final : public filters::Filter {
           ::envoy::api::v2::core::HeaderValueOption> *headers,
       absl::string_view value, int64_t timeout);
 
-  /** @brief Extract the requested cookie from the given headers
+  /** @brief Set a token cookie, split into chunks if it is too large for
+   * browsers to store whole.
+   *
+   * @param headers The headers to add to.
+   * @param name The name of the cookie.
+   * @param value The encrypted token.
+   * @param timeout The number of seconds the cookie is valid for.
+   * @return false if the token is too large to store even in chunks.
+   */
+  bool SetTokenCookie(
+      ::google::protobuf::RepeatedPtrField<
+          ::envoy::api::v2::core::HeaderValueOption> *headers,
+      absl::string_view name, absl::string_view value, int64_t timeout);
+
+  /** @brief Decrypt and expand a token cookie, consulting the token cache if
+   * any.
    *
-   * @param headers the headers to extract the cookies from
-   * @param cookie the name of the cookie to extract
-   * @return the extracted cookie value
+   * @param cookie the encrypted cookie value
+   * @return the decrypted token, or absl::nullopt if decryption failed or the
+   * token has expired.
    */
-  static absl::optional<std::string> CookieFromHeaders(
-      const ::google::protobuf::Map<::std::string, ::std::string> &headers,
-      const std::string &cookie);
+  absl::optional<std::string> DecryptToken(absl::string_view cookie);
+
+  /** @brief The time from which a token is refused, expiry_skew seconds
+   * before it expires.
+   *
+   * A skew at least as long as the token's remaining lifetime would send the
+   * user straight back to the IdP, so it is then ignored.
+   *
+   * @param expiry when the token expires, in unix seconds.
+   * @return when to refuse the token from, in unix seconds.
+   */
+  int64_t RefusedFrom(int64_t expiry) const;
 
   /** @brief Set IdP redirect parameters
    *
@@ -90,17 +144,51 @@ class OidcFilter final : public filters::Filter {
    */
   google::rpc::Code RedirectToIdP(
       ::envoy::service::auth::v2::CheckResponse *response);
-  /** @brief Retrieve tokens from OIDC token endpoint
+  /** @brief Process a request up to the point that tokens must be retrieved.
+   *
+   * @param request the incoming request
+   * @param response the outgoing response
+   * @param token_request set if tokens must be retrieved from the IdP before
+   * processing can complete.
+   * @return the call status, if processing has completed.
+   */
+  google::rpc::Code Prepare(
+      const ::envoy::service::auth::v2::CheckRequest *request,
+      ::envoy::service::auth::v2::CheckResponse *response,
+      absl::optional<TokenRequest> &token_request);
+
+  /** @brief Build a request for tokens from the OIDC token endpoint
    *
    * @param request the incoming request
    * @param response the outgoing response
    * @param query the request query string
+   * @param token_request set to the token request on success.
    * @return the call status
    */
-  google::rpc::Code RetrieveToken(
+  google::rpc::Code PrepareTokenRequest(
       const ::envoy::service::auth::v2::CheckRequest *request,
       ::envoy::service::auth::v2::CheckResponse *response,
-      absl::string_view query);
+      absl::string_view query, absl::optional<TokenRequest> &token_request);
+
+  /** @brief The HTTP headers for a token request.
+   *
+   * @param token_request the token request, which must outlive the headers.
+   * @return the headers.
+   */
+  static std::map<absl::string_view, absl::string_view> TokenRequestHeaders(
+      const TokenRequest &token_request);
+
+  /** @brief Handle the response from the OIDC token endpoint
+   *
+   * @param token_request the token request that was sent
+   * @param token_response the token endpoint's response
+   * @param response the outgoing response
+   * @return the call status
+   */
+  google::rpc::Code HandleTokenResponse(
+      const TokenRequest &token_request,
+      common::http::response_t token_response,
+      ::envoy::service::auth::v2::CheckResponse *response);
 
   /** @brief Get a cookie name. */
   std::string GetCookieName(const std::string &cookie) const;
@@ -113,21 +201,30 @@ class OidcFilter final : public filters::Filter {
   OidcFilter(common::http::ptr_t http_ptr,
              const authservice::config::oidc::OIDCConfig &idp_config,
              TokenResponseParserPtr parser,
-             common::session::TokenEncryptorPtr cryptor);
+             common::session::TokenEncryptorPtr cryptor,
+             common::session::TokenCachePtr token_cache = nullptr,
+             LoginStatePoolPtr login_state_pool = nullptr,
+             common::session::SessionStorePtr session_store = nullptr);
 
   google::rpc::Code Process(
       const ::envoy::service::auth::v2::CheckRequest *request,
       ::envoy::service::auth::v2::CheckResponse *response) override;
+  void ProcessAsync(const ::envoy::service::auth::v2::CheckRequest *request,
+                    ::envoy::service::auth::v2::CheckResponse *response,
+                    ProcessCallback callback) override;
   absl::string_view Name() const override;
 
   /** @brief Get state cookie name. */
-  std::string GetStateCookieName() const;
+  const std::string &GetStateCookieName() const;
 
   /** @brief Get id token cookie name. */
-  std::string GetIdTokenCookieName() const;
+  const std::string &GetIdTokenCookieName() const;
 
   /** @brief Get access token cookie name. */
-  std::string GetAccessTokenCookieName() const;
+  const std::string &GetAccessTokenCookieName() const;
+
+  /** @brief Get session cookie name. */
+  const std::string &GetSessionCookieName() const;
 };
 
 }  // namespace oidc
@@ -49,7 +49,10 @@ absl::optional<int64_t> TokenResponse::Expiry() const {
 
 TokenResponseParserImpl::TokenResponseParserImpl(
     google::jwt_verify::JwksPtr keys)
-    : keys_(std::move(keys)) {}
+    : keys_(std::make_shared<StaticJwksProvider>(std::move(keys))) {}
+
+TokenResponseParserImpl::TokenResponseParserImpl(JwksProviderPtr keys)
+    : keys_(keys) {}
 
 absl::optional<TokenResponse> TokenResponseParserImpl::Parse(
     const std::string &client_id, const std::string &nonce, const std::string &raw) const {
@@ -95,9 +98,25 @@ absl::optional<TokenResponse> TokenResponseParserImpl::Parse(
                  google::jwt_verify::getStatusString(jwt_status));
     return absl::nullopt;
   }
+  auto keys = keys_->Get();
+  if (keys == nullptr) {
+    spdlog::info("{}: no key set is available to verify `id_token`",
+                 __func__);
+    return absl::nullopt;
+  }
   // Verify our client_id is set as an entry in the token's `aud` field.
   std::vector<std::string> audiences = {client_id};
-  jwt_status = google::jwt_verify::verifyJwt(id_token, *keys_, audiences);
+  jwt_status = google::jwt_verify::verifyJwt(id_token, *keys, audiences);
+  if (jwt_status == google::jwt_verify::Status::JwksKidAlgMismatch) {
+    // The IdP may have rotated its keys since we last fetched them. The
+    // refresh happens in the background, so unless a newer key set has
+    // already arrived this login fails and a later one succeeds.
+    auto refreshed = keys_->Refresh(id_token.kid_);
+    if (refreshed != nullptr && refreshed != keys) {
+      keys = refreshed;
+      jwt_status = google::jwt_verify::verifyJwt(id_token, *keys, audiences);
+    }
+  }
   if (jwt_status != google::jwt_verify::Status::Ok) {
     spdlog::info("{}: `id_token` verification failed: {}", __func__, google::jwt_verify::getStatusString(jwt_status));
     return absl::nullopt;
@@ -5,6 +5,7 @@
 #include "absl/strings/string_view.h"
 #include "jwt_verify_lib/jwks.h"
 #include "jwt_verify_lib/jwt.h"
+#include "src/filters/oidc/jwks_provider.h"
 
 namespace authservice {
 namespace filters {
@@ -58,10 +59,11 @@ class TokenResponseParser {
  */
 class TokenResponseParserImpl final : public TokenResponseParser {
  private:
-  google::jwt_verify::JwksPtr keys_;
+  JwksProviderPtr keys_;
 
  public:
   TokenResponseParserImpl(google::jwt_verify::JwksPtr keys);
+  TokenResponseParserImpl(JwksProviderPtr keys);
   absl::optional<TokenResponse> Parse(const std::string &client_id,
                                       const std::string &nonce,
                                       const std::string &raw) const override;
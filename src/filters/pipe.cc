@@ -1,4 +1,5 @@
 #include "pipe.h"
+#include <algorithm>
 #include "google/rpc/code.pb.h"
 #include "grpcpp/support/status.h"
 
@@ -8,27 +9,35 @@ namespace {
 const char *filter_name_ = "pipe";
 }  // namespace
 
+Pipe::Pipe() : filters_(std::make_shared<const FilterList>()) {}
+
 Pipe *Pipe::AddFilter(FilterPtr &&filter) {
   std::unique_lock<std::mutex> lock(mtx);
-  filters_.push_back(std::move(filter));
+  auto updated = std::make_shared<FilterList>(*std::atomic_load(&filters_));
+  updated->push_back(std::move(filter));
+  std::atomic_store(&filters_, FilterListPtr(std::move(updated)));
   return this;
 }
 
 Pipe *Pipe::Remove(const std::string &filter) {
   std::unique_lock<std::mutex> lock(mtx);
-  for (auto f = filters_.begin(); f != filters_.end(); ++f) {
-    if ((*f)->Name() == filter) {
-      filters_.erase(f);
-    }
-  }
+  auto updated = std::make_shared<FilterList>(*std::atomic_load(&filters_));
+  updated->erase(std::remove_if(updated->begin(), updated->end(),
+                                [&filter](const std::shared_ptr<Filter> &f) {
+                                  return f->Name() == filter;
+                                }),
+                 updated->end());
+  std::atomic_store(&filters_, FilterListPtr(std::move(updated)));
   return this;
 }
 
 google::rpc::Code Pipe::Process(
     const ::envoy::service::auth::v2::CheckRequest *request,
     ::envoy::service::auth::v2::CheckResponse *response) {
-  std::unique_lock<std::mutex> lock(mtx);
-  for (auto &filter : filters_) {
+  // Hold a reference to the current snapshot for the duration of the request
+  // so that concurrent updates cannot free filters from underneath us.
+  auto filters = std::atomic_load(&filters_);
+  for (auto &filter : *filters) {
     auto result = filter->Process(request, response);
     if (result != google::rpc::Code::OK) {
       response->mutable_status()->set_code(result);
@@ -42,6 +51,40 @@ google::rpc::Code Pipe::Process(
   return google::rpc::Code::OK;
 }
 
+void Pipe::ProcessAsync(
+    const ::envoy::service::auth::v2::CheckRequest *request,
+    ::envoy::service::auth::v2::CheckResponse *response,
+    ProcessCallback callback) {
+  ProcessFrom(std::atomic_load(&filters_), 0, request, response,
+              std::move(callback));
+}
+
+void Pipe::ProcessFrom(FilterListPtr filters, size_t index,
+                       const ::envoy::service::auth::v2::CheckRequest *request,
+                       ::envoy::service::auth::v2::CheckResponse *response,
+                       ProcessCallback callback) {
+  if (index == filters->size()) {
+    response->mutable_status()->set_code(google::rpc::Code::OK);
+    response->mutable_status()->set_message("OK");
+    callback(google::rpc::Code::OK);
+    return;
+  }
+  // The callback holds the snapshot so that the filters outlive the request.
+  auto &filter = filters->at(index);
+  filter->ProcessAsync(
+      request, response,
+      [filters, index, request, response, callback](google::rpc::Code result) {
+        if (result != google::rpc::Code::OK) {
+          auto name = filters->at(index)->Name();
+          response->mutable_status()->set_code(result);
+          response->mutable_status()->set_message(name.data(), name.size());
+          callback(result);
+          return;
+        }
+        ProcessFrom(filters, index + 1, request, response, callback);
+      });
+}
+
 absl::string_view Pipe::Name() const { return filter_name_; }
 }  // namespace filters
 }  // namespace authservice
@@ -11,23 +11,48 @@ namespace filters {
 
 typedef std::unique_ptr<Filter> FilterPtr;
 
+/** @brief Pipe chains filters together, processing requests in order.
+ *
+ * Pipe publishes its filters as an immutable, reference counted snapshot.
+ * Process loads the current snapshot without taking a lock whilst AddFilter
+ * and Remove build a new snapshot and atomically swap it in. Requests that are
+ * in flight complete against the snapshot they started with.
+ */
 class Pipe final : public Filter {
  private:
-  typedef std::vector<FilterPtr> FilterList;
+  typedef std::vector<std::shared_ptr<Filter>> FilterList;
+  typedef std::shared_ptr<const FilterList> FilterListPtr;
+  // Serializes writers. Readers never take this lock.
   std::mutex mtx;
-  FilterList filters_;
+  // Only accessed through std::atomic_load/std::atomic_store.
+  FilterListPtr filters_;
+
+  /** @brief Asynchronously process a request from the given filter onwards.
+   *
+   * @param filters the snapshot the request started with.
+   * @param index the index of the next filter to run.
+   */
+  static void ProcessFrom(FilterListPtr filters, size_t index,
+                          const ::envoy::service::auth::v2::CheckRequest *request,
+                          ::envoy::service::auth::v2::CheckResponse *response,
+                          ProcessCallback callback);
 
  public:
+  Pipe();
+
   Pipe *AddFilter(FilterPtr &&filter);
   Pipe *Remove(const std::string &filter);
 
   google::rpc::Code Process(
       const ::envoy::service::auth::v2::CheckRequest *request,
       ::envoy::service::auth::v2::CheckResponse *response) override;
+  void ProcessAsync(const ::envoy::service::auth::v2::CheckRequest *request,
+                    ::envoy::service::auth::v2::CheckResponse *response,
+                    ProcessCallback callback) override;
   absl::string_view Name() const override;
 };
 
 }  // namespace filters
 }  // namespace authservice
 
-#endif  // AUTHSERVICE_SRC_FILTERS_PIPE_TEST_H_
+#endif  // AUTHSERVICE_SRC_FILTERS_PIPE_H_
@@ -0,0 +1,57 @@
+#include "src/filters/request_view.h"
+#include "src/common/http/headers.h"
+#include "src/common/http/http.h"
+
+namespace authservice {
+namespace filters {
+
+namespace {
+const std::string cookie_header_ = common::http::headers::Cookie;
+}  // namespace
+
+RequestView::RequestView(
+    const ::envoy::service::auth::v2::CheckRequest &request)
+    : request_(request), http_(request.attributes().request().http()) {}
+
+bool RequestView::HasHttp() const {
+  return request_.attributes().request().has_http();
+}
+
+absl::optional<absl::string_view> RequestView::Header(
+    const std::string &name) const {
+  const auto &headers = http_.headers();
+  auto found = headers.find(name);
+  if (found == headers.end()) {
+    return absl::nullopt;
+  }
+  return absl::string_view(found->second);
+}
+
+absl::optional<absl::string_view> RequestView::Cookie(
+    absl::string_view name) const {
+  absl::optional<absl::string_view> value;
+  Cookies(absl::MakeConstSpan(&name, 1), absl::MakeSpan(&value, 1));
+  return value;
+}
+
+void RequestView::Cookies(
+    absl::Span<const absl::string_view> names,
+    absl::Span<absl::optional<absl::string_view>> values) const {
+  auto header = Header(cookie_header_);
+  if (header.has_value()) {
+    common::http::http::FindCookies(*header, names, values);
+  }
+}
+
+void RequestView::ChunkedCookies(
+    absl::Span<const absl::string_view> names,
+    absl::Span<absl::optional<absl::string_view>> values,
+    absl::Span<std::string> scratch) const {
+  auto header = Header(cookie_header_);
+  if (header.has_value()) {
+    common::http::http::FindChunkedCookies(*header, names, values, scratch);
+  }
+}
+
+}  // namespace filters
+}  // namespace authservice
@@ -0,0 +1,68 @@
+#ifndef AUTHSERVICE_SRC_FILTERS_REQUEST_VIEW_H_
+#define AUTHSERVICE_SRC_FILTERS_REQUEST_VIEW_H_
+#include <string>
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "envoy/service/auth/v2/external_auth.grpc.pb.h"
+
+namespace authservice {
+namespace filters {
+
+/** @brief A non-owning view of the HTTP attributes of a check request.
+ *
+ * Headers and cookies are looked up in place and returned as views into the
+ * request, so a view must not outlive the request it was created from. No
+ * lookup allocates, other than to reassemble chunked cookies.
+ */
+class RequestView {
+ private:
+  const ::envoy::service::auth::v2::CheckRequest &request_;
+  const ::envoy::service::auth::v2::AttributeContext_HttpRequest &http_;
+
+ public:
+  explicit RequestView(const ::envoy::service::auth::v2::CheckRequest &request);
+
+  /** @brief Whether the request has HTTP attributes. */
+  bool HasHttp() const;
+
+  /** @brief Look up a header.
+   *
+   * @param name the lower case name of the header.
+   * @return the header value, or absl::nullopt if it is not present.
+   */
+  absl::optional<absl::string_view> Header(const std::string &name) const;
+
+  /** @brief Look up a cookie.
+   *
+   * @param name the name of the cookie.
+   * @return the cookie value, or absl::nullopt if it is not present.
+   */
+  absl::optional<absl::string_view> Cookie(absl::string_view name) const;
+
+  /** @brief Look up several cookies with a single scan of the Cookie header.
+   *
+   * @param names the names of the cookies.
+   * @param values set to the value of each cookie that is present, in the
+   * same order as names.
+   */
+  void Cookies(absl::Span<const absl::string_view> names,
+               absl::Span<absl::optional<absl::string_view>> values) const;
+
+  /** @brief Look up several cookies, any of which may have been split into
+   * chunks, with a single scan of the Cookie header.
+   *
+   * @param names the names of the cookies.
+   * @param values set to the value of each cookie that is present, in the
+   * same order as names.
+   * @param scratch storage for reassembled values, one per name.
+   */
+  void ChunkedCookies(absl::Span<const absl::string_view> names,
+                      absl::Span<absl::optional<absl::string_view>> values,
+                      absl::Span<std::string> scratch) const;
+};
+
+}  // namespace filters
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_FILTERS_REQUEST_VIEW_H_
@@ -1,7 +1,10 @@
 #include <grpcpp/grpcpp.h>
 #include <grpcpp/server_builder.h>
+#include <pthread.h>
 #include <cassert>
+#include <csignal>
 #include <cstdio>
+#include <thread>
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/flags/usage.h"
@@ -12,11 +15,9 @@
 #include "spdlog/common.h"
 #include "spdlog/sinks/stdout_sinks.h"
 #include "spdlog/spdlog.h"
+#include "src/common/metrics/metrics.h"
 #include "src/config/getconfig.h"
-#include "src/service/serviceimpl.h"
-
-using grpc::Server;
-using grpc::ServerBuilder;
+#include "src/service/async_service_impl.h"
 
 namespace authservice {
 namespace service {
@@ -47,25 +48,50 @@ spdlog::level::level_enum GetConfiguredLogLevel(
   return level;
 }
 
-std::string GetConfiguredAddress(
-    const std::shared_ptr<authservice::config::Config>& config) {
-  std::stringstream address_string_builder;
-
-  address_string_builder << config->listen_address() << ":" << std::dec
-                         << config->listen_port();
-  auto address = address_string_builder.str();
-  return address;
+// Handle administrative signals:
+//   SIGHUP:  reload the configuration file and swap in a new filter pipeline.
+//   SIGUSR1: log the current metrics.
+void HandleSignals(AsyncAuthServiceImpl* server, const std::string& path,
+                   sigset_t signals) {
+  while (true) {
+    int signal;
+    if (sigwait(&signals, &signal) != 0) {
+      spdlog::error("{}: sigwait failed", __func__);
+      return;
+    }
+    if (signal == SIGUSR1) {
+      spdlog::info("{}: metrics:\n{}", __func__,
+                   common::metrics::Registry::Instance().Dump());
+      continue;
+    }
+    spdlog::info("{}: reloading configuration from {}", __func__, path);
+    try {
+      // The new config is parsed and validated on this thread, away from
+      // request processing.
+      auto config = authservice::config::GetConfig(path);
+      server->Reload(config);
+      spdlog::default_logger()->set_level(GetConfiguredLogLevel(config));
+    } catch (const std::exception& e) {
+      spdlog::error("{}: reload failed, keeping previous configuration: {}",
+                    __func__, e.what());
+    }
+  }
 }
 
-void RunServer(const std::shared_ptr<authservice::config::Config>& config) {
-  auto address = GetConfiguredAddress(config);
-  AuthServiceImpl auth_service(config);
-  ServerBuilder builder;
-  builder.AddListeningPort(address, grpc::InsecureServerCredentials());
-  builder.RegisterService(&auth_service);
-  std::unique_ptr<Server> server(builder.BuildAndStart());
-  spdlog::info("{}: Server listening on {}", __func__, address);
-  server->Wait();
+void RunServer(const std::shared_ptr<authservice::config::Config>& config,
+               const std::string& path) {
+  // Block the administrative signals before any threads are started so that
+  // only the signal handling thread receives them.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGHUP);
+  sigaddset(&signals, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  AsyncAuthServiceImpl server(config);
+  server.Start();
+  std::thread(HandleSignals, &server, path, signals).detach();
+  server.Wait();
 }
 
 }  // namespace service
@@ -86,7 +112,8 @@ int main(int argc, char** argv) {
         authservice::config::GetConfig(absl::GetFlag(FLAGS_filter_config));
     console->set_level(
         authservice::service::GetConfiguredLogLevel(config));
-    authservice::service::RunServer(config);
+    authservice::service::RunServer(config,
+                                    absl::GetFlag(FLAGS_filter_config));
   } catch (const std::exception& e) {
     spdlog::error("{}: Unexpected error: {}", __func__, e.what());
     return EXIT_FAILURE;
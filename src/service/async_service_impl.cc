@@ -0,0 +1,165 @@
+#include "async_service_impl.h"
+#include <grpcpp/server_builder.h>
+#include <algorithm>
+#include <sstream>
+#include "spdlog/spdlog.h"
+
+namespace authservice {
+namespace service {
+namespace {
+
+/**
+ * CheckCall tracks the lifetime of a single Check call through the
+ * completion queue it was requested on.
+ */
+class CheckCall {
+ private:
+  enum class State { Requested, Finished };
+
+  Authorization::AsyncService *service_;
+  AuthServiceImpl *impl_;
+  ::grpc::ServerCompletionQueue *queue_;
+  ::grpc::ServerContext context_;
+  ::envoy::service::auth::v2::CheckRequest request_;
+  ::envoy::service::auth::v2::CheckResponse response_;
+  ::grpc::ServerAsyncResponseWriter<::envoy::service::auth::v2::CheckResponse>
+      responder_;
+  State state_;
+
+ public:
+  CheckCall(Authorization::AsyncService *service, AuthServiceImpl *impl,
+            ::grpc::ServerCompletionQueue *queue)
+      : service_(service),
+        impl_(impl),
+        queue_(queue),
+        responder_(&context_),
+        state_(State::Requested) {
+    service_->RequestCheck(&context_, &request_, &responder_, queue_, queue_,
+                           this);
+  }
+
+  void Proceed(bool ok) {
+    switch (state_) {
+      case State::Requested: {
+        if (!ok) {
+          // The server is shutting down.
+          delete this;
+          return;
+        }
+        // Make sure there is always a call waiting for the next request.
+        new CheckCall(service_, impl_, queue_);
+        // Filters may complete on another thread once their I/O is done, in
+        // which case this thread is free to poll for the next request.
+        state_ = State::Finished;
+        impl_->CheckAsync(&request_, &response_, [this](::grpc::Status status) {
+          responder_.Finish(response_, status, this);
+        });
+        break;
+      }
+      case State::Finished:
+        delete this;
+        break;
+    }
+  }
+};
+
+std::string GetConfiguredAddress(
+    const std::shared_ptr<authservice::config::Config> &config) {
+  std::stringstream address_string_builder;
+
+  address_string_builder << config->listen_address() << ":" << std::dec
+                         << config->listen_port();
+  auto address = address_string_builder.str();
+  return address;
+}
+
+}  // namespace
+
+AsyncAuthServiceImpl::AsyncAuthServiceImpl(
+    std::shared_ptr<authservice::config::Config> config)
+    : config_(config), impl_(config), port_(0), shutdown_(false) {}
+
+AsyncAuthServiceImpl::~AsyncAuthServiceImpl() {
+  Shutdown();
+  Wait();
+}
+
+void AsyncAuthServiceImpl::Start() {
+  auto address = GetConfiguredAddress(config_);
+  size_t queue_count = std::max(config_->completion_queues(), 1u);
+  size_t thread_count = config_->threads();
+  if (thread_count == 0) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  thread_count = std::max(thread_count, queue_count);
+
+  ::grpc::ServerBuilder builder;
+  builder.AddListeningPort(address, ::grpc::InsecureServerCredentials(),
+                           &port_);
+  builder.RegisterService(&service_);
+  for (size_t i = 0; i < queue_count; ++i) {
+    queues_.emplace_back(builder.AddCompletionQueue());
+  }
+  server_ = builder.BuildAndStart();
+  if (!server_) {
+    throw std::runtime_error("failed to start server on " + address);
+  }
+  spdlog::info("{}: Server listening on {} with {} completion queues and {} "
+               "threads",
+               __func__, address, queue_count, thread_count);
+
+  for (size_t i = 0; i < thread_count; ++i) {
+    auto queue = queues_[i % queue_count].get();
+    // One pending call per polling thread so that every thread can pick up a
+    // new request whilst the others are busy.
+    new CheckCall(&service_, &impl_, queue);
+    threads_.emplace_back(&AsyncAuthServiceImpl::Poll, this, queue);
+  }
+}
+
+void AsyncAuthServiceImpl::Poll(::grpc::ServerCompletionQueue *queue) {
+  void *tag;
+  bool ok;
+  while (queue->Next(&tag, &ok)) {
+    static_cast<CheckCall *>(tag)->Proceed(ok);
+  }
+}
+
+void AsyncAuthServiceImpl::Wait() {
+  for (auto &thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+void AsyncAuthServiceImpl::Shutdown() {
+  std::unique_lock<std::mutex> lock(mtx_);
+  if (!server_ || shutdown_) {
+    return;
+  }
+  shutdown_ = true;
+  server_->Shutdown();
+  // Queues must be shut down after the server.
+  for (auto &queue : queues_) {
+    queue->Shutdown();
+  }
+}
+
+void AsyncAuthServiceImpl::Reload(
+    std::shared_ptr<authservice::config::Config> config) {
+  if (config->listen_address() != config_->listen_address() ||
+      config->listen_port() != config_->listen_port() ||
+      config->completion_queues() != config_->completion_queues() ||
+      config->threads() != config_->threads()) {
+    spdlog::warn("{}: listener settings changed, a restart is required for "
+                 "them to take effect",
+                 __func__);
+  }
+  impl_.Reload(config);
+}
+
+int AsyncAuthServiceImpl::Port() const { return port_; }
+
+}  // namespace service
+}  // namespace authservice
@@ -0,0 +1,73 @@
+#ifndef AUTHSERVICE_SRC_SERVICE_ASYNC_SERVICE_IMPL_H_
+#define AUTHSERVICE_SRC_SERVICE_ASYNC_SERVICE_IMPL_H_
+#include <grpcpp/grpcpp.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "config/config.pb.h"
+#include "envoy/service/auth/v2/external_auth.grpc.pb.h"
+#include "src/service/serviceimpl.h"
+
+namespace authservice {
+namespace service {
+
+/** @brief An asynchronous gRPC server for the Authorization service.
+ *
+ * An asynchronous gRPC server for the Authorization service. Incoming Check
+ * calls are dispatched from a configurable number of completion queues to a
+ * configurable number of polling threads, rather than from gRPC's
+ * synchronous thread pool. Request processing is delegated to
+ * @refitem AuthServiceImpl. Polling threads do not wait whilst filters perform
+ * network I/O; calls are finished from the filters' completion callbacks.
+ */
+class AsyncAuthServiceImpl {
+ private:
+  std::shared_ptr<authservice::config::Config> config_;
+  AuthServiceImpl impl_;
+  Authorization::AsyncService service_;
+  std::vector<std::unique_ptr<::grpc::ServerCompletionQueue>> queues_;
+  std::unique_ptr<::grpc::Server> server_;
+  std::vector<std::thread> threads_;
+  int port_;
+  std::mutex mtx_;
+  bool shutdown_;
+
+  /** @brief Poll the given completion queue until it is shut down.
+   *
+   * @param queue the completion queue to poll.
+   */
+  void Poll(::grpc::ServerCompletionQueue *queue);
+
+ public:
+  AsyncAuthServiceImpl(std::shared_ptr<authservice::config::Config> config);
+  ~AsyncAuthServiceImpl();
+
+  /** @brief Start serving requests.
+   *
+   * Bind the configured address and start the polling threads. Returns once
+   * the server is accepting requests.
+   */
+  void Start();
+
+  /** @brief Block until all polling threads have completed. */
+  void Wait();
+
+  /** @brief Stop accepting requests and drain the completion queues. */
+  void Shutdown();
+
+  /** @brief Rebuild the filter pipeline from the given configuration.
+   *
+   * Listener settings are only read at start up and are not affected.
+   * @param config the new configuration.
+   */
+  void Reload(std::shared_ptr<authservice::config::Config> config);
+
+  /** @brief The port the server is bound to once started. */
+  int Port() const;
+};
+
+}  // namespace service
+}  // namespace authservice
+
+#endif  // AUTHSERVICE_SRC_SERVICE_ASYNC_SERVICE_IMPL_H_
@@ -1,36 +1,214 @@
 #include "serviceimpl.h"
 #include <grpcpp/grpcpp.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
 #include <memory>
+#include "google/protobuf/util/message_differencer.h"
 #include "spdlog/spdlog.h"
+#include "src/common/metrics/metrics.h"
+#include "src/common/session/in_memory_session_store.h"
+#include "src/common/session/redis_session_store.h"
 #include "src/config/getconfig.h"
+#include "src/filters/oidc/jwks_provider.h"
 #include "src/filters/oidc/oidc_filter.h"
 #include "src/filters/pipe.h"
 
 namespace authservice {
 namespace service {
 
-AuthServiceImpl::AuthServiceImpl(
-    std::shared_ptr<authservice::config::Config> config) {
-  root_.reset(new filters::Pipe);
-  for (const auto &filter : config->filters()) {
+namespace {
+const char *reloads_metric_ = "config_reloads_total";
+const char *reload_failures_metric_ = "config_reload_failures_total";
+const char *reload_duration_metric_ = "config_reload_duration_microseconds";
+const char *reload_filters_metric_ = "config_reload_filters";
+// The number of decrypted token cookies cached per filter.
+const size_t token_cache_capacity_ = 10000;
+// The number of login states generated ahead of time per filter.
+const size_t login_state_pool_capacity_ = 256;
+
+common::session::EncryptionAlg ToEncryptionAlg(
+    authservice::config::oidc::OIDCConfig::CookieEncryption encryption) {
+  switch (encryption) {
+    case authservice::config::oidc::OIDCConfig::AES_256_GCM:
+      return common::session::EncryptionAlg::AES256GCM;
+    case authservice::config::oidc::OIDCConfig::CHACHA20_POLY1305:
+      return common::session::EncryptionAlg::CHACHA20POLY1305;
+    default:
+      return common::session::PreferredEncryptionAlg();
+  }
+}
+
+common::session::SessionStorePtr CreateSessionStore(
+    const authservice::config::oidc::OIDCConfig &config,
+    common::session::TokenEncryptorPtr cryptor) {
+  if (!config.has_session_store()) {
+    return nullptr;
+  }
+  if (!config.session_store().has_redis()) {
+    return std::make_shared<common::session::InMemorySessionStore>();
+  }
+  const auto &redis = config.session_store().redis();
+  if (redis.hostname().empty()) {
+    throw std::runtime_error("redis session store requires a hostname");
+  }
+  if (redis.port() == 0 ||
+      redis.port() > std::numeric_limits<uint16_t>::max()) {
+    throw std::runtime_error("invalid redis session store port " +
+                             std::to_string(redis.port()));
+  }
+  common::session::RedisClient::Options client_options;
+  if (redis.connections() > 0) {
+    client_options.connections = redis.connections();
+  }
+  if (redis.timeout() > 0) {
+    client_options.timeout = std::chrono::milliseconds(redis.timeout());
+  }
+  common::session::RedisSessionStore::Options store_options;
+  if (!redis.key_prefix().empty()) {
+    store_options.key_prefix = redis.key_prefix();
+  }
+  return std::make_shared<common::session::RedisSessionStore>(
+      std::make_shared<common::session::RedisClient>(
+          redis.hostname(), static_cast<uint16_t>(redis.port()),
+          client_options),
+      cryptor, store_options);
+}
+
+// Whether a session store built for one filter config can serve another.
+// Redis session stores encrypt sessions with the filter's cryptor.
+bool SameSessionStore(const authservice::config::oidc::OIDCConfig &a,
+                      const authservice::config::oidc::OIDCConfig &b) {
+  if (!google::protobuf::util::MessageDifferencer::Equals(
+          a.session_store(), b.session_store())) {
+    return false;
+  }
+  return !a.session_store().has_redis() ||
+         (a.cryptor_secret() == b.cryptor_secret() &&
+          a.cookie_encryption() == b.cookie_encryption());
+}
+}  // namespace
+
+std::pair<std::shared_ptr<filters::Pipe>, size_t> AuthServiceImpl::BuildPipe(
+    const authservice::config::Config &config,
+    SessionStores *session_stores) {
+  auto root = std::make_shared<filters::Pipe>();
+  size_t count = 0;
+  // Session stores of the current pipeline not yet taken by a new filter.
+  auto unused = *session_stores;
+  SessionStores used;
+  for (const auto &filter : config.filters()) {
     // TODO: implement filter specific construction.
     if (!filter.has_oidc()) {
       throw std::runtime_error("unsupported filter type");
     }
+    auto http = common::http::ptr_t(new common::http::http_impl);
+
+    filters::oidc::JwksProviderPtr jwks;
+    if (filter.oidc().has_jwks_uri()) {
+      jwks = std::make_shared<filters::oidc::RemoteJwksProvider>(
+          http, filter.oidc().jwks_uri(), filter.oidc().jwks_snapshot_path());
+    } else {
+      jwks = std::make_shared<filters::oidc::StaticJwksProvider>(
+          google::jwt_verify::Jwks::createFrom(
+              filter.oidc().jwks(), google::jwt_verify::Jwks::Type::JWKS));
+    }
     auto token_request_parser =
-        std::make_shared<filters::oidc::TokenResponseParserImpl>(
-            google::jwt_verify::Jwks::createFrom(
-                filter.oidc().jwks(), google::jwt_verify::Jwks::Type::JWKS));
+        std::make_shared<filters::oidc::TokenResponseParserImpl>(jwks);
 
     auto token_encryptor = common::session::TokenEncryptor::Create(
         filter.oidc().cryptor_secret(),
-        common::session::EncryptionAlg::AES256GCM,
+        ToEncryptionAlg(filter.oidc().cookie_encryption()),
         common::session::HKDFHash::SHA512);
+    auto token_cache =
+        std::make_shared<common::session::TokenCache>(token_cache_capacity_);
 
-    auto http = common::http::ptr_t(new common::http::http_impl);
+    auto login_state_pool = std::make_shared<filters::oidc::LoginStatePool>(
+        token_encryptor, login_state_pool_capacity_);
+
+    common::session::SessionStorePtr session_store;
+    if (filter.oidc().has_session_store()) {
+      auto previous = std::find_if(
+          unused.begin(), unused.end(),
+          [&filter](const SessionStoreEntry &entry) {
+            return entry.store &&
+                   SameSessionStore(entry.config, filter.oidc());
+          });
+      if (previous != unused.end()) {
+        session_store = std::move(previous->store);
+      } else {
+        session_store = CreateSessionStore(filter.oidc(), token_encryptor);
+      }
+    }
+    used.push_back({filter.oidc(), session_store});
 
-    root_->AddFilter(filters::FilterPtr(new filters::oidc::OidcFilter(
-        http, filter.oidc(), token_request_parser, token_encryptor)));
+    root->AddFilter(filters::FilterPtr(new filters::oidc::OidcFilter(
+        http, filter.oidc(), token_request_parser, token_encryptor,
+        token_cache, login_state_pool, session_store)));
+    ++count;
+  }
+  session_stores->swap(used);
+  return std::make_pair(root, count);
+}
+
+AuthServiceImpl::AuthServiceImpl(
+    std::shared_ptr<authservice::config::Config> config) {
+  root_ = BuildPipe(*config, &session_stores_).first;
+}
+
+void AuthServiceImpl::Reload(
+    std::shared_ptr<authservice::config::Config> config) {
+  auto &metrics = common::metrics::Registry::Instance();
+  auto start = std::chrono::steady_clock::now();
+  std::pair<std::shared_ptr<filters::Pipe>, size_t> pipe;
+  try {
+    pipe = BuildPipe(*config, &session_stores_);
+  } catch (...) {
+    metrics.GetCounter(reload_failures_metric_).Increment();
+    throw;
+  }
+  std::atomic_store(&root_, pipe.first);
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  metrics.GetCounter(reloads_metric_).Increment();
+  metrics.GetGauge(reload_duration_metric_).Set(elapsed.count());
+  metrics.GetGauge(reload_filters_metric_).Set(pipe.second);
+  spdlog::info("{}: swapped in {} filters in {}us", __func__, pipe.second,
+               elapsed.count());
+}
+
+common::session::SessionStorePtr AuthServiceImpl::SessionStore(
+    size_t filter) const {
+  if (filter >= session_stores_.size()) {
+    return nullptr;
+  }
+  return session_stores_[filter].store;
+}
+
+::grpc::Status AuthServiceImpl::ToStatus(google::rpc::Code code) {
+  // See src/filters/filter.h:filter::Process for a description of how status
+  // codes should be handled
+  switch (code) {
+    case google::rpc::Code::OK:               // The request was successful
+    case google::rpc::Code::UNAUTHENTICATED:  // A filter indicated the
+                                              // request had no authentication
+                                              // but was processed correctly.
+    case google::rpc::Code::PERMISSION_DENIED:  // A filter indicated
+                                                // insufficient permissions
+                                                // for the authenticated
+                                                // requester but was processed
+                                                // correctly.
+      return ::grpc::Status::OK;
+    case google::rpc::Code::INVALID_ARGUMENT:  // The request was not well
+                                               // formed. Indicate a
+                                               // processing error to the
+                                               // caller.
+      return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                            "invalid request");
+    default:  // All other errors are treated as internal processing failures.
+      return ::grpc::Status(::grpc::StatusCode::INTERNAL, "internal error");
   }
 }
 
@@ -40,29 +218,10 @@ AuthServiceImpl::AuthServiceImpl(
     ::envoy::service::auth::v2::CheckResponse *response) {
   spdlog::trace("{}", __func__);
   try {
-    auto status = root_->Process(request, response);
-    // See src/filters/filter.h:filter::Process for a description of how status
-    // codes should be handled
-    switch (status) {
-      case google::rpc::Code::OK:               // The request was successful
-      case google::rpc::Code::UNAUTHENTICATED:  // A filter indicated the
-                                                // request had no authentication
-                                                // but was processed correctly.
-      case google::rpc::Code::PERMISSION_DENIED:  // A filter indicated
-                                                  // insufficient permissions
-                                                  // for the authenticated
-                                                  // requester but was processed
-                                                  // correctly.
-        return ::grpc::Status::OK;
-      case google::rpc::Code::INVALID_ARGUMENT:  // The request was not well
-                                                 // formed. Indicate a
-                                                 // processing error to the
-                                                 // caller.
-        return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
-                              "invalid request");
-      default:  // All other errors are treated as internal processing failures.
-        return ::grpc::Status(::grpc::StatusCode::INTERNAL, "internal error");
-    }
+    // Hold a reference to the pipeline so that a concurrent reload cannot
+    // destroy it whilst this request is being processed.
+    auto root = std::atomic_load(&root_);
+    return ToStatus(root->Process(request, response));
   } catch (const std::exception &exception) {
     spdlog::error("%s unexpected error: %s", __func__, exception.what());
   } catch (...) {
@@ -70,5 +229,33 @@ AuthServiceImpl::AuthServiceImpl(
   }
   return ::grpc::Status(::grpc::StatusCode::INTERNAL, "internal error");
 }
+
+void AuthServiceImpl::CheckAsync(
+    const ::envoy::service::auth::v2::CheckRequest *request,
+    ::envoy::service::auth::v2::CheckResponse *response,
+    std::function<void(::grpc::Status)> callback) {
+  spdlog::trace("{}", __func__);
+  // A filter may throw after it has completed, so make sure the callback is
+  // only invoked once.
+  auto completed = std::make_shared<std::atomic<bool>>(false);
+  auto complete = [completed, callback](::grpc::Status status) {
+    if (!completed->exchange(true)) {
+      callback(status);
+    }
+  };
+  try {
+    // The pipeline holds its own filters until processing completes.
+    auto root = std::atomic_load(&root_);
+    root->ProcessAsync(request, response, [complete](google::rpc::Code code) {
+      complete(ToStatus(code));
+    });
+    return;
+  } catch (const std::exception &exception) {
+    spdlog::error("{}: unexpected error: {}", __func__, exception.what());
+  } catch (...) {
+    spdlog::error("{}: unexpected error: unknown", __func__);
+  }
+  complete(::grpc::Status(::grpc::StatusCode::INTERNAL, "internal error"));
+}
 }  // namespace service
 }  // namespace authservice
@@ -1,7 +1,10 @@
 #ifndef AUTHSERVICE_SERVICEIMPL_H
 #define AUTHSERVICE_SERVICEIMPL_H
+#include <functional>
+#include <vector>
 #include "config/config.pb.h"
 #include "envoy/service/auth/v2/external_auth.grpc.pb.h"
+#include "src/common/session/session_store.h"
 #include "src/filters/oidc/token_response.h"
 #include "src/filters/pipe.h"
 
@@ -12,14 +15,77 @@ namespace service {
 
 class AuthServiceImpl final : public Authorization::Service {
  private:
-  std::unique_ptr<filters::Pipe> root_;
+  /** @brief The session store of a filter, with the settings it was built
+   * from.
+   */
+  struct SessionStoreEntry {
+    authservice::config::oidc::OIDCConfig config;
+    common::session::SessionStorePtr store;
+  };
+  typedef std::vector<SessionStoreEntry> SessionStores;
+
+  // Only accessed through std::atomic_load/std::atomic_store.
+  std::shared_ptr<filters::Pipe> root_;
+  // The session stores of the filters in root_, in order. Only accessed by
+  // the constructor and Reload.
+  SessionStores session_stores_;
+
+  /** @brief Build a complete filter pipeline from the given configuration.
+   *
+   * Filters whose session store settings are unchanged reuse the session
+   * store of the current pipeline, so that reloading does not log users out.
+   *
+   * @param config the configuration to build the pipeline from.
+   * @param session_stores the session stores of the current pipeline. On
+   * success they are replaced with those of the new pipeline.
+   * @return the pipeline and the number of filters it contains.
+   */
+  static std::pair<std::shared_ptr<filters::Pipe>, size_t> BuildPipe(
+      const authservice::config::Config &config,
+      SessionStores *session_stores);
+
+  /** @brief Map the status of filter processing to a gRPC status. */
+  static ::grpc::Status ToStatus(google::rpc::Code code);
 
  public:
   AuthServiceImpl(std::shared_ptr<authservice::config::Config> config);
+
+  /** @brief Replace the filter pipeline with one built from the given config.
+   *
+   * The new pipeline is built in full before being atomically swapped in.
+   * Requests that are already in flight complete against the previous
+   * pipeline. If the pipeline cannot be built the previous pipeline is left in
+   * place and an exception is thrown. Sessions survive a reload for filters
+   * whose session_store is unchanged, along with the cryptor_secret and
+   * cookie_encryption that Redis session stores encrypt them with.
+   * Reload must not be called concurrently with itself.
+   *
+   * @param config the new configuration.
+   */
+  void Reload(std::shared_ptr<authservice::config::Config> config);
+
+  /** @brief The session store of the filter at the given index in the
+   * current pipeline, or nullptr if it has none. Exposed for tests.
+   */
+  common::session::SessionStorePtr SessionStore(size_t filter) const;
+
   ::grpc::Status Check(
       ::grpc::ServerContext* context,
       const ::envoy::service::auth::v2::CheckRequest* request,
       ::envoy::service::auth::v2::CheckResponse* response) override;
+
+  /** @brief Check a request without blocking on filter I/O.
+   *
+   * The callback is invoked exactly once, possibly on another thread. The
+   * request and response must remain valid until then.
+   *
+   * @param request the request to check.
+   * @param response the response to populate.
+   * @param callback invoked with the status of the call.
+   */
+  void CheckAsync(const ::envoy::service::auth::v2::CheckRequest* request,
+                  ::envoy::service::auth::v2::CheckResponse* response,
+                  std::function<void(::grpc::Status)> callback);
 };
 }  // namespace service
 }  // namespace authservice
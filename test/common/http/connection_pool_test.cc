@@ -0,0 +1,140 @@
+#include "src/common/http/connection_pool.h"
+#include <future>
+#include <thread>
+#include "gtest/gtest.h"
+#include "src/common/metrics/metrics.h"
+#include "test/common/http/fake_tls_server.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+
+TEST(ConnectionPool, ConnectFailureReleasesSlot) {
+  ConnectionPool::Options options;
+  options.max_connections_per_endpoint = 1;
+  ConnectionPool pool(options);
+  authservice::config::common::Endpoint endpoint;
+  endpoint.set_scheme("https");
+  endpoint.set_hostname("127.0.0.1");
+  endpoint.set_port(1);  // Nothing listens here so connecting is refused.
+  endpoint.set_path("/");
+
+  auto &failures = metrics::Registry::Instance().GetCounter(
+      "http_pool_connect_failures_total");
+  auto before = failures.Value();
+  // If a failed connect leaked its slot the second attempt would block
+  // forever waiting for a free connection.
+  ASSERT_THROW(pool.Acquire(endpoint), boost::system::system_error);
+  ASSERT_THROW(pool.Acquire(endpoint), boost::system::system_error);
+  ASSERT_EQ(failures.Value(), before + 2);
+  ASSERT_EQ(pool.IdleCount(endpoint), 0);
+}
+
+TEST(ConnectionPool, ReusesReleasedConnections) {
+  FakeTlsServer server;
+  ConnectionPool pool;
+  auto &hits =
+      metrics::Registry::Instance().GetCounter("http_pool_hits_total");
+  auto before = hits.Value();
+
+  auto first = pool.Acquire(server.Endpoint());
+  ASSERT_FALSE(first.Reused());
+  first.Release();
+  ASSERT_EQ(pool.IdleCount(server.Endpoint()), 1);
+  auto second = pool.Acquire(server.Endpoint());
+  ASSERT_TRUE(second.Reused());
+  ASSERT_EQ(hits.Value(), before + 1);
+  ASSERT_EQ(server.Connections(), 1);
+
+  // A lease destroyed without being released closes its connection.
+  { auto dropped = std::move(second); }
+  ASSERT_EQ(pool.IdleCount(server.Endpoint()), 0);
+  ASSERT_FALSE(pool.Acquire(server.Endpoint()).Reused());
+  ASSERT_EQ(server.Connections(), 2);
+}
+
+TEST(ConnectionPool, EvictsIdleConnections) {
+  FakeTlsServer server;
+  ConnectionPool::Options options;
+  options.idle_timeout = std::chrono::milliseconds(50);
+  ConnectionPool pool(options);
+  auto &evictions =
+      metrics::Registry::Instance().GetCounter("http_pool_evictions_total");
+  auto before = evictions.Value();
+
+  pool.Acquire(server.Endpoint()).Release();
+  ASSERT_EQ(pool.IdleCount(server.Endpoint()), 1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_EQ(pool.IdleCount(server.Endpoint()), 0);
+  ASSERT_EQ(evictions.Value(), before + 1);
+  ASSERT_FALSE(pool.Acquire(server.Endpoint()).Reused());
+}
+
+TEST(ConnectionPool, SkipsConnectionsClosedByServer) {
+  FakeTlsServer server;
+  ConnectionPool pool;
+  auto &evictions =
+      metrics::Registry::Instance().GetCounter("http_pool_evictions_total");
+
+  pool.Acquire(server.Endpoint()).Release();
+  server.DropConnections();
+  // Give the close time to reach the idle connection.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  auto before = evictions.Value();
+  auto lease = pool.Acquire(server.Endpoint());
+  ASSERT_FALSE(lease.Reused());
+  ASSERT_EQ(evictions.Value(), before + 1);
+  ASSERT_EQ(server.Connections(), 2);
+}
+
+TEST(ConnectionPool, BlocksAtConnectionLimit) {
+  FakeTlsServer server;
+  ConnectionPool::Options options;
+  options.max_connections_per_endpoint = 1;
+  ConnectionPool pool(options);
+
+  auto held = pool.Acquire(server.Endpoint());
+  auto waiting = std::async(std::launch::async, [&pool, &server]() {
+    return pool.Acquire(server.Endpoint()).Reused();
+  });
+  ASSERT_EQ(waiting.wait_for(std::chrono::milliseconds(100)),
+            std::future_status::timeout);
+  held.Release();
+  ASSERT_EQ(waiting.wait_for(std::chrono::seconds(5)),
+            std::future_status::ready);
+  // The waiter is handed the connection that was returned.
+  ASSERT_TRUE(waiting.get());
+  ASSERT_EQ(server.Connections(), 1);
+}
+
+TEST(ConnectionPool, AsyncAcquireTimesOutAtConnectionLimit) {
+  FakeTlsServer server;
+  ConnectionPool::Options options;
+  options.max_connections_per_endpoint = 1;
+  auto pool = std::make_shared<ConnectionPool>(options);
+
+  auto held = pool->Acquire(server.Endpoint());
+  std::promise<boost::system::error_code> failed;
+  pool->AcquireAsync(
+      server.Endpoint(),
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(100),
+      [&failed](const boost::system::error_code &ec,
+                ConnectionPool::lease_ptr_t lease) {
+        ASSERT_FALSE(lease);
+        failed.set_value(ec);
+      });
+  auto result = failed.get_future();
+  ASSERT_EQ(result.wait_for(std::chrono::seconds(5)),
+            std::future_status::ready);
+  ASSERT_EQ(result.get(), boost::asio::error::timed_out);
+
+  // The expired waiter is not handed the connection once it is returned.
+  held.Release();
+  auto lease = pool->Acquire(server.Endpoint());
+  ASSERT_TRUE(lease.Reused());
+  ASSERT_EQ(server.Connections(), 1);
+}
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
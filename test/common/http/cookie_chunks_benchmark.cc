@@ -0,0 +1,62 @@
+// Measures the cost of splitting a token cookie into chunks and gathering it
+// back from a Cookie header, for tokens needing 2, 4 and 8 chunks:
+//
+//   bazel run -c opt //test/common/http:cookie_chunks_benchmark
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "src/common/http/http.h"
+
+using authservice::common::http::http;
+
+namespace {
+const int iterations_ = 20000;
+const size_t max_size_ = 4000;
+const char *name_ = "__Host-authservice-id-token-cookie";
+
+template <typename F>
+double NanosPerOp(F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations_; i++) {
+    f();
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations_;
+}
+}  // namespace
+
+int main() {
+  printf("%8s %8s %12s %12s\n", "chunks", "bytes", "encode ns", "find ns");
+  for (size_t chunks : {2, 4, 8}) {
+    std::string token((max_size_ - 100) * chunks, 'x');
+    std::vector<std::string> cookies = {"other=1", "__Host-state-cookie=2"};
+    auto encoded = http::EncodeCookieChunks(name_, token, max_size_);
+    for (const auto &chunk : encoded) {
+      cookies.push_back(absl::StrCat(chunk.first, "=", chunk.second));
+    }
+    auto header = absl::StrJoin(cookies, "; ");
+    const absl::string_view names[] = {name_, "__Host-state-cookie"};
+    size_t sink = 0;
+    auto encode = NanosPerOp([&]() {
+      sink += http::EncodeCookieChunks(name_, token, max_size_).size();
+    });
+    auto find = NanosPerOp([&]() {
+      // Only empty values are filled in, so each call starts afresh.
+      absl::optional<absl::string_view> values[2];
+      std::string scratch[2];
+      http::FindChunkedCookies(header, names, absl::MakeSpan(values),
+                               absl::MakeSpan(scratch));
+      sink += values[0]->size();
+    });
+    printf("%8zu %8zu %12.0f %12.0f\n", encoded.size(), token.size(),
+           encode, find);
+    if (sink == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
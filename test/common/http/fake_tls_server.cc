@@ -0,0 +1,178 @@
+#include "test/common/http/fake_tls_server.h"
+#include <boost/beast.hpp>
+#include <future>
+#include <stdexcept>
+#include "openssl/ec.h"
+#include "openssl/evp.h"
+#include "openssl/obj_mac.h"
+#include "openssl/x509.h"
+
+namespace beast = boost::beast;
+namespace net = boost::asio;
+namespace ssl = boost::asio::ssl;
+
+namespace authservice {
+namespace common {
+namespace http {
+
+namespace {
+// Give the context a self-signed P-256 certificate for 127.0.0.1.
+void UseSelfSignedCertificate(SSL_CTX *ctx) {
+  std::unique_ptr<EC_KEY, decltype(&EC_KEY_free)> ec_key(
+      EC_KEY_new_by_curve_name(NID_X9_62_prime256v1), &EC_KEY_free);
+  std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(EVP_PKEY_new(),
+                                                          &EVP_PKEY_free);
+  if (!ec_key || !key || !EC_KEY_generate_key(ec_key.get()) ||
+      !EVP_PKEY_set1_EC_KEY(key.get(), ec_key.get())) {
+    throw std::runtime_error("unable to generate key");
+  }
+  std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), &X509_free);
+  auto name = X509_get_subject_name(cert.get());
+  if (!X509_set_version(cert.get(), 2) ||
+      !ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1) ||
+      !X509_gmtime_adj(X509_getm_notBefore(cert.get()), -60) ||
+      !X509_gmtime_adj(X509_getm_notAfter(cert.get()), 3600) ||
+      !X509_NAME_add_entry_by_txt(
+          name, "CN", MBSTRING_ASC,
+          reinterpret_cast<const unsigned char *>("127.0.0.1"), -1, -1, 0) ||
+      !X509_set_issuer_name(cert.get(), name) ||
+      !X509_set_pubkey(cert.get(), key.get()) ||
+      !X509_sign(cert.get(), key.get(), EVP_sha256()) ||
+      !SSL_CTX_use_certificate(ctx, cert.get()) ||
+      !SSL_CTX_use_PrivateKey(ctx, key.get())) {
+    throw std::runtime_error("unable to create certificate");
+  }
+}
+}  // namespace
+
+class FakeTlsServer::Client : public std::enable_shared_from_this<Client> {
+ private:
+  FakeTlsServer &server_;
+  beast::flat_buffer buffer_;
+  beast::http::request<beast::http::string_body> req_;
+  beast::http::response<beast::http::string_body> res_;
+  size_t served_ = 0;
+
+  void Read() {
+    auto self = shared_from_this();
+    req_ = {};
+    beast::http::async_read(
+        stream, buffer_, req_,
+        [self](const boost::system::error_code &ec, size_t) {
+          if (ec) {
+            return self->Close();
+          }
+          auto limit = self->server_.options_.requests_per_connection;
+          if (self->served_ == limit) {
+            return self->Close();
+          }
+          self->served_++;
+          self->server_.requests_++;
+          self->Respond();
+        });
+  }
+
+  void Respond() {
+    res_ = {};
+    res_.result(beast::http::status::ok);
+    res_.version(11);
+    res_.keep_alive(true);
+    res_.body() = "ok";
+    res_.prepare_payload();
+    auto self = shared_from_this();
+    beast::http::async_write(
+        stream, res_, [self](const boost::system::error_code &ec, size_t) {
+          if (ec) {
+            return self->Close();
+          }
+          self->Read();
+        });
+  }
+
+ public:
+  ssl::stream<net::ip::tcp::socket> stream;
+
+  explicit Client(FakeTlsServer &server)
+      : server_(server), stream(server.io_context_, server.ssl_context_) {}
+
+  void Start() {
+    auto self = shared_from_this();
+    stream.async_handshake(ssl::stream_base::server,
+                           [self](const boost::system::error_code &ec) {
+                             if (ec) {
+                               return self->Close();
+                             }
+                             self->Read();
+                           });
+  }
+
+  void Close() {
+    boost::system::error_code ignored;
+    stream.lowest_layer().close(ignored);
+    server_.clients_.erase(shared_from_this());
+  }
+};
+
+FakeTlsServer::FakeTlsServer(Options options)
+    : options_(options),
+      ssl_context_(ssl::context::tlsv12_server),
+      acceptor_(io_context_,
+                net::ip::tcp::endpoint(net::ip::address_v4::loopback(), 0)) {
+  UseSelfSignedCertificate(ssl_context_.native_handle());
+  Accept();
+  thread_ = std::thread([this]() { io_context_.run(); });
+}
+
+FakeTlsServer::FakeTlsServer() : FakeTlsServer(Options()) {}
+
+FakeTlsServer::~FakeTlsServer() {
+  io_context_.stop();
+  thread_.join();
+}
+
+uint16_t FakeTlsServer::Port() const {
+  return acceptor_.local_endpoint().port();
+}
+
+authservice::config::common::Endpoint FakeTlsServer::Endpoint() const {
+  authservice::config::common::Endpoint endpoint;
+  endpoint.set_scheme("https");
+  endpoint.set_hostname("127.0.0.1");
+  endpoint.set_port(Port());
+  endpoint.set_path("/");
+  return endpoint;
+}
+
+size_t FakeTlsServer::Connections() const { return connections_; }
+
+size_t FakeTlsServer::Requests() const { return requests_; }
+
+void FakeTlsServer::DropConnections() {
+  std::promise<void> dropped;
+  net::post(io_context_, [this, &dropped]() {
+    auto clients = clients_;
+    for (const auto &client : clients) {
+      client->Close();
+    }
+    dropped.set_value();
+  });
+  dropped.get_future().wait();
+}
+
+void FakeTlsServer::Accept() {
+  auto client = std::make_shared<Client>(*this);
+  acceptor_.async_accept(client->stream.next_layer(),
+                         [this, client](const boost::system::error_code &ec) {
+                           if (ec) {
+                             return;
+                           }
+                           ++connections_;
+                           clients_.insert(client);
+                           client->Start();
+                           Accept();
+                         });
+}
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
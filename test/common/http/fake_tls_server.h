@@ -0,0 +1,72 @@
+#ifndef AUTHSERVICE_TEST_COMMON_HTTP_FAKE_TLS_SERVER_H_
+#define AUTHSERVICE_TEST_COMMON_HTTP_FAKE_TLS_SERVER_H_
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <set>
+#include <thread>
+#include "config/common/config.pb.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+
+/** @brief An HTTPS server stand-in for tests.
+ *
+ * Listens on an ephemeral loopback port with a freshly generated self-signed
+ * certificate, and answers every request with a keep-alive 200 response.
+ * Requests are served on a single background thread.
+ */
+class FakeTlsServer {
+ public:
+  struct Options {
+    // The number of requests answered per connection. The request after
+    // that is read and the connection closed without a response, as a server
+    // closing an idle connection just as a request arrives would.
+    size_t requests_per_connection = std::numeric_limits<size_t>::max();
+  };
+
+  explicit FakeTlsServer(Options options);
+  FakeTlsServer();
+  ~FakeTlsServer();
+
+  FakeTlsServer(const FakeTlsServer &) = delete;
+  FakeTlsServer &operator=(const FakeTlsServer &) = delete;
+
+  /** @brief The port the server listens on. */
+  uint16_t Port() const;
+
+  /** @brief An endpoint for the server. */
+  authservice::config::common::Endpoint Endpoint() const;
+
+  /** @brief The number of connections accepted. */
+  size_t Connections() const;
+
+  /** @brief The number of requests answered. */
+  size_t Requests() const;
+
+  /** @brief Close every open connection, as a restarting server would. */
+  void DropConnections();
+
+ private:
+  class Client;
+
+  const Options options_;
+  boost::asio::io_context io_context_;
+  boost::asio::ssl::context ssl_context_;
+  boost::asio::ip::tcp::acceptor acceptor_;
+  std::set<std::shared_ptr<Client>> clients_;
+  std::atomic<size_t> connections_{0};
+  std::atomic<size_t> requests_{0};
+  std::thread thread_;
+
+  void Accept();
+};
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
+#endif  // AUTHSERVICE_TEST_COMMON_HTTP_FAKE_TLS_SERVER_H_
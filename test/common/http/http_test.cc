@@ -1,7 +1,15 @@
 #include "src/common/http/http.h"
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <vector>
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "config/common/config.pb.h"
 #include "gtest/gtest.h"
 #include "src/common/http/headers.h"
+#include "test/common/http/fake_tls_server.h"
 
 namespace authservice {
 namespace common {
@@ -97,6 +105,31 @@ TEST(Http, UrlSafeDecode) {
   ASSERT_EQ(hex_test_case.raw, *decoded);
 }
 
+TEST(Http, UrlSafeEncodeAllBytes) {
+  // Long enough to exercise both the block and byte at a time paths.
+  std::string raw;
+  std::string expected;
+  for (int repeat = 0; repeat < 2; ++repeat) {
+    for (int character = 0; character < 256; ++character) {
+      raw.push_back(char(character));
+      if (isalnum(character) ||
+          (character != 0 && strchr("-_.~", character) != nullptr)) {
+        expected.push_back(char(character));
+      } else {
+        char encoded[4];
+        snprintf(encoded, sizeof(encoded), "%%%02X", character);
+        expected.append(encoded);
+      }
+    }
+  }
+  ASSERT_EQ(http::UrlSafeEncode(raw), expected);
+  ASSERT_EQ(http::UrlSafeDecode(expected), raw);
+  ASSERT_EQ(http::UrlSafeDecode("%2"), absl::nullopt);
+  ASSERT_EQ(http::UrlSafeDecode("%zz"), absl::nullopt);
+  ASSERT_EQ(http::UrlSafeDecode("%C3%A9"), std::string("\xC3\xA9"));
+  ASSERT_EQ(http::UrlSafeDecode("a+b"), absl::nullopt);
+}
+
 TEST(Http, EncodeQueryData) {
   auto result = http::EncodeQueryData(query_test_case.encoded);
   std::string expectedResult = query_test_case.raw;
@@ -122,6 +155,40 @@ TEST(Http, DecodeFormData) {
   }
 }
 
+TEST(Http, ParseQueryData) {
+  absl::string_view query = "state=abc&code=a%20b&state=def";
+  std::string scratch;
+  auto result = http::ParseQueryData(query, &scratch);
+  ASSERT_TRUE(result.has_value());
+  ASSERT_EQ(result->size(), 3);
+  ASSERT_EQ((*result)[0].first, "state");
+  ASSERT_EQ((*result)[0].second, "abc");
+  ASSERT_EQ((*result)[1].first, "code");
+  ASSERT_EQ((*result)[1].second, "a b");
+  ASSERT_EQ((*result)[2].second, "def");
+  // Only encoded values are copied.
+  ASSERT_EQ((*result)[0].second.data(), query.data() + 6);
+  ASSERT_EQ((*result)[1].second.data(), scratch.data());
+
+  ASSERT_FALSE(http::ParseQueryData("a=1&", &scratch).has_value());
+  ASSERT_FALSE(http::ParseQueryData("a=1=2", &scratch).has_value());
+  ASSERT_FALSE(http::ParseQueryData("a=1+2", &scratch).has_value());
+  ASSERT_FALSE(http::ParseQueryData("a=%2", &scratch).has_value());
+}
+
+TEST(Http, ParseFormData) {
+  std::string scratch;
+  auto result = http::ParseFormData(form_test_case.raw, &scratch);
+  ASSERT_TRUE(result.has_value());
+  ASSERT_EQ(result->size(), 3);
+  ASSERT_EQ((*result)[0].first, "abc");
+  ASSERT_EQ((*result)[0].second, "123");
+  ASSERT_EQ((*result)[1].first, "cde");
+  ASSERT_EQ((*result)[1].second, "456 7");
+  ASSERT_EQ((*result)[2].first, "987");
+  ASSERT_EQ((*result)[2].second, "\r\n");
+}
+
 TEST(Http, EncodeFormData) {
   auto result = http::EncodeFormData(form_test_case.encoded);
   auto decoded = http::DecodeFormData(result);
@@ -149,28 +216,106 @@ TEST(Http, EncodeSetCookie) {
   ASSERT_STREQ("name=value; HttpOnly; SameSite=Strict; Secure", result.c_str());
 }
 
-TEST(Http, EncodeCookies) {
-  auto cookies1 = "name=value";
-  auto result = http::DecodeCookies(cookies1);
-  ASSERT_TRUE(result.has_value());
-  ASSERT_EQ(result->size(), 1);
-  ASSERT_STREQ((*result)["name"].c_str(), "value");
+TEST(Http, FindCookies) {
+  const absl::string_view names[] = {"first", "second", "third"};
+  absl::optional<absl::string_view> values[3];
+  http::FindCookies("first=1; second=2; third=3", names,
+                    absl::MakeSpan(values));
+  ASSERT_EQ(values[0], absl::string_view("1"));
+  ASSERT_EQ(values[1], absl::string_view("2"));
+  ASSERT_EQ(values[2], absl::string_view("3"));
 
-  auto cookies2 = "first=1; second=2; third=3";
-  result = http::DecodeCookies(cookies2);
-  ASSERT_TRUE(result.has_value());
-  ASSERT_EQ(result->size(), 3);
-  ASSERT_STREQ((*result)["first"].c_str(), "1");
-  ASSERT_STREQ((*result)["second"].c_str(), "2");
-  ASSERT_STREQ((*result)["third"].c_str(), "3");
+  // Only the requested cookies are returned, and the first value wins.
+  absl::optional<absl::string_view> first[1];
+  http::FindCookies("second=2; first=1; first=3", absl::MakeSpan(names, 1),
+                    absl::MakeSpan(first));
+  ASSERT_EQ(first[0], absl::string_view("1"));
+
+  // Unrelated malformed cookies, values containing '=' and missing spaces are
+  // tolerated.
+  absl::optional<absl::string_view> tolerant[3];
+  http::FindCookies("invalid; first=a=b;second= 2 ;=3", names,
+                    absl::MakeSpan(tolerant));
+  ASSERT_EQ(tolerant[0], absl::string_view("a=b"));
+  ASSERT_EQ(tolerant[1], absl::string_view("2"));
+  ASSERT_FALSE(tolerant[2].has_value());
+
+  absl::optional<absl::string_view> missing[3];
+  http::FindCookies("", names, absl::MakeSpan(missing));
+  http::FindCookies("name", names, absl::MakeSpan(missing));
+  http::FindCookies("fir=1; firstly=2", names, absl::MakeSpan(missing));
+  ASSERT_FALSE(missing[0].has_value());
+  ASSERT_FALSE(missing[1].has_value());
+  ASSERT_FALSE(missing[2].has_value());
+}
+
+TEST(Http, EncodeCookieChunks) {
+  // Cookies that fit are not split.
+  auto whole = http::EncodeCookieChunks("name", "value", 10);
+  ASSERT_EQ(whole.size(), 1);
+  ASSERT_EQ(whole[0].first, "name");
+  ASSERT_EQ(whole[0].second, "value");
+
+  std::string value(100, 'x');
+  value[0] = 'a';
+  value[99] = 'z';
+  auto chunks = http::EncodeCookieChunks("name", value, 40);
+  ASSERT_EQ(chunks.size(), 4);
+  std::string joined;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    ASSERT_EQ(chunks[i].first, absl::StrCat("name-", i));
+    ASSERT_LE(chunks[i].first.size() + 1 + chunks[i].second.size(), 40);
+    joined += chunks[i].second;
+  }
+  ASSERT_EQ(joined, absl::StrCat("4.", value));
 
-  auto cookies3 = "name";
-  result = http::DecodeCookies(cookies3);
-  ASSERT_FALSE(result.has_value());
+  // Values that need too many chunks cannot be stored.
+  ASSERT_TRUE(http::EncodeCookieChunks("name", std::string(1000, 'x'), 40)
+                  .empty());
+  ASSERT_TRUE(http::EncodeCookieChunks("long-name", value, 12).empty());
+}
+
+TEST(Http, FindChunkedCookies) {
+  std::string value(100, 'x');
+  value[0] = 'a';
+  value[99] = 'z';
+  std::vector<std::string> cookies = {"other=1"};
+  for (const auto &chunk : http::EncodeCookieChunks("name", value, 40)) {
+    cookies.push_back(absl::StrCat(chunk.first, "=", chunk.second));
+  }
+  cookies.push_back("plain=2");
+  // Chunks may arrive in any order.
+  std::swap(cookies[1], cookies[3]);
+  auto header = absl::StrJoin(cookies, "; ");
 
-  auto cookies4 = "first=1;second=2";
-  result = http::DecodeCookies(cookies4);
-  ASSERT_FALSE(result.has_value());
+  const absl::string_view names[] = {"name", "plain", "missing"};
+  absl::optional<absl::string_view> values[3];
+  std::string scratch[3];
+  http::FindChunkedCookies(header, names, absl::MakeSpan(values),
+                           absl::MakeSpan(scratch));
+  ASSERT_EQ(values[0], absl::string_view(value));
+  ASSERT_EQ(values[1], absl::string_view("2"));
+  ASSERT_FALSE(values[2].has_value());
+
+  // A whole cookie takes precedence over chunks.
+  auto with_whole = absl::StrCat(header, "; name=whole");
+  absl::optional<absl::string_view> preferred[1];
+  http::FindChunkedCookies(with_whole,
+                           absl::MakeSpan(names, 1), absl::MakeSpan(preferred),
+                           absl::MakeSpan(scratch, 1));
+  ASSERT_EQ(preferred[0], absl::string_view("whole"));
+
+  // Incomplete or malformed chunks are ignored.
+  for (auto invalid :
+       {"name-0=2.ab", "name-1=cd", "name-0=ab; name-1=cd",
+        "name-0=99.ab; name-1=cd", "name-00=2.ab; name-1=cd",
+        "name-x=1.ab", "name-=1.ab"}) {
+    absl::optional<absl::string_view> missing[1];
+    http::FindChunkedCookies(invalid, absl::MakeSpan(names, 1),
+                             absl::MakeSpan(missing),
+                             absl::MakeSpan(scratch, 1));
+    ASSERT_FALSE(missing[0].has_value()) << invalid;
+  }
 }
 
 TEST(Http, DecodePath) {
@@ -201,6 +346,102 @@ TEST(Http, DecodePath) {
   ASSERT_STREQ("", result5[2].data());
 }
 
+namespace {
+authservice::config::common::Endpoint LocalEndpoint(uint16_t port) {
+  authservice::config::common::Endpoint endpoint;
+  endpoint.set_scheme("https");
+  endpoint.set_hostname("127.0.0.1");
+  endpoint.set_port(port);
+  endpoint.set_path("/");
+  return endpoint;
+}
+}  // namespace
+
+TEST(Http, PostAsyncConnectFailure) {
+  http_impl client(std::make_shared<ConnectionPool>());
+  std::promise<bool> result;
+  // Nothing listens on port 1 so connecting is refused.
+  client.PostAsync(LocalEndpoint(1), {}, "", std::chrono::seconds(5),
+                   [&result](response_t response) {
+                     result.set_value(response == nullptr);
+                   });
+  ASSERT_TRUE(result.get_future().get());
+}
+
+TEST(Http, PostAsyncTimeout) {
+  // Accept connections but never respond to the TLS handshake.
+  boost::asio::io_context io_context;
+  boost::asio::ip::tcp::acceptor acceptor(
+      io_context, boost::asio::ip::tcp::endpoint(
+                      boost::asio::ip::address_v4::loopback(), 0));
+  http_impl client(std::make_shared<ConnectionPool>());
+  std::promise<bool> result;
+  client.PostAsync(LocalEndpoint(acceptor.local_endpoint().port()), {}, "",
+                   std::chrono::milliseconds(100),
+                   [&result](response_t response) {
+                     result.set_value(response == nullptr);
+                   });
+  auto future = result.get_future();
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(5)),
+            std::future_status::ready);
+  ASSERT_TRUE(future.get());
+}
+
+TEST(Http, PostAsyncCancel) {
+  boost::asio::io_context io_context;
+  boost::asio::ip::tcp::acceptor acceptor(
+      io_context, boost::asio::ip::tcp::endpoint(
+                      boost::asio::ip::address_v4::loopback(), 0));
+  http_impl client(std::make_shared<ConnectionPool>());
+  std::promise<bool> result;
+  auto handle = client.PostAsync(
+      LocalEndpoint(acceptor.local_endpoint().port()), {}, "",
+      std::chrono::seconds(30), [&result](response_t response) {
+        result.set_value(response == nullptr);
+      });
+  handle->Cancel();
+  auto future = result.get_future();
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(5)),
+            std::future_status::ready);
+  ASSERT_TRUE(future.get());
+}
+
+TEST(Http, PostRetriesStaleConnection) {
+  FakeTlsServer::Options options;
+  options.requests_per_connection = 1;
+  FakeTlsServer server(options);
+  http_impl client(std::make_shared<ConnectionPool>());
+  auto first = client.Post(server.Endpoint(), {}, "");
+  ASSERT_NE(first, nullptr);
+  ASSERT_EQ(first->result(), beast::http::status::ok);
+  // The pooled connection passes its health check, but the server closes it
+  // on receiving the request. The request is retried on a new connection.
+  auto second = client.Post(server.Endpoint(), {}, "");
+  ASSERT_NE(second, nullptr);
+  ASSERT_EQ(second->result(), beast::http::status::ok);
+  ASSERT_EQ(server.Connections(), 2);
+  ASSERT_EQ(server.Requests(), 2);
+}
+
+TEST(Http, PostAsyncRetriesStaleConnection) {
+  FakeTlsServer::Options options;
+  options.requests_per_connection = 1;
+  FakeTlsServer server(options);
+  http_impl client(std::make_shared<ConnectionPool>());
+  for (int i = 0; i < 2; ++i) {
+    std::promise<bool> result;
+    client.PostAsync(server.Endpoint(), {}, "", std::chrono::seconds(5),
+                     [&result](response_t response) {
+                       result.set_value(response != nullptr &&
+                                        response->result() ==
+                                            beast::http::status::ok);
+                     });
+    ASSERT_TRUE(result.get_future().get());
+  }
+  ASSERT_EQ(server.Connections(), 2);
+  ASSERT_EQ(server.Requests(), 2);
+}
+
 }  // namespace http
 }  // namespace common
 }  // namespace authservice
@@ -12,6 +12,18 @@ class http_mock : public http {
       response_t(const authservice::config::common::Endpoint &endpoint,
                  const std::map<absl::string_view, absl::string_view> &headers,
                  absl::string_view body));
+  MOCK_CONST_METHOD2(
+      Get,
+      response_t(
+          const authservice::config::common::Endpoint &endpoint,
+          const std::map<absl::string_view, absl::string_view> &headers));
+  MOCK_CONST_METHOD5(
+      PostAsync,
+      request_handle_t(
+          const authservice::config::common::Endpoint &endpoint,
+          const std::map<absl::string_view, absl::string_view> &headers,
+          absl::string_view body, std::chrono::milliseconds timeout,
+          callback_t callback));
 };
 }  // namespace http
 }  // namespace common
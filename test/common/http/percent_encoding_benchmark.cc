@@ -0,0 +1,62 @@
+// Measures the cost of percent encoding a long redirect URI and decoding it
+// back, and of encoding a large form body such as a token request:
+//
+//   bazel run -c opt //test/common/http:percent_encoding_benchmark
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include "absl/strings/str_cat.h"
+#include "src/common/http/http.h"
+
+using authservice::common::http::http;
+
+namespace {
+const int iterations_ = 20000;
+
+template <typename F>
+double NanosPerOp(F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations_; i++) {
+    f();
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations_;
+}
+}  // namespace
+
+int main() {
+  // A redirect URI carrying a long query, as left by deep links into an app.
+  std::string uri = "https://app.example.com/some/deep/path?return=";
+  while (uri.size() < 3500) {
+    absl::StrAppend(&uri, "section/item-", uri.size(),
+                    "?view=full&filter=a b,c&sort=-date;");
+  }
+  // A token request carrying a large code, PKCE verifier and assertion.
+  std::string code(1024, 'c');
+  std::string verifier(128, 'v');
+  std::string assertion(2048, 'a');
+  std::multimap<absl::string_view, absl::string_view> form = {
+      {"grant_type", "authorization_code"},
+      {"code", code},
+      {"redirect_uri", uri},
+      {"code_verifier", verifier},
+      {"client_assertion_type",
+       "urn:ietf:params:oauth:client-assertion-type:jwt-bearer"},
+      {"client_assertion", assertion},
+  };
+  auto encoded = http::UrlSafeEncode(uri);
+  size_t sink = 0;
+  auto encode = NanosPerOp([&]() { sink += http::UrlSafeEncode(uri).size(); });
+  auto decode =
+      NanosPerOp([&]() { sink += http::UrlSafeDecode(encoded)->size(); });
+  auto form_size = http::EncodeFormData(form).size();
+  auto encode_form =
+      NanosPerOp([&]() { sink += http::EncodeFormData(form).size(); });
+  printf("%-20s %8s %12s\n", "operation", "bytes", "ns");
+  printf("%-20s %8zu %12.0f\n", "UrlSafeEncode", uri.size(), encode);
+  printf("%-20s %8zu %12.0f\n", "UrlSafeDecode", encoded.size(), decode);
+  printf("%-20s %8zu %12.0f\n", "EncodeFormData", form_size, encode_form);
+  return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,65 @@
+#include "src/common/http/tls_session_cache.h"
+#include "gtest/gtest.h"
+#include "src/common/http/connection_pool.h"
+#include "src/common/metrics/metrics.h"
+#include "test/common/http/fake_tls_server.h"
+
+namespace authservice {
+namespace common {
+namespace http {
+
+TEST(TlsSessionCache, AttachesToContext) {
+  std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)> ctx(
+      SSL_CTX_new(TLS_client_method()), &SSL_CTX_free);
+  TlsSessionCache cache(ctx.get());
+  ASSERT_EQ(SSL_CTX_get_session_cache_mode(ctx.get()),
+            SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+
+  // With nothing cached, resuming leaves the connection without a session.
+  std::unique_ptr<SSL, decltype(&SSL_free)> ssl(SSL_new(ctx.get()),
+                                                &SSL_free);
+  cache.Resume(ssl.get(), "localhost");
+  ASSERT_EQ(SSL_get_session(ssl.get()), nullptr);
+  ASSERT_EQ(cache.Size(), 0);
+}
+
+TEST(TlsSessionCache, ResumesSessions) {
+  FakeTlsServer server;
+  ConnectionPool pool;
+  auto &metrics = metrics::Registry::Instance();
+  auto &full = metrics.GetCounter("tls_handshakes_full_total");
+  auto &resumed = metrics.GetCounter("tls_handshakes_resumed_total");
+  auto full_before = full.Value();
+  auto resumed_before = resumed.Value();
+
+  // Leases that are not released close their connections, so each Acquire
+  // makes a new one.
+  pool.Acquire(server.Endpoint());
+  ASSERT_EQ(full.Value(), full_before + 1);
+  pool.Acquire(server.Endpoint());
+  ASSERT_EQ(resumed.Value(), resumed_before + 1);
+  ASSERT_EQ(full.Value(), full_before + 1);
+  ASSERT_EQ(server.Connections(), 2);
+}
+
+TEST(TlsSessionCache, KeysSessionsByPort) {
+  FakeTlsServer first;
+  FakeTlsServer second;
+  ConnectionPool pool;
+  auto &resumed =
+      metrics::Registry::Instance().GetCounter("tls_handshakes_resumed_total");
+  auto before = resumed.Value();
+
+  // Each server's session is kept separately, even though they share a host,
+  // so connecting to one does not displace the other's.
+  pool.Acquire(first.Endpoint());
+  pool.Acquire(second.Endpoint());
+  ASSERT_EQ(resumed.Value(), before);
+  pool.Acquire(first.Endpoint());
+  pool.Acquire(second.Endpoint());
+  ASSERT_EQ(resumed.Value(), before + 2);
+}
+
+}  // namespace http
+}  // namespace common
+}  // namespace authservice
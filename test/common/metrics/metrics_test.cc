@@ -0,0 +1,37 @@
+#include "src/common/metrics/metrics.h"
+#include "gtest/gtest.h"
+
+namespace authservice {
+namespace common {
+namespace metrics {
+
+TEST(Metrics, Counter) {
+  Registry registry;
+  auto &counter = registry.GetCounter("requests_total");
+  ASSERT_EQ(counter.Value(), 0);
+  counter.Increment();
+  counter.Increment(2);
+  ASSERT_EQ(counter.Value(), 3);
+  ASSERT_EQ(&counter, &registry.GetCounter("requests_total"));
+}
+
+TEST(Metrics, Gauge) {
+  Registry registry;
+  auto &gauge = registry.GetGauge("connections");
+  gauge.Set(5);
+  gauge.Add(-2);
+  ASSERT_EQ(gauge.Value(), 3);
+  ASSERT_EQ(&gauge, &registry.GetGauge("connections"));
+}
+
+TEST(Metrics, Dump) {
+  Registry registry;
+  registry.GetCounter("b_total").Increment(2);
+  registry.GetCounter("a_total").Increment();
+  registry.GetGauge("c").Set(-1);
+  ASSERT_EQ(registry.Dump(), "a_total 1\nb_total 2\nc -1\n");
+}
+
+}  // namespace metrics
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,93 @@
+#include "src/common/session/compact_token.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+namespace {
+std::string Jwt(absl::string_view header, absl::string_view claims,
+                absl::string_view signature) {
+  return absl::StrCat(absl::WebSafeBase64Escape(header), ".",
+                      absl::WebSafeBase64Escape(claims), ".",
+                      absl::WebSafeBase64Escape(signature));
+}
+}  // namespace
+
+TEST(CompactTokenTest, RoundTrip) {
+  std::string claims =
+      R"({"iss":"https://acme-idp.tld","sub":"user","groups":[)";
+  for (int i = 0; i < 50; ++i) {
+    absl::StrAppend(&claims, i == 0 ? "" : ",", "\"group-", i, "\"");
+  }
+  claims += "]}";
+  auto jwt = Jwt(R"({"alg":"RS256","typ":"JWT","kid":"key"})", claims,
+                 std::string(256, '\x5a'));
+  auto compact = CompactToken(jwt);
+  // Dropping base64 alone saves a quarter, and repetitive claims deflate well.
+  ASSERT_LT(compact.size(), jwt.size() / 2);
+  ASSERT_EQ(ExpandToken(compact), jwt);
+
+  // Claims that do not deflate are still stored without base64.
+  jwt = Jwt("{}", "0123456789abcdefghijklmnopqrstuvwxyz", "signature");
+  compact = CompactToken(jwt);
+  ASSERT_LT(compact.size(), jwt.size());
+  ASSERT_EQ(ExpandToken(compact), jwt);
+
+  // Tokens too small to gain from packing are stored as they are.
+  jwt = Jwt("{}", "{}", "");
+  ASSERT_EQ(CompactToken(jwt), jwt);
+}
+
+TEST(CompactTokenTest, OtherTokensAreStoredAsTheyAre) {
+  for (auto token : {"", "opaque-access-token", "a.b", "a.b.c.d", "a.b.c",
+                     "e30=.e30.", "e30.e30.!"}) {
+    ASSERT_EQ(CompactToken(token), token);
+    ASSERT_EQ(ExpandToken(token), std::string(token));
+  }
+}
+
+TEST(CompactTokenTest, Expiry) {
+  absl::optional<int64_t> expiry;
+  auto jwt = Jwt("{}", "0123456789abcdefghijklmnopqrstuvwxyz", "signature");
+  auto token = ExpandToken(CompactToken(jwt, 1700000000), expiry);
+  ASSERT_EQ(token, jwt);
+  ASSERT_EQ(expiry, 1700000000);
+
+  // Tokens that cannot be packed are kept verbatim alongside their expiry.
+  for (auto other : {"", "opaque-access-token", "e30.e30"}) {
+    token = ExpandToken(CompactToken(other, 1), expiry);
+    ASSERT_EQ(token, std::string(other));
+    ASSERT_EQ(expiry, 1);
+  }
+
+  // Tokens stored without an expiry have none.
+  ASSERT_EQ(ExpandToken(CompactToken(jwt), expiry), jwt);
+  ASSERT_FALSE(expiry.has_value());
+  ASSERT_EQ(ExpandToken("opaque", expiry), std::string("opaque"));
+  ASSERT_FALSE(expiry.has_value());
+}
+
+TEST(CompactTokenTest, Malformed) {
+  auto compact = CompactToken(Jwt("{}", std::string(100, 'x'), "sig"));
+  ASSERT_TRUE(ExpandToken(compact).has_value());
+  for (size_t size = 1; size < compact.size(); ++size) {
+    ASSERT_FALSE(ExpandToken(compact.substr(0, size)).has_value()) << size;
+  }
+  auto flags = compact;
+  flags[1] = '\x08';
+  ASSERT_FALSE(ExpandToken(flags).has_value());
+  auto corrupt = compact;
+  corrupt[5] ^= 0x55;
+  ASSERT_FALSE(ExpandToken(corrupt).has_value());
+  // Sizes far larger than any real token are refused before inflating.
+  ASSERT_FALSE(
+      ExpandToken(absl::string_view("\0\1\xff\xff\xff\x0f\0\0", 8))
+          .has_value());
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,183 @@
+#include "test/common/session/fake_redis.h"
+#include <future>
+#include <vector>
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "src/common/session/resp.h"
+
+namespace net = boost::asio;
+
+namespace authservice {
+namespace common {
+namespace session {
+
+namespace {
+std::string Bulk(absl::string_view value) {
+  return absl::StrCat("$", value.size(), "\r\n", value, "\r\n");
+}
+}  // namespace
+
+class FakeRedis::Client : public std::enable_shared_from_this<Client> {
+ private:
+  FakeRedis &server_;
+  std::string received_;
+  std::string replies_;
+  char buffer_[4096];
+
+  std::string Handle(const RespReply &request) {
+    if (request.type != RespReply::Type::ARRAY || request.elements.empty()) {
+      return "-ERR invalid request\r\n";
+    }
+    std::vector<std::string> args;
+    for (const auto &element : request.elements) {
+      args.push_back(element.str);
+    }
+    auto name = absl::AsciiStrToUpper(args[0]);
+    auto now = std::chrono::steady_clock::now();
+    ++server_.commands_;
+    if (name == "PING") {
+      return "+PONG\r\n";
+    }
+    if (name == "GET" && args.size() == 2) {
+      auto found = server_.data_.find(args[1]);
+      if (found == server_.data_.end() || found->second.expiry <= now) {
+        return "$-1\r\n";
+      }
+      return Bulk(found->second.value);
+    }
+    if (name == "SET" && args.size() == 3) {
+      server_.data_[args[1]] =
+          Value{args[2], std::chrono::steady_clock::time_point::max()};
+      return "+OK\r\n";
+    }
+    int64_t seconds;
+    if (name == "SETEX" && args.size() == 4) {
+      if (!absl::SimpleAtoi(args[2], &seconds) || seconds <= 0) {
+        return "-ERR invalid expire time in 'setex' command\r\n";
+      }
+      server_.data_[args[1]] =
+          Value{args[3], now + std::chrono::seconds(seconds)};
+      return "+OK\r\n";
+    }
+    if (name == "DEL" && args.size() >= 2) {
+      size_t removed = 0;
+      for (size_t i = 1; i < args.size(); ++i) {
+        removed += server_.data_.erase(args[i]);
+      }
+      return absl::StrCat(":", removed, "\r\n");
+    }
+    return absl::StrCat("-ERR unknown command '", args[0], "'\r\n");
+  }
+
+  void Read() {
+    auto self = shared_from_this();
+    socket.async_read_some(
+        net::buffer(buffer_),
+        [self](const boost::system::error_code &ec, size_t read) {
+          if (ec) {
+            self->Close();
+            return;
+          }
+          self->received_.append(self->buffer_, read);
+          self->Serve();
+        });
+  }
+
+  void Serve() {
+    // Reply to every complete request received so far at once, as a real
+    // server does for pipelined requests.
+    size_t parsed = 0;
+    try {
+      for (;;) {
+        size_t consumed = 0;
+        auto request = ParseRespReply(
+            absl::string_view(received_).substr(parsed), consumed);
+        if (!request.has_value()) {
+          break;
+        }
+        parsed += consumed;
+        replies_.append(Handle(*request));
+      }
+    } catch (const std::exception &) {
+      Close();
+      return;
+    }
+    received_.erase(0, parsed);
+    if (replies_.empty()) {
+      return Read();
+    }
+    auto self = shared_from_this();
+    net::async_write(socket, net::buffer(replies_),
+                     [self](const boost::system::error_code &ec, size_t) {
+                       if (ec) {
+                         self->Close();
+                         return;
+                       }
+                       self->replies_.clear();
+                       self->Read();
+                     });
+  }
+
+ public:
+  net::ip::tcp::socket socket;
+
+  explicit Client(FakeRedis &server)
+      : server_(server), socket(server.io_context_) {}
+
+  void Start() { Read(); }
+
+  void Close() {
+    boost::system::error_code ignored;
+    socket.close(ignored);
+    server_.clients_.erase(shared_from_this());
+  }
+};
+
+FakeRedis::FakeRedis()
+    : acceptor_(io_context_,
+                net::ip::tcp::endpoint(net::ip::address_v4::loopback(), 0)) {
+  Accept();
+  thread_ = std::thread([this]() { io_context_.run(); });
+}
+
+FakeRedis::~FakeRedis() {
+  io_context_.stop();
+  thread_.join();
+}
+
+uint16_t FakeRedis::Port() const { return acceptor_.local_endpoint().port(); }
+
+size_t FakeRedis::Commands() const { return commands_; }
+
+size_t FakeRedis::Connections() const { return connections_; }
+
+void FakeRedis::DropConnections() {
+  std::promise<void> dropped;
+  net::post(io_context_, [this, &dropped]() {
+    auto clients = clients_;
+    for (const auto &client : clients) {
+      client->Close();
+    }
+    dropped.set_value();
+  });
+  dropped.get_future().wait();
+}
+
+void FakeRedis::Accept() {
+  auto client = std::make_shared<Client>(*this);
+  acceptor_.async_accept(client->socket,
+                         [this, client](const boost::system::error_code &ec) {
+                           if (ec) {
+                             return;
+                           }
+                           ++connections_;
+                           clients_.insert(client);
+                           client->Start();
+                           Accept();
+                         });
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
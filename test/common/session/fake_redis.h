@@ -0,0 +1,64 @@
+#ifndef AUTHSERVICE_TEST_COMMON_SESSION_FAKE_REDIS_H_
+#define AUTHSERVICE_TEST_COMMON_SESSION_FAKE_REDIS_H_
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace authservice {
+namespace common {
+namespace session {
+
+/** @brief A Redis server stand-in for tests.
+ *
+ * Listens on an ephemeral loopback port and implements just the commands the
+ * session store uses: PING, GET, SET, SETEX and DEL. Requests are served on a
+ * single background thread.
+ */
+class FakeRedis {
+ public:
+  FakeRedis();
+  ~FakeRedis();
+
+  FakeRedis(const FakeRedis &) = delete;
+  FakeRedis &operator=(const FakeRedis &) = delete;
+
+  /** @brief The port the server listens on. */
+  uint16_t Port() const;
+
+  /** @brief The number of commands served. */
+  size_t Commands() const;
+
+  /** @brief The number of connections accepted. */
+  size_t Connections() const;
+
+  /** @brief Close every open connection, as a restarting server would. */
+  void DropConnections();
+
+ private:
+  class Client;
+  struct Value {
+    std::string value;
+    std::chrono::steady_clock::time_point expiry;
+  };
+
+  boost::asio::io_context io_context_;
+  boost::asio::ip::tcp::acceptor acceptor_;
+  std::map<std::string, Value> data_;
+  std::set<std::shared_ptr<Client>> clients_;
+  std::atomic<size_t> commands_{0};
+  std::atomic<size_t> connections_{0};
+  std::thread thread_;
+
+  void Accept();
+};
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
+#endif  // AUTHSERVICE_TEST_COMMON_SESSION_FAKE_REDIS_H_
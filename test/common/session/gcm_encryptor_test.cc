@@ -1,4 +1,6 @@
 #include "src/common/session/gcm_encryptor.h"
+#include <algorithm>
+#include <stdexcept>
 
 #include "gtest/gtest.h"
 
@@ -47,6 +49,56 @@ TEST(GcmEncryptorTest, SealAndOpen) {
   EXPECT_EQ(*opened, pt);
 };
 
+TEST(GcmEncryptorTest, SealAndOpenSpans) {
+  auto encryptor = GcmEncryptor::Create(key);
+  std::vector<unsigned char> header = {1, 2, 3};
+
+  std::vector<unsigned char> sealed(pt.size() + encryptor->Overhead());
+  auto len = encryptor->Seal(pt, header, absl::MakeSpan(sealed));
+  ASSERT_EQ(len, sealed.size());
+
+  // Spans interoperate with the vector API.
+  auto opened = encryptor->Open(sealed, header);
+  ASSERT_TRUE(opened);
+  EXPECT_EQ(*opened, pt);
+  EXPECT_FALSE(encryptor->Open(sealed).has_value());
+
+  // Open in place, over the ciphertext.
+  auto nonce_len = encryptor->NonceLength();
+  auto in_place = absl::MakeSpan(sealed).subspan(nonce_len);
+  auto opened_len = encryptor->Open(sealed, header, in_place);
+  ASSERT_TRUE(opened_len);
+  ASSERT_EQ(*opened_len, pt.size());
+  EXPECT_TRUE(std::equal(pt.begin(), pt.end(), sealed.begin() + nonce_len));
+
+  // Tampered data and short buffers are rejected.
+  std::vector<unsigned char> out(pt.size());
+  sealed = encryptor->Seal(pt, absl::nullopt, header);
+  EXPECT_FALSE(encryptor->Open(sealed, header, absl::MakeSpan(out)));
+  out.resize(sealed.size());
+  sealed.back() ^= 1;
+  EXPECT_FALSE(encryptor->Open(sealed, header, absl::MakeSpan(out)));
+  std::vector<unsigned char> small(pt.size());
+  EXPECT_THROW(encryptor->Seal(pt, header, absl::MakeSpan(small)),
+               std::range_error);
+}
+
+TEST(GcmEncryptorTest, OtherAead) {
+  auto encryptor = GcmEncryptor::Create(EVP_aead_chacha20_poly1305(), key);
+  ASSERT_EQ(encryptor->NonceLength(), 12);
+  auto sealed = encryptor->Seal(pt, absl::nullopt, aad);
+  ASSERT_EQ(sealed.size(), pt.size() + encryptor->Overhead());
+  auto opened = encryptor->Open(sealed, aad);
+  ASSERT_TRUE(opened);
+  EXPECT_EQ(*opened, pt);
+
+  // AES-GCM with the same key does not open it.
+  EXPECT_FALSE(GcmEncryptor::Create(key)->Open(sealed, aad).has_value());
+
+  EXPECT_THROW(GcmEncryptor::Create(EVP_aead_chacha20_poly1305(), iv),
+               std::range_error);
+}
+
 }  // namespace session
 }  // namespace common
 }  // namespace authservice
@@ -0,0 +1,84 @@
+#include "src/common/session/in_memory_session_store.h"
+#include "gtest/gtest.h"
+#include "src/common/metrics/metrics.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+namespace {
+const auto later_ = std::chrono::system_clock::now() + std::chrono::hours(1);
+}  // namespace
+
+TEST(InMemorySessionStoreTest, PutGetAndRemove) {
+  auto &sessions =
+      metrics::Registry::Instance().GetGauge("session_store_sessions");
+  auto before = sessions.Value();
+  {
+    InMemorySessionStore store;
+    auto id = store.Put(Session{"id", std::string("access")}, later_);
+    ASSERT_EQ(id.size(), 22);
+    auto other = store.Put(Session{"other", absl::nullopt}, later_);
+    ASSERT_NE(id, other);
+    ASSERT_EQ(store.Size(), 2);
+    ASSERT_EQ(sessions.Value(), before + 2);
+
+    auto session = store.Get(id);
+    ASSERT_TRUE(session.has_value());
+    ASSERT_EQ(session->id_token, "id");
+    ASSERT_EQ(session->access_token, "access");
+    session = store.Get(other);
+    ASSERT_TRUE(session.has_value());
+    ASSERT_EQ(session->id_token, "other");
+    ASSERT_FALSE(session->access_token.has_value());
+    ASSERT_FALSE(store.Get("unknown").has_value());
+
+    store.Remove(id);
+    ASSERT_FALSE(store.Get(id).has_value());
+    ASSERT_EQ(store.Size(), 1);
+    // Removing twice is harmless.
+    store.Remove(id);
+    ASSERT_EQ(sessions.Value(), before + 1);
+  }
+  ASSERT_EQ(sessions.Value(), before);
+}
+
+TEST(InMemorySessionStoreTest, GetExpired) {
+  auto &expired =
+      metrics::Registry::Instance().GetCounter("session_store_expired_total");
+  auto before = expired.Value();
+  InMemorySessionStore store;
+  auto id = store.Put(Session{"id", absl::nullopt},
+                      std::chrono::system_clock::now());
+  ASSERT_FALSE(store.Get(id).has_value());
+  ASSERT_EQ(store.Size(), 0);
+  ASSERT_EQ(expired.Value(), before + 1);
+}
+
+TEST(InMemorySessionStoreTest, Sweep) {
+  auto now = std::chrono::system_clock::now();
+  InMemorySessionStore store(2, std::chrono::seconds(1), 4);
+  store.Put(Session{"soon", absl::nullopt},
+            now + std::chrono::milliseconds(1500));
+  // Further ahead than a turn of the wheel.
+  auto late = store.Put(Session{"late", absl::nullopt},
+                        now + std::chrono::seconds(10));
+  auto removed = store.Put(Session{"removed", absl::nullopt},
+                           now + std::chrono::milliseconds(1500));
+  store.Remove(removed);
+  ASSERT_EQ(store.Size(), 2);
+
+  store.Sweep(now + std::chrono::seconds(3));
+  ASSERT_EQ(store.Size(), 1);
+  ASSERT_TRUE(store.Get(late).has_value());
+
+  store.Sweep(now + std::chrono::seconds(6));
+  ASSERT_EQ(store.Size(), 1);
+
+  store.Sweep(now + std::chrono::seconds(11));
+  ASSERT_EQ(store.Size(), 0);
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
@@ -9,8 +9,13 @@ namespace session {
 class TokenEncryptorMock final : public TokenEncryptor {
  public:
   MOCK_METHOD1(Encrypt, std::string(const std::string& token));
+  MOCK_METHOD2(Encrypt,
+               std::string(const std::string& token, const std::string& aad));
   MOCK_METHOD1(Decrypt,
                absl::optional<std::string>(const std::string& ciphertext));
+  MOCK_METHOD2(Decrypt,
+               absl::optional<std::string>(const std::string& ciphertext,
+                                           const std::string& aad));
 };
 }  // namespace session
 }  // namespace common
@@ -0,0 +1,175 @@
+#include "src/common/session/redis_client.h"
+#include <atomic>
+#include <boost/asio.hpp>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+#include "src/common/metrics/metrics.h"
+#include "test/common/session/fake_redis.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+// Tests run against an in-process fake unless AUTHSERVICE_TEST_REDIS_PORT names
+// the port of a redis-server listening on localhost.
+class RedisClientTest : public ::testing::Test {
+ protected:
+  FakeRedis fake_;
+  uint16_t port_ = 0;
+
+  void SetUp() override {
+    auto port = std::getenv("AUTHSERVICE_TEST_REDIS_PORT");
+    uint32_t real_port;
+    if (port != nullptr && absl::SimpleAtoi(port, &real_port)) {
+      port_ = static_cast<uint16_t>(real_port);
+    } else {
+      port_ = fake_.Port();
+    }
+  }
+
+  bool UsingFake() const { return port_ == fake_.Port(); }
+};
+
+TEST_F(RedisClientTest, Execute) {
+  RedisClient client("127.0.0.1", port_);
+  const absl::string_view ping[] = {"PING"};
+  auto reply = client.Execute(ping);
+  ASSERT_EQ(reply.type, RespReply::Type::STATUS);
+  ASSERT_EQ(reply.str, "PONG");
+
+  const absl::string_view setex[] = {"SETEX", "redis-client-test", "60",
+                                     "value"};
+  ASSERT_EQ(client.Execute(setex).type, RespReply::Type::STATUS);
+  const absl::string_view get[] = {"GET", "redis-client-test"};
+  reply = client.Execute(get);
+  ASSERT_EQ(reply.type, RespReply::Type::BULK);
+  ASSERT_EQ(reply.str, "value");
+
+  const absl::string_view del[] = {"DEL", "redis-client-test"};
+  reply = client.Execute(del);
+  ASSERT_EQ(reply.type, RespReply::Type::INTEGER);
+  ASSERT_EQ(reply.integer, 1);
+  ASSERT_EQ(client.Execute(get).type, RespReply::Type::NIL);
+
+  // Error replies are returned rather than thrown.
+  const absl::string_view unknown[] = {"NOSUCHCOMMAND"};
+  ASSERT_EQ(client.Execute(unknown).type, RespReply::Type::ERROR);
+}
+
+TEST_F(RedisClientTest, ConcurrentCommandsAreBatched) {
+  auto &registry = metrics::Registry::Instance();
+  auto &round_trips = registry.GetCounter("redis_round_trips_total");
+  auto &commands = registry.GetCounter("redis_commands_total");
+  auto round_trips_before = round_trips.Value();
+  auto commands_before = commands.Value();
+
+  RedisClient::Options options;
+  options.connections = 2;
+  RedisClient client("127.0.0.1", port_, options);
+  std::vector<std::thread> threads;
+  std::vector<int> mismatches(8);
+  for (size_t t = 0; t < mismatches.size(); ++t) {
+    threads.emplace_back([&client, &mismatches, t]() {
+      for (int i = 0; i < 100; ++i) {
+        auto key = absl::StrCat("redis-client-test-", t);
+        auto value = absl::StrCat(i);
+        const absl::string_view setex[] = {"SETEX", key, "60", value};
+        client.Execute(setex);
+        const absl::string_view get[] = {"GET", key};
+        if (client.Execute(get).str != value) {
+          ++mismatches[t];
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto mismatched : mismatches) {
+    ASSERT_EQ(mismatched, 0);
+  }
+  // Each caller gets its own reply, and never more than one round trip is
+  // made per command.
+  ASSERT_EQ(commands.Value(), commands_before + 1600);
+  ASSERT_LE(round_trips.Value() - round_trips_before, 1600);
+  if (UsingFake()) {
+    ASSERT_LE(fake_.Connections(), 2);
+  }
+}
+
+TEST_F(RedisClientTest, QueuedCallersTakeOverSending) {
+  // With single command pipelines every caller but the first finds its
+  // command queued behind others, and must send it once a connection is
+  // returned.
+  RedisClient::Options options;
+  options.connections = 1;
+  options.max_batch = 1;
+  RedisClient client("127.0.0.1", port_, options);
+  std::vector<std::thread> threads;
+  std::atomic<int> pongs(0);
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&client, &pongs]() {
+      const absl::string_view ping[] = {"PING"};
+      for (int i = 0; i < 50; ++i) {
+        if (client.Execute(ping).str == "PONG") {
+          ++pongs;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(pongs, 400);
+}
+
+TEST_F(RedisClientTest, ReconnectsAfterServerClose) {
+  if (!UsingFake()) {
+    return;
+  }
+  RedisClient::Options options;
+  options.connections = 1;
+  RedisClient client("127.0.0.1", port_, options);
+  const absl::string_view ping[] = {"PING"};
+  ASSERT_EQ(client.Execute(ping).str, "PONG");
+  fake_.DropConnections();
+  ASSERT_EQ(client.Execute(ping).str, "PONG");
+  ASSERT_EQ(fake_.Connections(), 2);
+}
+
+TEST(RedisClient, ConnectFailure) {
+  auto &errors =
+      metrics::Registry::Instance().GetCounter("redis_errors_total");
+  auto before = errors.Value();
+  RedisClient client("127.0.0.1", 1);  // Nothing listens here.
+  const absl::string_view ping[] = {"PING"};
+  ASSERT_THROW(client.Execute(ping), std::runtime_error);
+  // The failed connection does not leak its slot.
+  ASSERT_THROW(client.Execute(ping), std::runtime_error);
+  ASSERT_EQ(errors.Value(), before + 2);
+}
+
+TEST(RedisClient, Timeout) {
+  // Connections to a listening socket that is never accepted from are
+  // established, but never replied to.
+  boost::asio::io_context io_context;
+  boost::asio::ip::tcp::acceptor acceptor(
+      io_context, boost::asio::ip::tcp::endpoint(
+                      boost::asio::ip::address_v4::loopback(), 0));
+  RedisClient::Options options;
+  options.timeout = std::chrono::milliseconds(50);
+  RedisClient client("127.0.0.1", acceptor.local_endpoint().port(), options);
+  const absl::string_view ping[] = {"PING"};
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_THROW(client.Execute(ping), std::runtime_error);
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
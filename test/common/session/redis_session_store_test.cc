@@ -0,0 +1,124 @@
+#include "src/common/session/redis_session_store.h"
+#include "gtest/gtest.h"
+#include "test/common/session/fake_redis.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+namespace {
+const auto later_ = std::chrono::system_clock::now() + std::chrono::hours(1);
+const auto cryptor_ = TokenEncryptor::Create("secret");
+}  // namespace
+
+TEST(RedisSessionStoreTest, PutGetAndRemove) {
+  FakeRedis server;
+  auto client = std::make_shared<RedisClient>("127.0.0.1", server.Port());
+  RedisSessionStore store(client, cryptor_);
+  auto id = store.Put(Session{"id", std::string("access")}, later_);
+  ASSERT_EQ(id.size(), 22);
+  auto other = store.Put(Session{"other", absl::nullopt}, later_);
+  ASSERT_NE(id, other);
+
+  auto session = store.Get(id);
+  ASSERT_TRUE(session.has_value());
+  ASSERT_EQ(session->id_token, "id");
+  ASSERT_EQ(session->access_token, "access");
+  session = store.Get(other);
+  ASSERT_TRUE(session.has_value());
+  ASSERT_EQ(session->id_token, "other");
+  ASSERT_FALSE(session->access_token.has_value());
+  ASSERT_FALSE(store.Get("unknown").has_value());
+
+  store.Remove(id);
+  ASSERT_FALSE(store.Get(id).has_value());
+  ASSERT_TRUE(store.Get(other).has_value());
+}
+
+TEST(RedisSessionStoreTest, SealsSessions) {
+  FakeRedis server;
+  auto client = std::make_shared<RedisClient>("127.0.0.1", server.Port());
+  RedisSessionStore::Options options;
+  options.cache_capacity = 0;
+  RedisSessionStore store(client, cryptor_, options);
+  auto id = store.Put(Session{"id token", std::string("access")}, later_);
+  auto other = store.Put(Session{"other", absl::nullopt}, later_);
+
+  auto key = "authservice:session:" + id;
+  const absl::string_view get[] = {"GET", key};
+  auto value = client->Execute(get).str;
+  ASSERT_EQ(value.find("id token"), std::string::npos);
+  ASSERT_EQ(value.find("access"), std::string::npos);
+
+  // A session copied to another id cannot be read.
+  auto other_key = "authservice:session:" + other;
+  const absl::string_view set[] = {"SET", other_key, value};
+  client->Execute(set);
+  ASSERT_TRUE(store.Get(id).has_value());
+  ASSERT_FALSE(store.Get(other).has_value());
+
+  // Nor can one sealed with another secret.
+  RedisSessionStore rotated(client, TokenEncryptor::Create("rotated"),
+                            options);
+  ASSERT_FALSE(rotated.Get(id).has_value());
+}
+
+TEST(RedisSessionStoreTest, SharedBetweenStores) {
+  FakeRedis server;
+  auto client = std::make_shared<RedisClient>("127.0.0.1", server.Port());
+  RedisSessionStore first(client, cryptor_);
+  RedisSessionStore second(client, cryptor_);
+  auto id = first.Put(Session{"id", absl::nullopt}, later_);
+  auto session = second.Get(id);
+  ASSERT_TRUE(session.has_value());
+  ASSERT_EQ(session->id_token, "id");
+}
+
+TEST(RedisSessionStoreTest, CachesReads) {
+  FakeRedis server;
+  auto client = std::make_shared<RedisClient>("127.0.0.1", server.Port());
+  RedisSessionStore writer(client, cryptor_);
+  RedisSessionStore reader(client, cryptor_);
+  auto id = writer.Put(Session{"id", absl::nullopt}, later_);
+  auto commands = server.Commands();
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(reader.Get(id).has_value());
+  }
+  // Only the first read reaches the server.
+  ASSERT_EQ(server.Commands(), commands + 1);
+
+  RedisSessionStore::Options options;
+  options.cache_capacity = 0;
+  RedisSessionStore uncached(client, cryptor_, options);
+  commands = server.Commands();
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(uncached.Get(id).has_value());
+  }
+  ASSERT_EQ(server.Commands(), commands + 10);
+}
+
+TEST(RedisSessionStoreTest, Expiry) {
+  FakeRedis server;
+  auto client = std::make_shared<RedisClient>("127.0.0.1", server.Port());
+  RedisSessionStore store(client, cryptor_);
+  auto id = store.Put(Session{"id", absl::nullopt},
+                      std::chrono::system_clock::now());
+  ASSERT_FALSE(store.Get(id).has_value());
+}
+
+TEST(RedisSessionStoreTest, Unavailable) {
+  RedisClient::Options client_options;
+  client_options.timeout = std::chrono::milliseconds(100);
+  // Nothing listens here.
+  auto client =
+      std::make_shared<RedisClient>("127.0.0.1", 1, client_options);
+  RedisSessionStore store(client, cryptor_);
+  ASSERT_THROW(store.Put(Session{"id", absl::nullopt}, later_),
+               std::runtime_error);
+  ASSERT_FALSE(store.Get("id").has_value());
+  store.Remove("id");
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
@@ -0,0 +1,78 @@
+#include "src/common/session/resp.h"
+#include <stdexcept>
+#include "gtest/gtest.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+TEST(RespTest, AppendCommand) {
+  std::string out;
+  const absl::string_view get[] = {"GET", "key"};
+  AppendRespCommand(get, out);
+  ASSERT_EQ(out, "*2\r\n$3\r\nGET\r\n$3\r\nkey\r\n");
+  // Arguments may hold any bytes.
+  const absl::string_view set[] = {"SET", "k", absl::string_view("a\r\n\0", 4)};
+  AppendRespCommand(set, out);
+  ASSERT_EQ(out,
+            absl::string_view("*2\r\n$3\r\nGET\r\n$3\r\nkey\r\n"
+                              "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$4\r\na\r\n\0\r\n",
+                              52));
+}
+
+TEST(RespTest, ParseReplies) {
+  size_t consumed = 0;
+  auto reply = ParseRespReply("+OK\r\n", consumed);
+  ASSERT_TRUE(reply.has_value());
+  ASSERT_EQ(reply->type, RespReply::Type::STATUS);
+  ASSERT_EQ(reply->str, "OK");
+  ASSERT_EQ(consumed, 5);
+
+  reply = ParseRespReply("-ERR wrong\r\n", consumed);
+  ASSERT_EQ(reply->type, RespReply::Type::ERROR);
+  ASSERT_EQ(reply->str, "ERR wrong");
+
+  reply = ParseRespReply(":-42\r\n", consumed);
+  ASSERT_EQ(reply->type, RespReply::Type::INTEGER);
+  ASSERT_EQ(reply->integer, -42);
+
+  reply = ParseRespReply("$5\r\na\r\nbc\r\n+OK\r\n", consumed);
+  ASSERT_EQ(reply->type, RespReply::Type::BULK);
+  ASSERT_EQ(reply->str, "a\r\nbc");
+  ASSERT_EQ(consumed, 11);
+
+  reply = ParseRespReply("$-1\r\n", consumed);
+  ASSERT_EQ(reply->type, RespReply::Type::NIL);
+
+  reply = ParseRespReply("*2\r\n$1\r\na\r\n:1\r\n", consumed);
+  ASSERT_EQ(reply->type, RespReply::Type::ARRAY);
+  ASSERT_EQ(reply->elements.size(), 2);
+  ASSERT_EQ(reply->elements[0].str, "a");
+  ASSERT_EQ(reply->elements[1].integer, 1);
+  ASSERT_EQ(consumed, 15);
+}
+
+TEST(RespTest, ParseIncomplete) {
+  const std::string full = "*2\r\n$5\r\nhello\r\n:1\r\n";
+  for (size_t size = 0; size < full.size(); ++size) {
+    size_t consumed = 0;
+    ASSERT_FALSE(ParseRespReply(full.substr(0, size), consumed).has_value());
+  }
+  size_t consumed = 0;
+  ASSERT_TRUE(ParseRespReply(full, consumed).has_value());
+  ASSERT_EQ(consumed, full.size());
+}
+
+TEST(RespTest, ParseInvalid) {
+  size_t consumed = 0;
+  ASSERT_THROW(ParseRespReply("?\r\n", consumed), std::runtime_error);
+  ASSERT_THROW(ParseRespReply("\r\n", consumed), std::runtime_error);
+  ASSERT_THROW(ParseRespReply(":x\r\n", consumed), std::runtime_error);
+  ASSERT_THROW(ParseRespReply("$-2\r\n", consumed), std::runtime_error);
+  ASSERT_THROW(ParseRespReply("$1\r\nab\r\n", consumed), std::runtime_error);
+  ASSERT_THROW(ParseRespReply("*99999999\r\n", consumed), std::runtime_error);
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
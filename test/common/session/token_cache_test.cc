@@ -0,0 +1,78 @@
+#include "src/common/session/token_cache.h"
+#include "gtest/gtest.h"
+#include "src/common/metrics/metrics.h"
+
+namespace authservice {
+namespace common {
+namespace session {
+
+namespace {
+const auto later_ = std::chrono::system_clock::now() + std::chrono::hours(1);
+}  // namespace
+
+TEST(TokenCacheTest, GetAndPut) {
+  auto &registry = metrics::Registry::Instance();
+  auto hits = registry.GetCounter("token_cache_hits_total").Value();
+  auto misses = registry.GetCounter("token_cache_misses_total").Value();
+  auto bytes = registry.GetGauge("token_cache_bytes").Value();
+  {
+    TokenCache cache(16);
+    ASSERT_FALSE(cache.Get("ciphertext").has_value());
+    cache.Put("ciphertext", "plaintext", later_);
+    ASSERT_EQ(cache.Get("ciphertext"), "plaintext");
+    ASSERT_FALSE(cache.Get("other").has_value());
+    ASSERT_EQ(cache.Size(), 1);
+
+    // Replacing an entry does not grow the cache.
+    cache.Put("ciphertext", "updated", later_);
+    ASSERT_EQ(cache.Get("ciphertext"), "updated");
+    ASSERT_EQ(cache.Size(), 1);
+
+    ASSERT_EQ(registry.GetCounter("token_cache_hits_total").Value(), hits + 2);
+    ASSERT_EQ(registry.GetCounter("token_cache_misses_total").Value(),
+              misses + 2);
+    ASSERT_GT(registry.GetGauge("token_cache_bytes").Value(), bytes);
+  }
+  ASSERT_EQ(registry.GetGauge("token_cache_bytes").Value(), bytes);
+}
+
+TEST(TokenCacheTest, Expiry) {
+  TokenCache cache(16);
+  auto now = std::chrono::system_clock::now();
+  cache.Put("ciphertext", "plaintext", now + std::chrono::seconds(1));
+  ASSERT_EQ(cache.Get("ciphertext", now), "plaintext");
+  ASSERT_FALSE(
+      cache.Get("ciphertext", now + std::chrono::seconds(1)).has_value());
+  ASSERT_EQ(cache.Size(), 0);
+}
+
+TEST(TokenCacheTest, EvictsLeastRecentlyUsed) {
+  auto &evictions =
+      metrics::Registry::Instance().GetCounter("token_cache_evictions_total");
+  auto evicted = evictions.Value();
+  TokenCache cache(2, 1);
+  cache.Put("a", "1", later_);
+  cache.Put("b", "2", later_);
+  ASSERT_TRUE(cache.Get("a").has_value());
+  cache.Put("c", "3", later_);
+  ASSERT_EQ(cache.Size(), 2);
+  ASSERT_TRUE(cache.Get("a").has_value());
+  ASSERT_FALSE(cache.Get("b").has_value());
+  ASSERT_TRUE(cache.Get("c").has_value());
+  ASSERT_EQ(evictions.Value(), evicted + 1);
+}
+
+TEST(TokenCacheTest, Remove) {
+  TokenCache cache(16);
+  cache.Put("a", "1", later_);
+  cache.Put("b", "2", later_);
+  cache.Remove("a");
+  cache.Remove("unknown");
+  ASSERT_FALSE(cache.Get("a").has_value());
+  ASSERT_TRUE(cache.Get("b").has_value());
+  ASSERT_EQ(cache.Size(), 1);
+}
+
+}  // namespace session
+}  // namespace common
+}  // namespace authservice
@@ -1,5 +1,8 @@
 #include "src/common/session/token_encryptor.h"
+#include "absl/strings/escaping.h"
 #include "openssl/rand.h"
+#include "src/common/session/gcm_encryptor.h"
+#include "src/common/session/hkdf_deriver.h"
 
 #include "gtest/gtest.h"
 
@@ -23,6 +26,99 @@ TEST(TokenEncryptorTest, SealAndOpen) {
               plaintext);
   }
 }
+
+TEST(TokenEncryptorTest, AdditionalData) {
+  auto encryptor = TokenEncryptor::Create("secret");
+  auto ciphertext = encryptor->Encrypt("token", "first");
+  ASSERT_EQ(encryptor->Decrypt(ciphertext, "first"), "token");
+  ASSERT_FALSE(encryptor->Decrypt(ciphertext, "second").has_value());
+  ASSERT_FALSE(encryptor->Decrypt(ciphertext).has_value());
+  ASSERT_FALSE(
+      encryptor->Decrypt(encryptor->Encrypt("token"), "first").has_value());
+}
+
+TEST(TokenEncryptorTest, TokenSizes) {
+  auto encryptor = TokenEncryptor::Create("secret");
+  std::string token;
+  // Cover every length of the final base64 group.
+  for (auto i = 0; i < 64; i++) {
+    auto ciphertext = encryptor->Encrypt(token);
+    std::string decoded;
+    ASSERT_TRUE(absl::WebSafeBase64Unescape(ciphertext, &decoded));
+    ASSERT_EQ(absl::WebSafeBase64Escape(decoded), ciphertext);
+    ASSERT_EQ(decoded.size(), 1 + 4 + 12 + token.size() + 16);
+    ASSERT_EQ(encryptor->Decrypt(ciphertext), token);
+    token.push_back(static_cast<char>(i * 37));
+  }
+}
+
+TEST(TokenEncryptorTest, Algorithms) {
+  std::vector<std::pair<EncryptionAlg, char>> formats = {
+      {EncryptionAlg::AES256GCM, 1},
+      {EncryptionAlg::CHACHA20POLY1305, 2},
+      {EncryptionAlg::AES128GCM, 3}};
+  for (const auto &sealer : formats) {
+    auto encryptor =
+        TokenEncryptor::Create("secret", sealer.first, HKDFHash::SHA512);
+    auto ciphertext = encryptor->Encrypt("token");
+    std::string decoded;
+    ASSERT_TRUE(absl::WebSafeBase64Unescape(ciphertext, &decoded));
+    ASSERT_EQ(decoded[0], sealer.second);
+
+    // Tokens are interchangeable between algorithms that share a secret.
+    for (const auto &opener : formats) {
+      auto decryptor =
+          TokenEncryptor::Create("secret", opener.first, HKDFHash::SHA512);
+      ASSERT_EQ(decryptor->Decrypt(ciphertext), "token");
+    }
+
+    // The format is authenticated.
+    decoded[0] = sealer.second == 1 ? 2 : 1;
+    ASSERT_FALSE(
+        encryptor->Decrypt(absl::WebSafeBase64Escape(decoded)).has_value());
+  }
+}
+
+TEST(TokenEncryptorTest, OpenLegacy) {
+  // Legacy tokens are: derive_nonce || gcm_nonce || ciphertext || tag, where
+  // the key is derived from the secret and derive_nonce.
+  std::string secret = "secret";
+  std::string token = "token";
+  std::vector<unsigned char> derive_nonce(32);
+  ASSERT_EQ(RAND_bytes(derive_nonce.data(), derive_nonce.size()), 1);
+  auto deriver = HkdfDeriver::Create(
+      std::vector<unsigned char>(secret.begin(), secret.end()),
+      HKDFHash::SHA512);
+  auto gcm = GcmEncryptor::Create(deriver->Derive(32, derive_nonce));
+  auto sealed = gcm->Seal(std::vector<unsigned char>(token.begin(), token.end()));
+  std::string legacy(derive_nonce.begin(), derive_nonce.end());
+  legacy.append(sealed.begin(), sealed.end());
+
+  auto encryptor = TokenEncryptor::Create(
+      secret, EncryptionAlg::AES256GCM, HKDFHash::SHA512);
+  auto plaintext = encryptor->Decrypt(absl::WebSafeBase64Escape(legacy));
+  ASSERT_TRUE(plaintext.has_value());
+  ASSERT_EQ(token, *plaintext);
+}
+
+TEST(TokenEncryptorTest, VersionedFormat) {
+  auto encryptor = TokenEncryptor::Create("secret");
+  std::string decoded;
+  ASSERT_TRUE(
+      absl::WebSafeBase64Unescape(encryptor->Encrypt("token"), &decoded));
+  // version || key_id || gcm_nonce || ciphertext || tag
+  ASSERT_EQ(decoded.size(), 1 + 4 + 12 + 5 + 16);
+  ASSERT_EQ(decoded[0], 1);
+
+  // Tokens encrypted with another secret are rejected.
+  auto other = TokenEncryptor::Create("other");
+  ASSERT_FALSE(other->Decrypt(encryptor->Encrypt("token")).has_value());
+
+  // The header is authenticated.
+  decoded[1] ^= 1;
+  ASSERT_FALSE(
+      encryptor->Decrypt(absl::WebSafeBase64Escape(decoded)).has_value());
+}
 }  // namespace session
 }  // namespace common
 }  // namespace authservice
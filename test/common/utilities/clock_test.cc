@@ -0,0 +1,21 @@
+#include "src/common/utilities/clock.h"
+#include <chrono>
+#include "gtest/gtest.h"
+
+namespace authservice {
+namespace common {
+namespace utilities {
+
+TEST(Clock, CoarseUnixSeconds) {
+  auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                 std::chrono::system_clock::now().time_since_epoch())
+                 .count();
+  auto coarse = CoarseUnixSeconds();
+  // The coarse clock lags by at most a tick.
+  ASSERT_LE(coarse, now + 1);
+  ASSERT_GE(coarse, now - 1);
+}
+
+}  // namespace utilities
+}  // namespace common
+}  // namespace authservice
@@ -1,5 +1,11 @@
 #include "src/common/utilities/random.h"
+#include <sys/wait.h>
+#include <unistd.h>
 #include <algorithm>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
 #include "gtest/gtest.h"
 #include "openssl/rand.h"
 
@@ -24,6 +30,58 @@ TEST(Random, Rand) {
   }
 }
 
+TEST(Random, GenerateSizes) {
+  RandomGenerator generator;
+  std::set<std::string> seen;
+  // Cover values that span several of the generator's blocks.
+  for (size_t size : {1, 16, 32, 33, 500, 2000, 5000}) {
+    auto random = generator.Generate(size);
+    ASSERT_EQ(size, random.Size());
+    ASSERT_TRUE(seen.insert(random.Str()).second);
+  }
+}
+
+TEST(Random, ThreadsDiffer) {
+  std::vector<std::string> values(4);
+  std::vector<std::thread> threads;
+  for (auto &value : values) {
+    threads.emplace_back(
+        [&value]() { value = RandomGenerator().Generate(32).Str(); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::set<std::string> unique(values.begin(), values.end());
+  ASSERT_EQ(values.size(), unique.size());
+}
+
+TEST(Random, ForkReseeds) {
+  RandomGenerator generator;
+  // Make sure this thread's generator has buffered output before forking.
+  generator.Generate(1);
+
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  auto pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    uint8_t child[32];
+    RandomGenerator::Fill(child, sizeof(child));
+    auto written = write(fds[1], child, sizeof(child));
+    _exit(written == sizeof(child) ? 0 : 1);
+  }
+  close(fds[1]);
+  uint8_t child[32];
+  ASSERT_EQ(sizeof(child), read(fds[0], child, sizeof(child)));
+  close(fds[0]);
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+
+  uint8_t parent[32];
+  RandomGenerator::Fill(parent, sizeof(parent));
+  ASSERT_FALSE(std::equal(parent, parent + sizeof(parent), child));
+}
+
 }  // namespace utilities
 }  // namespace common
 }  // namespace authservice
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "src/filters/oidc/jwks_provider.h"
+#include <atomic>
+#include <cstdio>
+#include <future>
+#include <thread>
+#include <vector>
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "test/common/http/mocks.h"
+
+namespace authservice {
+namespace filters {
+namespace oidc {
+namespace {
+const char *jwks_ =
+    R"({"keys":[{"kty":"RSA","e":"AQAB","use":"sig","kid":"sha2-2017-01-20-key","alg":"RS256","n":"AMh-pGAj9vX2gwFDyrXot1f2YfHgh8h0Qx6w9IqLL4B7mmpCtQBR4w9faI7j4k0JvK_JxHkLR2-pg4tS72dN3hFsab1sBXxVbQsgalq-cJ-iJGPmRV3xES59jQp-rDFcXBVddrFLbqg_o61vDJ0xu4aH0KsZlVSirGYlwr1Es34isQ4KIkbg9zCUqGdJ0Ex1ZmMZRR7oUxBE7k6kj5jl3f8SQVUYuVmAo7dWikUWRM9OM1RAVYVZK9h_OKnFSR3H1xbuCTOnYNJ5k44HeXGVDXMANSoStv0K7vTdMZZPRRg9nL61Qgj1hT72dVu1OzwVjkgQR-hnq4APnZNr0K-x6JU"}]})";
+
+authservice::config::common::Endpoint JwksUri() {
+  authservice::config::common::Endpoint endpoint;
+  endpoint.set_scheme("https");
+  endpoint.set_hostname("acme-idp.tld");
+  endpoint.set_port(443);
+  endpoint.set_path("/keys");
+  return endpoint;
+}
+
+common::http::response_t JwksResponse() {
+  common::http::response_t response(
+      new beast::http::response<beast::http::string_body>());
+  response->result(beast::http::status::ok);
+  response->set(beast::http::field::cache_control, "public, max-age=3600");
+  response->body() = jwks_;
+  return response;
+}
+
+JwksSnapshotPtr WaitForKeys(const JwksProvider &provider) {
+  for (int i = 0; i < 500; ++i) {
+    auto keys = provider.Get();
+    if (keys) {
+      return keys;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return nullptr;
+}
+
+bool WaitForFetches(const std::atomic<int> &fetches, int expected) {
+  for (int i = 0; i < 500; ++i) {
+    if (fetches >= expected) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+}  // namespace
+
+TEST(JwksProviderTest, RefreshInterval) {
+  RemoteJwksProvider::Options options;
+  options.default_refresh = std::chrono::seconds(600);
+  options.min_refresh = std::chrono::seconds(60);
+  options.max_refresh = std::chrono::seconds(3600);
+  ASSERT_EQ(RemoteJwksProvider::RefreshInterval("", options).count(), 600);
+  ASSERT_EQ(
+      RemoteJwksProvider::RefreshInterval("public, max-age=120", options)
+          .count(),
+      120);
+  ASSERT_EQ(
+      RemoteJwksProvider::RefreshInterval("Max-Age=5", options).count(), 60);
+  ASSERT_EQ(
+      RemoteJwksProvider::RefreshInterval("max-age=86400", options).count(),
+      3600);
+  ASSERT_EQ(
+      RemoteJwksProvider::RefreshInterval("max-age=abc", options).count(),
+      600);
+  ASSERT_EQ(
+      RemoteJwksProvider::RefreshInterval("no-cache, max-age=120", options)
+          .count(),
+      60);
+}
+
+TEST(JwksProviderTest, Static) {
+  StaticJwksProvider provider(google::jwt_verify::Jwks::createFrom(
+      jwks_, google::jwt_verify::Jwks::Type::JWKS));
+  ASSERT_NE(provider.Get(), nullptr);
+  ASSERT_EQ(provider.Get(), provider.Get());
+}
+
+TEST(JwksProviderTest, RemoteFetchesAndSnapshots) {
+  auto snapshot = ::testing::TempDir() + "/jwks_provider_test_snapshot.json";
+  std::remove(snapshot.c_str());
+
+  auto http = std::make_shared<common::http::http_mock>();
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_))
+      .WillRepeatedly(::testing::Invoke(
+          [](const authservice::config::common::Endpoint &,
+             const std::map<absl::string_view, absl::string_view> &) {
+            return JwksResponse();
+          }));
+  {
+    RemoteJwksProvider provider(http, JwksUri(), snapshot);
+    auto keys = WaitForKeys(provider);
+    ASSERT_NE(keys, nullptr);
+    ASSERT_EQ(keys->getStatus(), google::jwt_verify::Status::Ok);
+  }
+
+  // A new provider serves the snapshot straight away, even if the IdP cannot
+  // be reached.
+  auto unreachable = std::make_shared<common::http::http_mock>();
+  EXPECT_CALL(*unreachable, Get(::testing::_, ::testing::_))
+      .WillRepeatedly(::testing::Invoke(
+          [](const authservice::config::common::Endpoint &,
+             const std::map<absl::string_view, absl::string_view> &) {
+            return common::http::response_t();
+          }));
+  RemoteJwksProvider provider(unreachable, JwksUri(), snapshot);
+  ASSERT_NE(provider.Get(), nullptr);
+}
+
+TEST(JwksProviderTest, RemoteWithoutSnapshot) {
+  auto http = std::make_shared<common::http::http_mock>();
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_))
+      .WillRepeatedly(::testing::Invoke(
+          [](const authservice::config::common::Endpoint &,
+             const std::map<absl::string_view, absl::string_view> &) {
+            return common::http::response_t();
+          }));
+  RemoteJwksProvider provider(http, JwksUri(), "");
+  ASSERT_EQ(provider.Get(), nullptr);
+}
+
+TEST(JwksProviderTest, RemoteRefreshIsCoalesced) {
+  std::atomic<int> fetches(0);
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  auto http = std::make_shared<common::http::http_mock>();
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_))
+      .WillRepeatedly(::testing::Invoke(
+          [&fetches, released](
+              const authservice::config::common::Endpoint &,
+              const std::map<absl::string_view, absl::string_view> &) {
+            if (++fetches > 1) {
+              released.wait();
+            }
+            return JwksResponse();
+          }));
+  RemoteJwksProvider::Options options;
+  options.min_refetch = std::chrono::seconds(0);
+  RemoteJwksProvider provider(http, JwksUri(), "", options);
+  ASSERT_NE(WaitForKeys(provider), nullptr);
+  ASSERT_EQ(fetches, 1);
+
+  // Refreshes return the current key set without waiting on the fetch.
+  ASSERT_NE(provider.Refresh("unknown"), nullptr);
+  ASSERT_TRUE(WaitForFetches(fetches, 2));
+
+  // Refreshes made whilst the fetch is in progress are coalesced into the
+  // next one.
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&provider, i]() {
+      ASSERT_NE(provider.Refresh(i % 2 ? "first" : "second"), nullptr);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  release.set_value();
+  ASSERT_TRUE(WaitForFetches(fetches, 3));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_EQ(fetches, 3);
+
+  // The key ids are not refreshed for again, but others are.
+  ASSERT_NE(provider.Refresh("unknown"), nullptr);
+  ASSERT_NE(provider.Refresh("first"), nullptr);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_EQ(fetches, 3);
+  ASSERT_NE(provider.Refresh("another"), nullptr);
+  ASSERT_TRUE(WaitForFetches(fetches, 4));
+}
+
+TEST(JwksProviderTest, RemoteRefreshIsDeferredByMinRefetch) {
+  std::atomic<int> fetches(0);
+  auto http = std::make_shared<common::http::http_mock>();
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_))
+      .WillRepeatedly(::testing::Invoke(
+          [&fetches](const authservice::config::common::Endpoint &,
+                     const std::map<absl::string_view, absl::string_view> &) {
+            ++fetches;
+            return JwksResponse();
+          }));
+  RemoteJwksProvider::Options options;
+  options.min_refetch = std::chrono::seconds(1);
+  RemoteJwksProvider provider(http, JwksUri(), "", options);
+  ASSERT_NE(WaitForKeys(provider), nullptr);
+
+  // A made up key id triggers a fetch, which must not stop the key id of a
+  // real rotation from being fetched for soon after.
+  ASSERT_NE(provider.Refresh("made-up"), nullptr);
+  ASSERT_TRUE(WaitForFetches(fetches, 2));
+  ASSERT_NE(provider.Refresh("rotated"), nullptr);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_EQ(fetches, 2);
+  ASSERT_TRUE(WaitForFetches(fetches, 3));
+}
+
+TEST(JwksProviderTest, RemoteRefreshHonoursMinRefetch) {
+  std::atomic<int> fetches(0);
+  auto http = std::make_shared<common::http::http_mock>();
+  EXPECT_CALL(*http, Get(::testing::_, ::testing::_))
+      .WillRepeatedly(::testing::Invoke(
+          [&fetches](const authservice::config::common::Endpoint &,
+                     const std::map<absl::string_view, absl::string_view> &) {
+            ++fetches;
+            return JwksResponse();
+          }));
+  RemoteJwksProvider provider(http, JwksUri(), "");
+  ASSERT_NE(WaitForKeys(provider), nullptr);
+  ASSERT_NE(provider.Refresh("unknown"), nullptr);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_EQ(fetches, 1);
+}
+
+}  // namespace oidc
+}  // namespace filters
+}  // namespace authservice
@@ -0,0 +1,99 @@
+#include "src/filters/oidc/login_state_pool.h"
+#include <set>
+#include <thread>
+#include <vector>
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "src/filters/oidc/state_cookie_codec.h"
+#include "test/common/session/mocks.h"
+
+namespace authservice {
+namespace filters {
+namespace oidc {
+
+using ::testing::_;
+using ::testing::Invoke;
+
+namespace {
+// Use the encoded state cookie as its "encryption" so that tests can check
+// that it matches the state and nonce.
+std::shared_ptr<common::session::TokenEncryptorMock> IdentityEncryptor() {
+  auto cryptor = std::make_shared<common::session::TokenEncryptorMock>();
+  ON_CALL(*cryptor, Encrypt(_))
+      .WillByDefault(Invoke([](const std::string &token) { return token; }));
+  EXPECT_CALL(*cryptor, Encrypt(_)).Times(::testing::AnyNumber());
+  return cryptor;
+}
+
+void WaitForSize(const LoginStatePool &pool, size_t size) {
+  for (int i = 0; i < 1000 && pool.Size() < size; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+}
+}  // namespace
+
+TEST(LoginStatePoolTest, Generate) {
+  auto cryptor = IdentityEncryptor();
+  auto login = LoginState::Generate(*cryptor);
+  ASSERT_EQ(login.state.size(), 43);
+  ASSERT_EQ(login.nonce.size(), 43);
+  ASSERT_NE(login.state, login.nonce);
+  StateCookieCodec codec;
+  ASSERT_EQ(login.cookie, codec.Encode(login.state, login.nonce));
+}
+
+TEST(LoginStatePoolTest, FillsAndDrains) {
+  auto cryptor = IdentityEncryptor();
+  LoginStatePool pool(cryptor, 5);
+  ASSERT_EQ(pool.Capacity(), 8);
+  WaitForSize(pool, pool.Capacity());
+  ASSERT_EQ(pool.Size(), pool.Capacity());
+
+  std::set<std::string> states;
+  StateCookieCodec codec;
+  for (size_t i = 0; i < pool.Capacity(); ++i) {
+    auto login = pool.Pop();
+    ASSERT_TRUE(login.has_value());
+    ASSERT_EQ(login->cookie, codec.Encode(login->state, login->nonce));
+    ASSERT_TRUE(states.insert(login->state).second);
+  }
+
+  // The pool is refilled once drained.
+  WaitForSize(pool, pool.Capacity());
+  ASSERT_EQ(pool.Size(), pool.Capacity());
+}
+
+TEST(LoginStatePoolTest, ConcurrentPopsAreUnique) {
+  auto cryptor = IdentityEncryptor();
+  LoginStatePool pool(cryptor, 64);
+  WaitForSize(pool, pool.Capacity());
+
+  std::vector<std::vector<std::string>> taken(4);
+  std::vector<std::thread> threads;
+  for (auto &states : taken) {
+    threads.emplace_back([&pool, &states]() {
+      for (int i = 0; i < 200; ++i) {
+        auto login = pool.Pop();
+        if (login.has_value()) {
+          states.push_back(login->state);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  std::set<std::string> unique;
+  size_t count = 0;
+  for (const auto &states : taken) {
+    unique.insert(states.begin(), states.end());
+    count += states.size();
+  }
+  ASSERT_GE(count, pool.Capacity());
+  ASSERT_EQ(unique.size(), count);
+}
+
+}  // namespace oidc
+}  // namespace filters
+}  // namespace authservice
@@ -1,10 +1,14 @@
 #include "src/filters/oidc/oidc_filter.h"
+#include <map>
 #include <regex>
 #include "absl/strings/str_join.h"
+#include "absl/time/clock.h"
 #include "external/com_google_googleapis/google/rpc/code.pb.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "src/common/http/headers.h"
+#include "src/common/session/compact_token.h"
+#include "src/common/session/in_memory_session_store.h"
 #include "test/common/http/mocks.h"
 #include "test/common/session/mocks.h"
 #include "test/filters/oidc/mocks.h"
@@ -274,6 +278,78 @@ TEST_F(OidcFilterTest, ValidIdToken) {
                response.ok_response().headers()[0].header().value().c_str());
 }
 
+TEST_F(OidcFilterTest, ValidCompactIdToken) {
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  OidcFilter filter(common::http::ptr_t(), config_, parser_mock, cryptor_mock);
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("https");
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-id-token-cookie=valid"});
+  const std::string jwt =
+      "eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCJ9."
+      "eyJpc3MiOiJodHRwczovL2FjbWUtaWRwLnRsZCIsInN1YiI6InVzZXIifQ."
+      "c2lnbmF0dXJlLWJ5dGVzLXNpZ25hdHVyZS1ieXRlcw";
+  auto compact = common::session::CompactToken(jwt);
+  ASSERT_NE(compact, jwt);
+  EXPECT_CALL(*cryptor_mock, Decrypt("valid"))
+      .WillOnce(::testing::Return(absl::optional<std::string>(compact)));
+
+  auto status = filter.Process(&request, &response);
+  ASSERT_EQ(status, google::rpc::Code::OK);
+  ASSERT_EQ(response.ok_response().headers().size(), 1);
+  ASSERT_EQ("Bearer " + jwt,
+            response.ok_response().headers()[0].header().value());
+}
+
+TEST_F(OidcFilterTest, ExpiredIdToken) {
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  OidcFilter filter(common::http::ptr_t(), config_, parser_mock, cryptor_mock,
+                    std::make_shared<common::session::TokenCache>(16));
+  auto now = absl::ToUnixSeconds(absl::Now());
+  // Tokens are refused from the time stored with them.
+  for (auto expiry : {now - 10, now - 1}) {
+    ::envoy::service::auth::v2::CheckRequest request;
+    ::envoy::service::auth::v2::CheckResponse response;
+    auto httpRequest =
+        request.mutable_attributes()->mutable_request()->mutable_http();
+    httpRequest->set_scheme("https");
+    httpRequest->mutable_headers()->insert(
+        {common::http::headers::Cookie,
+         "__Host-cookie-prefix-authservice-id-token-cookie=valid"});
+    EXPECT_CALL(*cryptor_mock, Decrypt("valid"))
+        .WillOnce(::testing::Return(absl::optional<std::string>(
+            common::session::CompactToken("secret", expiry))));
+    EXPECT_CALL(*cryptor_mock, Encrypt(::testing::_))
+        .WillOnce(::testing::Return("encrypted"));
+    auto status = filter.Process(&request, &response);
+    ASSERT_EQ(status, google::rpc::Code::UNAUTHENTICATED);
+    ASSERT_EQ(response.denied_response().status().code(),
+              ::envoy::type::StatusCode::Found);
+  }
+
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("https");
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-id-token-cookie=valid"});
+  EXPECT_CALL(*cryptor_mock, Decrypt("valid"))
+      .WillOnce(::testing::Return(absl::optional<std::string>(
+          common::session::CompactToken("secret", now + 3600))));
+  auto status = filter.Process(&request, &response);
+  ASSERT_EQ(status, google::rpc::Code::OK);
+  ASSERT_STREQ("Bearer secret",
+               response.ok_response().headers()[0].header().value().c_str());
+}
+
 TEST_F(OidcFilterTest, MissingAccessToken) {
   config_.mutable_access_token()->set_header("access_token");
   auto parser_mock = std::make_shared<TokenResponseParserMock>();
@@ -400,6 +476,39 @@ TEST_F(OidcFilterTest, ValidIdAndAccessTokens) {
                response.ok_response().headers()[1].header().value().c_str());
 }
 
+TEST_F(OidcFilterTest, CachedTokens) {
+  config_.mutable_access_token()->set_header("access_token");
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  OidcFilter filter(common::http::ptr_t(), config_, parser_mock, cryptor_mock,
+                    std::make_shared<common::session::TokenCache>(16));
+  ::envoy::service::auth::v2::CheckRequest request;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("https");
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-id-token-cookie=identity; "
+       "__Host-cookie-prefix-authservice-access-token-cookie=access"});
+  // Each cookie is only decrypted once.
+  EXPECT_CALL(*cryptor_mock, Decrypt("identity"))
+      .WillOnce(::testing::Return(absl::optional<std::string>("id_secret")));
+  EXPECT_CALL(*cryptor_mock, Decrypt("access"))
+      .WillOnce(
+          ::testing::Return(absl::optional<std::string>("access_secret")));
+
+  for (int i = 0; i < 2; ++i) {
+    ::envoy::service::auth::v2::CheckResponse response;
+    auto status = filter.Process(&request, &response);
+    ASSERT_EQ(status, google::rpc::Code::OK);
+    ASSERT_EQ(response.ok_response().headers().size(), 2);
+    ASSERT_STREQ("Bearer id_secret",
+                 response.ok_response().headers()[0].header().value().c_str());
+    ASSERT_STREQ("access_secret",
+                 response.ok_response().headers()[1].header().value().c_str());
+  }
+}
+
 TEST_F(OidcFilterTest, RetrieveTokenWithOutAccessToken) {
   google::jwt_verify::Jwt jwt = {};
   auto parser_mock = std::make_shared<TokenResponseParserMock>();
@@ -532,6 +641,311 @@ TEST_F(OidcFilterTest, RetrieveTokenWithAccessToken) {
   }
 }
 
+TEST_F(OidcFilterTest, RetrieveTokenAppliesExpirySkew) {
+  config_.mutable_access_token()->set_header("access_token");
+  config_.set_expiry_skew(60);
+  auto now = absl::ToUnixSeconds(absl::Now());
+  google::jwt_verify::Jwt jwt = {};
+  jwt.jwt_ = "expected_id_token";
+  jwt.exp_ = now + 3600;
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  auto token_response = absl::make_optional<TokenResponse>(jwt);
+  token_response->SetAccessToken("expected_access_token");
+  // The access token expires sooner than the skew.
+  token_response->SetExpiry(now + 30);
+  EXPECT_CALL(*parser_mock, Parse(config_.client_id(), ::testing::_, ::testing::_))
+      .WillOnce(::testing::Return(token_response));
+  common::http::http_mock *mocked_http = new common::http::http_mock();
+  auto raw_http = common::http::response_t(
+      new beast::http::response<beast::http::string_body>());
+  raw_http->result(beast::http::status::ok);
+  EXPECT_CALL(*mocked_http, Post(::testing::_, ::testing::_, ::testing::_))
+      .WillOnce(::testing::Return(::testing::ByMove(std::move(raw_http))));
+  OidcFilter filter(common::http::ptr_t(mocked_http), config_, parser_mock,
+                    cryptor_mock);
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("");
+  httpRequest->set_host(config_.callback().hostname());
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-state-cookie=valid"});
+  EXPECT_CALL(*cryptor_mock, Decrypt("valid"))
+      .WillOnce(::testing::Return(
+          absl::optional<std::string>("expectedstate;expectednonce")));
+  std::map<std::string, int64_t> refused;
+  EXPECT_CALL(*cryptor_mock, Encrypt(::testing::_))
+      .Times(2)
+      .WillRepeatedly(::testing::Invoke([&refused](const std::string &token) {
+        absl::optional<int64_t> expiry;
+        auto expanded = common::session::ExpandToken(token, expiry);
+        if (expanded.has_value() && expiry.has_value()) {
+          refused[*expanded] = *expiry;
+        }
+        return std::string("encryptedtoken");
+      }));
+  std::vector<absl::string_view> parts = {config_.callback().path().c_str(),
+                                          "code=value&state=expectedstate"};
+  httpRequest->set_path(absl::StrJoin(parts, "?"));
+  auto code = filter.Process(&request, &response);
+  ASSERT_EQ(code, google::rpc::Code::UNAUTHENTICATED);
+
+  // Tokens are refused from expiry_skew seconds before they expire, unless
+  // that would refuse them straight away.
+  ASSERT_EQ(refused["expected_id_token"], now + 3600 - 60);
+  ASSERT_EQ(refused["expected_access_token"], now + 30);
+}
+
+TEST_F(OidcFilterTest, RetrieveLargeTokenIntoChunks) {
+  google::jwt_verify::Jwt jwt = {};
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  auto token_response = absl::make_optional<TokenResponse>(jwt);
+  EXPECT_CALL(*parser_mock, Parse(config_.client_id(), ::testing::_, ::testing::_))
+      .WillOnce(::testing::Return(token_response));
+  common::http::http_mock *mocked_http = new common::http::http_mock();
+  auto raw_http = common::http::response_t(
+      new beast::http::response<beast::http::string_body>());
+  raw_http->result(beast::http::status::ok);
+  EXPECT_CALL(*mocked_http, Post(::testing::_, ::testing::_, ::testing::_))
+      .WillOnce(::testing::Return(::testing::ByMove(std::move(raw_http))));
+  OidcFilter filter(common::http::ptr_t(mocked_http), config_, parser_mock,
+                    cryptor_mock);
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_host(config_.callback().hostname());
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-state-cookie=valid"});
+  EXPECT_CALL(*cryptor_mock, Decrypt("valid"))
+      .WillOnce(::testing::Return(
+          absl::optional<std::string>("expectedstate;expectednonce")));
+  const std::string encrypted(10000, 'x');
+  EXPECT_CALL(*cryptor_mock, Encrypt(::testing::_))
+      .WillOnce(::testing::Return(encrypted));
+  std::vector<absl::string_view> parts = {config_.callback().path().c_str(),
+                                          "code=value&state=expectedstate"};
+  httpRequest->set_path(absl::StrJoin(parts, "?"));
+  auto code = filter.Process(&request, &response);
+  ASSERT_EQ(code, google::rpc::Code::UNAUTHENTICATED);
+
+  // The token is split over three chunks, and any whole cookie left by an
+  // earlier login is deleted.
+  std::regex chunk_re("^__Host-cookie-prefix-authservice-id-token-cookie-"
+                      "([0-9])=([0-9x.]+); HttpOnly; Max-Age=[0-9]+; "
+                      "Path=/; SameSite=Lax; Secure$");
+  std::vector<std::string> chunks;
+  bool deleted = false;
+  for (auto iter : response.denied_response().headers()) {
+    if (iter.header().key() != common::http::headers::SetCookie) {
+      continue;
+    }
+    const auto &val = iter.header().value();
+    std::smatch match;
+    if (std::regex_match(val, match, chunk_re)) {
+      ASSERT_LE(val.size(), 4096);
+      ASSERT_EQ(match[1].str(), std::to_string(chunks.size()));
+      chunks.push_back(match[2].str());
+    } else if (val ==
+               "__Host-cookie-prefix-authservice-id-token-cookie=deleted; "
+               "HttpOnly; Max-Age=0; Path=/; SameSite=Lax; Secure") {
+      deleted = true;
+    }
+  }
+  ASSERT_TRUE(deleted);
+  ASSERT_EQ(chunks.size(), 3);
+  ASSERT_EQ(absl::StrJoin(chunks, ""), "3." + encrypted);
+}
+
+TEST_F(OidcFilterTest, ValidChunkedIdToken) {
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  OidcFilter filter(common::http::ptr_t(), config_, parser_mock, cryptor_mock);
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("https");
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-id-token-cookie-1=lid; "
+       "__Host-cookie-prefix-authservice-id-token-cookie-0=2.va"});
+  EXPECT_CALL(*cryptor_mock, Decrypt("valid"))
+      .WillOnce(::testing::Return(absl::optional<std::string>("secret")));
+
+  auto status = filter.Process(&request, &response);
+  ASSERT_EQ(status, google::rpc::Code::OK);
+  ASSERT_EQ(response.ok_response().headers().size(), 1);
+  ASSERT_STREQ("Bearer secret",
+               response.ok_response().headers()[0].header().value().c_str());
+}
+
+TEST_F(OidcFilterTest, RetrieveTokenIntoSession) {
+  config_.mutable_access_token()->set_header("access_token");
+  google::jwt_verify::Jwt jwt = {};
+  jwt.jwt_ = "expected_id_token";
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  auto token_response = absl::make_optional<TokenResponse>(jwt);
+  token_response->SetAccessToken("expected_access_token");
+  EXPECT_CALL(*parser_mock, Parse(config_.client_id(), ::testing::_, ::testing::_))
+      .WillOnce(::testing::Return(token_response));
+  common::http::http_mock *mocked_http = new common::http::http_mock();
+  auto raw_http = common::http::response_t(
+      new beast::http::response<beast::http::string_body>());
+  raw_http->result(beast::http::status::ok);
+  EXPECT_CALL(*mocked_http, Post(::testing::_, ::testing::_, ::testing::_))
+      .WillOnce(::testing::Return(::testing::ByMove(std::move(raw_http))));
+  auto session_store =
+      std::make_shared<common::session::InMemorySessionStore>();
+  OidcFilter filter(common::http::ptr_t(mocked_http), config_, parser_mock,
+                    cryptor_mock, nullptr, nullptr, session_store);
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("");
+  httpRequest->set_host(config_.callback().hostname());
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-state-cookie=valid"});
+  EXPECT_CALL(*cryptor_mock, Decrypt("valid"))
+      .WillOnce(::testing::Return(
+          absl::optional<std::string>("expectedstate;expectednonce")));
+  // The tokens are not sent to the browser.
+  EXPECT_CALL(*cryptor_mock, Encrypt(::testing::_)).Times(0);
+  std::vector<absl::string_view> parts = {config_.callback().path().c_str(),
+                                          "code=value&state=expectedstate"};
+  httpRequest->set_path(absl::StrJoin(parts, "?"));
+  auto code = filter.Process(&request, &response);
+  ASSERT_EQ(code, google::rpc::Code::UNAUTHENTICATED);
+
+  ASSERT_EQ(response.denied_response().headers().size(), 5);
+  std::string session_cookie;
+  std::regex session_re("^(__Host-cookie-prefix-authservice-session-cookie="
+                        "[A-Za-z0-9_-]{22}); HttpOnly; Max-Age=[0-9]+; "
+                        "Path=/; SameSite=Lax; Secure$");
+  for (auto iter : response.denied_response().headers()) {
+    std::smatch match;
+    if (iter.header().key() == common::http::headers::SetCookie &&
+        std::regex_match(iter.header().value(), match, session_re)) {
+      session_cookie = match[1];
+    }
+  }
+  ASSERT_FALSE(session_cookie.empty());
+  ASSERT_EQ(session_store->Size(), 1);
+
+  // The session cookie alone authenticates later requests.
+  ::envoy::service::auth::v2::CheckRequest next_request;
+  ::envoy::service::auth::v2::CheckResponse next_response;
+  auto next_http =
+      next_request.mutable_attributes()->mutable_request()->mutable_http();
+  next_http->set_scheme("https");
+  next_http->mutable_headers()->insert(
+      {common::http::headers::Cookie, session_cookie});
+  code = filter.Process(&next_request, &next_response);
+  ASSERT_EQ(code, google::rpc::Code::OK);
+  ASSERT_EQ(next_response.ok_response().headers().size(), 2);
+  ASSERT_STREQ("Bearer expected_id_token",
+               next_response.ok_response().headers()[0].header().value().c_str());
+  ASSERT_STREQ("expected_access_token",
+               next_response.ok_response().headers()[1].header().value().c_str());
+}
+
+TEST_F(OidcFilterTest, RetrieveTokenIntoSessionWithLongExpirySkew) {
+  config_.set_expiry_skew(3600);
+  google::jwt_verify::Jwt jwt = {};
+  jwt.jwt_ = "expected_id_token";
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  auto token_response = absl::make_optional<TokenResponse>(jwt);
+  token_response->SetExpiry(absl::ToUnixSeconds(absl::Now()) + 300);
+  EXPECT_CALL(*parser_mock, Parse(config_.client_id(), ::testing::_, ::testing::_))
+      .WillOnce(::testing::Return(token_response));
+  common::http::http_mock *mocked_http = new common::http::http_mock();
+  auto raw_http = common::http::response_t(
+      new beast::http::response<beast::http::string_body>());
+  raw_http->result(beast::http::status::ok);
+  EXPECT_CALL(*mocked_http, Post(::testing::_, ::testing::_, ::testing::_))
+      .WillOnce(::testing::Return(::testing::ByMove(std::move(raw_http))));
+  auto session_store =
+      std::make_shared<common::session::InMemorySessionStore>();
+  OidcFilter filter(common::http::ptr_t(mocked_http), config_, parser_mock,
+                    cryptor_mock, nullptr, nullptr, session_store);
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("");
+  httpRequest->set_host(config_.callback().hostname());
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-state-cookie=valid"});
+  EXPECT_CALL(*cryptor_mock, Decrypt("valid"))
+      .WillOnce(::testing::Return(
+          absl::optional<std::string>("expectedstate;expectednonce")));
+  std::vector<absl::string_view> parts = {config_.callback().path().c_str(),
+                                          "code=value&state=expectedstate"};
+  httpRequest->set_path(absl::StrJoin(parts, "?"));
+  ASSERT_EQ(filter.Process(&request, &response),
+            google::rpc::Code::UNAUTHENTICATED);
+
+  // A skew longer than the token's lifetime is ignored, rather than issuing a
+  // session that has already expired.
+  std::string session_cookie;
+  std::regex session_re("^(__Host-cookie-prefix-authservice-session-cookie="
+                        "[A-Za-z0-9_-]{22}); HttpOnly; Max-Age=([0-9]+); "
+                        "Path=/; SameSite=Lax; Secure$");
+  for (auto iter : response.denied_response().headers()) {
+    std::smatch match;
+    if (iter.header().key() == common::http::headers::SetCookie &&
+        std::regex_match(iter.header().value(), match, session_re)) {
+      session_cookie = match[1];
+      ASSERT_GT(std::stoi(match[2].str()), 0);
+    }
+  }
+  ASSERT_FALSE(session_cookie.empty());
+
+  ::envoy::service::auth::v2::CheckRequest next_request;
+  ::envoy::service::auth::v2::CheckResponse next_response;
+  auto next_http =
+      next_request.mutable_attributes()->mutable_request()->mutable_http();
+  next_http->set_scheme("https");
+  next_http->mutable_headers()->insert(
+      {common::http::headers::Cookie, session_cookie});
+  ASSERT_EQ(filter.Process(&next_request, &next_response),
+            google::rpc::Code::OK);
+}
+
+TEST_F(OidcFilterTest, UnknownSession) {
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  OidcFilter filter(common::http::ptr_t(), config_, parser_mock, cryptor_mock,
+                    nullptr, nullptr,
+                    std::make_shared<common::session::InMemorySessionStore>());
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("https");
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-session-cookie=unknown"});
+  EXPECT_CALL(*cryptor_mock, Encrypt(::testing::_))
+      .WillOnce(::testing::Return("encryptedstate"));
+
+  // An unknown session starts a new login.
+  auto status = filter.Process(&request, &response);
+  ASSERT_EQ(status, google::rpc::Code::UNAUTHENTICATED);
+  ASSERT_EQ(response.denied_response().status().code(),
+            ::envoy::type::StatusCode::Found);
+}
+
 TEST_F(OidcFilterTest, RetrieveTokenMissingAccessToken) {
   config_.mutable_access_token()->set_header("access_token");
   google::jwt_verify::Jwt jwt = {};
@@ -925,6 +1339,99 @@ TEST_F(OidcFilterTest, RetrieveTokenInvalidResponse) {
   }
 }
 
+TEST_F(OidcFilterTest, RetrieveTokenAsync) {
+  google::jwt_verify::Jwt jwt = {};
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  auto token_response = absl::make_optional<TokenResponse>(jwt);
+  token_response->SetExpiry(3600);
+  EXPECT_CALL(*parser_mock, Parse(config_.client_id(), "expectednonce",
+                                  ::testing::_))
+      .WillOnce(::testing::Return(token_response));
+  common::http::http_mock *http_mock = new common::http::http_mock();
+  common::http::callback_t token_callback;
+  EXPECT_CALL(*http_mock, PostAsync(::testing::_, ::testing::_, ::testing::_,
+                                    ::testing::_, ::testing::_))
+      .WillOnce(::testing::DoAll(::testing::SaveArg<4>(&token_callback),
+                                 ::testing::Return(nullptr)));
+  OidcFilter filter(common::http::ptr_t(http_mock), config_, parser_mock,
+                    cryptor_mock);
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("https");
+  httpRequest->set_host(config_.callback().hostname());
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-state-cookie=valid"});
+  EXPECT_CALL(*cryptor_mock, Decrypt("valid"))
+      .WillOnce(::testing::Return(
+          absl::optional<std::string>("expectedstate;expectednonce")));
+  EXPECT_CALL(*cryptor_mock, Encrypt(::testing::_))
+      .WillOnce(::testing::Return("encryptedtoken"));
+  std::vector<absl::string_view> parts = {config_.callback().path().c_str(),
+                                          "code=value&state=expectedstate"};
+  httpRequest->set_path(absl::StrJoin(parts, "?"));
+
+  int calls = 0;
+  google::rpc::Code code = google::rpc::Code::OK;
+  filter.ProcessAsync(&request, &response, [&](google::rpc::Code result) {
+    calls++;
+    code = result;
+  });
+  // Processing is suspended until the token endpoint responds.
+  ASSERT_EQ(calls, 0);
+  ASSERT_TRUE(token_callback);
+
+  auto raw_http = common::http::response_t(
+      new beast::http::response<beast::http::string_body>());
+  raw_http->result(beast::http::status::ok);
+  token_callback(std::move(raw_http));
+  ASSERT_EQ(calls, 1);
+  ASSERT_EQ(code, google::rpc::Code::UNAUTHENTICATED);
+  // Cache control, pragma, location and the state and id token cookies.
+  ASSERT_EQ(response.denied_response().headers().size(), 5);
+}
+
+TEST_F(OidcFilterTest, RetrieveTokenAsyncBrokenPipe) {
+  auto parser_mock = std::make_shared<TokenResponseParserMock>();
+  auto cryptor_mock = std::make_shared<common::session::TokenEncryptorMock>();
+  common::http::http_mock *http_mock = new common::http::http_mock();
+  EXPECT_CALL(*http_mock, PostAsync(::testing::_, ::testing::_, ::testing::_,
+                                    ::testing::_, ::testing::_))
+      .WillOnce(::testing::Invoke(
+          [](const authservice::config::common::Endpoint &,
+             const std::map<absl::string_view, absl::string_view> &,
+             absl::string_view, std::chrono::milliseconds,
+             common::http::callback_t callback) {
+            callback(nullptr);
+            return nullptr;
+          }));
+  OidcFilter filter(common::http::ptr_t(http_mock), config_, parser_mock,
+                    cryptor_mock);
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  auto httpRequest =
+      request.mutable_attributes()->mutable_request()->mutable_http();
+  httpRequest->set_scheme("https");
+  httpRequest->set_host(config_.callback().hostname());
+  httpRequest->mutable_headers()->insert(
+      {common::http::headers::Cookie,
+       "__Host-cookie-prefix-authservice-state-cookie=valid"});
+  EXPECT_CALL(*cryptor_mock, Decrypt("valid"))
+      .WillOnce(::testing::Return(
+          absl::optional<std::string>("expectedstate;expectednonce")));
+  std::vector<absl::string_view> parts = {config_.callback().path().c_str(),
+                                          "code=value&state=expectedstate"};
+  httpRequest->set_path(absl::StrJoin(parts, "?"));
+  google::rpc::Code code = google::rpc::Code::OK;
+  filter.ProcessAsync(&request, &response,
+                      [&code](google::rpc::Code result) { code = result; });
+  ASSERT_EQ(code, google::rpc::Code::INTERNAL);
+  ASSERT_EQ(response.denied_response().headers().size(), 3);
+}
+
 }  // namespace oidc
 }  // namespace filters
 }  // namespace authservice
@@ -3,10 +3,142 @@
 
 namespace authservice {
 namespace filters {
+namespace {
+class StaticFilter final : public Filter {
+ private:
+  std::string name_;
+  google::rpc::Code code_;
+
+ public:
+  StaticFilter(const std::string &name, google::rpc::Code code)
+      : name_(name), code_(code) {}
+
+  google::rpc::Code Process(
+      const ::envoy::service::auth::v2::CheckRequest *,
+      ::envoy::service::auth::v2::CheckResponse *) override {
+    return code_;
+  }
+
+  absl::string_view Name() const override { return name_; }
+};
+
+// Completes asynchronous processing only when told to.
+class DeferredFilter final : public Filter {
+ private:
+  std::string name_;
+
+ public:
+  std::vector<ProcessCallback> pending;
+
+  explicit DeferredFilter(const std::string &name) : name_(name) {}
+
+  google::rpc::Code Process(
+      const ::envoy::service::auth::v2::CheckRequest *,
+      ::envoy::service::auth::v2::CheckResponse *) override {
+    return google::rpc::Code::INTERNAL;
+  }
+
+  void ProcessAsync(const ::envoy::service::auth::v2::CheckRequest *,
+                    ::envoy::service::auth::v2::CheckResponse *,
+                    ProcessCallback callback) override {
+    pending.push_back(callback);
+  }
+
+  absl::string_view Name() const override { return name_; }
+};
+}  // namespace
+
 TEST(PipeTest, Name) {
   Pipe pipe;
   ASSERT_EQ(pipe.Name().compare("pipe"), 0);
 }
 
+TEST(PipeTest, ProcessEmpty) {
+  Pipe pipe;
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  ASSERT_EQ(pipe.Process(&request, &response), google::rpc::Code::OK);
+  ASSERT_EQ(response.status().code(), google::rpc::Code::OK);
+}
+
+TEST(PipeTest, ProcessStopsAtFirstFailure) {
+  Pipe pipe;
+  pipe.AddFilter(FilterPtr(new StaticFilter("first", google::rpc::Code::OK)))
+      ->AddFilter(FilterPtr(
+          new StaticFilter("second", google::rpc::Code::UNAUTHENTICATED)))
+      ->AddFilter(FilterPtr(
+          new StaticFilter("third", google::rpc::Code::PERMISSION_DENIED)));
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  ASSERT_EQ(pipe.Process(&request, &response),
+            google::rpc::Code::UNAUTHENTICATED);
+  ASSERT_EQ(response.status().code(), google::rpc::Code::UNAUTHENTICATED);
+  ASSERT_EQ(response.status().message(), "second");
+}
+
+TEST(PipeTest, Remove) {
+  Pipe pipe;
+  pipe.AddFilter(FilterPtr(
+          new StaticFilter("denied", google::rpc::Code::PERMISSION_DENIED)))
+      ->AddFilter(FilterPtr(
+          new StaticFilter("denied", google::rpc::Code::PERMISSION_DENIED)))
+      ->AddFilter(FilterPtr(new StaticFilter("ok", google::rpc::Code::OK)));
+  pipe.Remove("denied");
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  ASSERT_EQ(pipe.Process(&request, &response), google::rpc::Code::OK);
+}
+
+TEST(PipeTest, ProcessAsyncUsesSynchronousFilters) {
+  Pipe pipe;
+  pipe.AddFilter(FilterPtr(new StaticFilter("first", google::rpc::Code::OK)))
+      ->AddFilter(FilterPtr(
+          new StaticFilter("second", google::rpc::Code::PERMISSION_DENIED)));
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  google::rpc::Code result = google::rpc::Code::UNKNOWN;
+  pipe.ProcessAsync(&request, &response,
+                    [&result](google::rpc::Code code) { result = code; });
+  ASSERT_EQ(result, google::rpc::Code::PERMISSION_DENIED);
+  ASSERT_EQ(response.status().message(), "second");
+}
+
+TEST(PipeTest, ProcessAsyncResumesAfterDeferredFilter) {
+  Pipe pipe;
+  auto deferred = new DeferredFilter("deferred");
+  pipe.AddFilter(FilterPtr(deferred))
+      ->AddFilter(FilterPtr(
+          new StaticFilter("denied", google::rpc::Code::PERMISSION_DENIED)));
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  int calls = 0;
+  google::rpc::Code result = google::rpc::Code::UNKNOWN;
+  pipe.ProcessAsync(&request, &response, [&](google::rpc::Code code) {
+    calls++;
+    result = code;
+  });
+  ASSERT_EQ(calls, 0);
+  ASSERT_EQ(deferred->pending.size(), 1);
+
+  // Removing filters must not affect the request already in flight.
+  pipe.Remove("deferred");
+  pipe.Remove("denied");
+  deferred->pending[0](google::rpc::Code::OK);
+  ASSERT_EQ(calls, 1);
+  ASSERT_EQ(result, google::rpc::Code::PERMISSION_DENIED);
+  ASSERT_EQ(response.status().message(), "denied");
+}
+
+TEST(PipeTest, ProcessAsyncEmpty) {
+  Pipe pipe;
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  google::rpc::Code result = google::rpc::Code::UNKNOWN;
+  pipe.ProcessAsync(&request, &response,
+                    [&result](google::rpc::Code code) { result = code; });
+  ASSERT_EQ(result, google::rpc::Code::OK);
+  ASSERT_EQ(response.status().code(), google::rpc::Code::OK);
+}
+
 }  // namespace filters
 }  // namespace authservice
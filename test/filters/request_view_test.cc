@@ -0,0 +1,106 @@
+#include "src/filters/request_view.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "gtest/gtest.h"
+#include "src/common/http/headers.h"
+
+namespace {
+// Counts heap allocations made by the test's thread while enabled.
+thread_local bool count_allocations_ = false;
+std::atomic<int> allocations_(0);
+}  // namespace
+
+void *operator new(size_t size) {
+  if (count_allocations_) {
+    ++allocations_;
+  }
+  void *memory = std::malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+
+namespace authservice {
+namespace filters {
+
+namespace {
+::envoy::service::auth::v2::CheckRequest Request(const std::string &cookies) {
+  ::envoy::service::auth::v2::CheckRequest request;
+  auto http = request.mutable_attributes()->mutable_request()->mutable_http();
+  http->mutable_headers()->insert({"x-header", "value"});
+  if (!cookies.empty()) {
+    http->mutable_headers()->insert({common::http::headers::Cookie, cookies});
+  }
+  return request;
+}
+}  // namespace
+
+TEST(RequestViewTest, HasHttp) {
+  ::envoy::service::auth::v2::CheckRequest request;
+  ASSERT_FALSE(RequestView(request).HasHttp());
+  ASSERT_TRUE(RequestView(Request("")).HasHttp());
+}
+
+TEST(RequestViewTest, Header) {
+  auto request = Request("");
+  RequestView view(request);
+  ASSERT_EQ(view.Header("x-header"), absl::string_view("value"));
+  ASSERT_FALSE(view.Header("missing").has_value());
+}
+
+TEST(RequestViewTest, Cookie) {
+  auto request = Request("first=1; second=2; first=3");
+  RequestView view(request);
+  ASSERT_EQ(view.Cookie("first"), absl::string_view("1"));
+  ASSERT_EQ(view.Cookie("second"), absl::string_view("2"));
+  ASSERT_FALSE(view.Cookie("third").has_value());
+  ASSERT_FALSE(view.Cookie("fir").has_value());
+
+  auto empty_value = Request("name=");
+  ASSERT_EQ(RequestView(empty_value).Cookie("name"), absl::string_view(""));
+
+  auto without_cookies = Request("");
+  ASSERT_FALSE(RequestView(without_cookies).Cookie("first").has_value());
+}
+
+TEST(RequestViewTest, Cookies) {
+  auto request = Request("first=1; invalid; second=2=2");
+  RequestView view(request);
+  const absl::string_view names[] = {"second", "third", "first"};
+  absl::optional<absl::string_view> values[3];
+  view.Cookies(names, absl::MakeSpan(values));
+  ASSERT_EQ(values[0], absl::string_view("2=2"));
+  ASSERT_FALSE(values[1].has_value());
+  ASSERT_EQ(values[2], absl::string_view("1"));
+}
+
+TEST(RequestViewTest, LookupsDoNotAllocate) {
+  auto request = Request(
+      "__Host-authservice-state-cookie=state; "
+      "__Host-authservice-id-token-cookie=identity; "
+      "__Host-authservice-access-token-cookie=access");
+  const std::string header = "x-header";
+  const std::string cookie = "__Host-authservice-id-token-cookie";
+
+  allocations_ = 0;
+  count_allocations_ = true;
+  RequestView view(request);
+  auto has_http = view.HasHttp();
+  auto value = view.Header(header);
+  auto id_token = view.Cookie(cookie);
+  count_allocations_ = false;
+
+  ASSERT_TRUE(has_http);
+  ASSERT_TRUE(value.has_value());
+  ASSERT_EQ(id_token, absl::string_view("identity"));
+  ASSERT_EQ(allocations_, 0);
+}
+
+}  // namespace filters
+}  // namespace authservice
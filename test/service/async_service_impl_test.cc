@@ -0,0 +1,44 @@
+#include "src/service/async_service_impl.h"
+#include <grpcpp/grpcpp.h>
+#include "gtest/gtest.h"
+#include "src/config/getconfig.h"
+
+namespace authservice {
+namespace service {
+TEST(AsyncServiceImplTest, Check) {
+  auto config =
+      authservice::config::GetConfig("test/fixtures/valid-config.json");
+  config->set_listen_port(0);
+  config->set_completion_queues(2);
+  config->set_threads(4);
+  AsyncAuthServiceImpl server(config);
+  server.Start();
+  ASSERT_NE(server.Port(), 0);
+
+  auto channel = ::grpc::CreateChannel(
+      config->listen_address() + ":" + std::to_string(server.Port()),
+      ::grpc::InsecureChannelCredentials());
+  auto stub = Authorization::NewStub(channel);
+  for (auto i = 0; i < 10; i++) {
+    ::grpc::ClientContext context;
+    ::envoy::service::auth::v2::CheckRequest request;
+    ::envoy::service::auth::v2::CheckResponse response;
+    request.mutable_attributes()->mutable_request()->mutable_http()->set_scheme(
+        "https");
+    auto request_headers = request.mutable_attributes()
+                               ->mutable_request()
+                               ->mutable_http()
+                               ->mutable_headers();
+    request_headers->insert({"authorization", "something"});
+
+    ::grpc::Status status = stub->Check(&context, request, &response);
+    EXPECT_TRUE(status.ok());
+    EXPECT_EQ(response.status().code(), google::rpc::Code::OK);
+  }
+
+  server.Shutdown();
+  server.Wait();
+}
+
+}  // namespace service
+}  // namespace authservice
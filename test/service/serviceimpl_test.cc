@@ -1,5 +1,7 @@
 #include "src/service/serviceimpl.h"
+#include <chrono>
 #include "gtest/gtest.h"
+#include "src/common/metrics/metrics.h"
 #include "src/config/getconfig.h"
 
 namespace authservice {
@@ -22,5 +24,126 @@ TEST(ServiceImplTest, Check) {
   EXPECT_TRUE(status.ok());
 }
 
+TEST(ServiceImplTest, CheckAsync) {
+  AuthServiceImpl service(
+      authservice::config::GetConfig("test/fixtures/valid-config.json"));
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+
+  request.mutable_attributes()->mutable_request()->mutable_http()->set_scheme(
+      "https");
+  auto request_headers = request.mutable_attributes()
+                             ->mutable_request()
+                             ->mutable_http()
+                             ->mutable_headers();
+  request_headers->insert({"authorization", "something"});
+
+  int calls = 0;
+  ::grpc::Status status(::grpc::StatusCode::UNKNOWN, "");
+  service.CheckAsync(&request, &response, [&](::grpc::Status result) {
+    calls++;
+    status = result;
+  });
+  // The request already carries a token so no filter needs to wait on I/O.
+  EXPECT_EQ(calls, 1);
+  EXPECT_TRUE(status.ok());
+}
+
+TEST(ServiceImplTest, Reload) {
+  auto config =
+      authservice::config::GetConfig("test/fixtures/valid-config.json");
+  AuthServiceImpl service(config);
+  auto &reloads = common::metrics::Registry::Instance().GetCounter(
+      "config_reloads_total");
+  auto before = reloads.Value();
+
+  service.Reload(config);
+  EXPECT_EQ(reloads.Value(), before + 1);
+  EXPECT_EQ(common::metrics::Registry::Instance()
+                .GetGauge("config_reload_filters")
+                .Value(),
+            1);
+
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  request.mutable_attributes()->mutable_request()->mutable_http()->set_scheme(
+      "https");
+  request.mutable_attributes()->mutable_request()->mutable_http()
+      ->mutable_headers()
+      ->insert({"authorization", "something"});
+  EXPECT_TRUE(service.Check(nullptr, &request, &response).ok());
+}
+
+TEST(ServiceImplTest, ReloadInvalidConfigKeepsPipeline) {
+  auto config =
+      authservice::config::GetConfig("test/fixtures/valid-config.json");
+  AuthServiceImpl service(config);
+  auto invalid = std::make_shared<authservice::config::Config>(*config);
+  invalid->add_filters();  // A filter with no type.
+  EXPECT_THROW(service.Reload(invalid), std::runtime_error);
+
+  ::envoy::service::auth::v2::CheckRequest request;
+  ::envoy::service::auth::v2::CheckResponse response;
+  request.mutable_attributes()->mutable_request()->mutable_http()->set_scheme(
+      "https");
+  request.mutable_attributes()->mutable_request()->mutable_http()
+      ->mutable_headers()
+      ->insert({"authorization", "something"});
+  EXPECT_TRUE(service.Check(nullptr, &request, &response).ok());
+}
+
+TEST(ServiceImplTest, ReloadKeepsSessions) {
+  auto config =
+      authservice::config::GetConfig("test/fixtures/valid-config.json");
+  config->mutable_filters(0)->mutable_oidc()->mutable_session_store()
+      ->mutable_in_memory();
+  AuthServiceImpl service(config);
+  auto store = service.SessionStore(0);
+  ASSERT_NE(store, nullptr);
+  common::session::Session session;
+  session.id_token = "id-token";
+  auto id = store->Put(session, std::chrono::system_clock::now() +
+                                    std::chrono::minutes(5));
+
+  // An unchanged session store survives the reload.
+  auto reloaded = std::make_shared<authservice::config::Config>(*config);
+  service.Reload(reloaded);
+  ASSERT_EQ(service.SessionStore(0), store);
+  auto found = service.SessionStore(0)->Get(id);
+  ASSERT_TRUE(found.has_value());
+  ASSERT_EQ(found->id_token, "id-token");
+
+  // In memory sessions are not encrypted, so survive a new cryptor secret.
+  auto rekeyed = std::make_shared<authservice::config::Config>(*config);
+  rekeyed->mutable_filters(0)->mutable_oidc()->set_cryptor_secret("rekeyed");
+  service.Reload(rekeyed);
+  ASSERT_EQ(service.SessionStore(0), store);
+
+  // Removing the session store ends every session.
+  auto removed = std::make_shared<authservice::config::Config>(*config);
+  removed->mutable_filters(0)->mutable_oidc()->clear_session_store();
+  service.Reload(removed);
+  ASSERT_EQ(service.SessionStore(0), nullptr);
+}
+
+TEST(ServiceImplTest, ReloadInvalidRedisConfig) {
+  auto config =
+      authservice::config::GetConfig("test/fixtures/valid-config.json");
+  AuthServiceImpl service(config);
+  auto invalid = std::make_shared<authservice::config::Config>(*config);
+  auto redis = invalid->mutable_filters(0)
+                   ->mutable_oidc()
+                   ->mutable_session_store()
+                   ->mutable_redis();
+  redis->set_hostname("redis.tld");
+  redis->set_port(65536);
+  EXPECT_THROW(service.Reload(invalid), std::runtime_error);
+  redis->set_port(0);
+  EXPECT_THROW(service.Reload(invalid), std::runtime_error);
+  redis->set_port(6379);
+  redis->clear_hostname();
+  EXPECT_THROW(service.Reload(invalid), std::runtime_error);
+}
+
 }  // namespace service
 }  // namespace authservice